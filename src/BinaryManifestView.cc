@@ -0,0 +1,318 @@
+// ----------------------------------------------------------------------
+// File: BinaryManifestView.cc
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "BinaryManifestView.hh"
+#include "Manifest.hh"
+#include "HashCalculator.hh"
+#include "Utils.hh"
+#include "Macros.hh"
+using namespace eostest;
+
+namespace {
+  const std::string_view kMagic = "EOSTMNF2";
+  const uint32_t kVersion = 2;
+  const size_t kHeaderSize = 16;
+  const size_t kDigestSize = 32;
+
+  void appendString(std::string &out, std::string_view str) {
+    appendVarint(out, str.size());
+    out.append(str.data(), str.size());
+  }
+
+  bool readString(std::string_view str, size_t &index, std::string_view &value) {
+    uint64_t length = 0;
+    if(!consumeVarint(str, index, length) || length > str.size() - index) return false;
+
+    value = str.substr(index, length);
+    index += length;
+    return true;
+  }
+
+  void appendSection(std::string &out, size_t count, const std::string &offsets, const std::string &entries) {
+    eost_assert(entries.size() <= UINT32_MAX);
+
+    appendVarint(out, count);
+    appendVarint(out, entries.size());
+    out.append(offsets);
+    out.append(entries);
+  }
+}
+
+bool BinaryManifestView::isBinary(std::string_view contents) {
+  return contents.compare(0, kMagic.size(), kMagic) == 0;
+}
+
+std::string BinaryManifestView::encode(const Manifest &manifest) {
+  std::string out(kMagic);
+  appendFixed32(out, kVersion);
+  appendFixed32(out, 0);
+
+  appendString(out, manifest.getFilename());
+  appendVarint(out, manifest.getShards().size());
+  for(const std::string &shard : manifest.getShards()) {
+    appendString(out, shard);
+  }
+
+  std::string offsets;
+  std::string entries;
+
+  for(std::string_view subdir : manifest.getDirectories()) {
+    appendFixed32(offsets, entries.size());
+    appendString(entries, subdir);
+  }
+
+  appendSection(out, manifest.getDirectories().size(), offsets, entries);
+  offsets.clear();
+  entries.clear();
+
+  offsets.reserve(4 * manifest.getFiles().size());
+  entries.reserve(8 * manifest.getFiles().size());
+
+  // Sizes and checksums are sorted just like the files, walk all three side
+  // by side
+  auto size = manifest.getSizes().begin();
+  auto sizesEnd = manifest.getSizes().end();
+  auto it = manifest.getChecksums().begin();
+  auto end = manifest.getChecksums().end();
+
+  for(std::string_view file : manifest.getFiles()) {
+    appendFixed32(offsets, entries.size());
+    appendString(entries, file);
+
+    while(size != sizesEnd && size->first < file) size++;
+    appendVarint(entries, (size != sizesEnd && size->first == file) ? size->second + 1 : 0);
+
+    while(it != end && it->first < file) it++;
+    appendString(entries, (it != end && it->first == file) ? std::string_view(it->second) : std::string_view());
+  }
+
+  out.reserve(out.size() + 16 + offsets.size() + entries.size() + kDigestSize);
+  appendSection(out, manifest.getFiles().size(), offsets, entries);
+
+  out.append(HashCalculator::sha256(out));
+  return out;
+}
+
+bool BinaryManifestView::open(std::string_view data) {
+  *this = BinaryManifestView();
+
+  if(!isBinary(data) || data.size() < kHeaderSize + kDigestSize) return false;
+  if(decodeFixed32(data.data() + kMagic.size()) != kVersion) return false;
+
+  contents = data;
+  body = data.substr(0, data.size() - kDigestSize);
+
+  size_t index = kHeaderSize;
+  if(!readString(body, index, filename)) return false;
+
+  uint64_t count = 0;
+  if(!consumeVarint(body, index, count)) return false;
+
+  size_t start = index;
+  for(uint64_t i = 0; i < count; i++) {
+    std::string_view shard;
+    if(!readString(body, index, shard)) return false;
+  }
+
+  shards.count = count;
+  shards.names = body.substr(start, index - start);
+
+  files.fileEntries = true;
+  if(!openSection(index, subdirs)) return false;
+  if(!openSection(index, files)) return false;
+  return index == body.size();
+}
+
+bool BinaryManifestView::openSection(size_t &index, Section &section) {
+  uint64_t count = 0;
+  uint64_t size = 0;
+  if(!consumeVarint(body, index, count) || !consumeVarint(body, index, size)) return false;
+
+  if(count > (body.size() - index) / 4) return false;
+  section.count = count;
+  section.offsets = body.substr(index, count * 4);
+  index += count * 4;
+
+  if(size > body.size() - index) return false;
+  section.entries = body.substr(index, size);
+  index += size;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Decode the entry at pos, advancing past it. Sizes are stored plus one, so
+// that zero can stand for none recorded.
+//------------------------------------------------------------------------------
+bool BinaryManifestView::readEntry(const Section &section, size_t &pos, std::string_view &name, uint64_t &size, std::string_view &checksum) {
+  size = kNoSize;
+  checksum = std::string_view();
+
+  if(!readString(section.entries, pos, name)) return false;
+  if(!section.fileEntries) return true;
+
+  uint64_t storedSize = 0;
+  if(!consumeVarint(section.entries, pos, storedSize) || storedSize == kNoSize) return false;
+  if(storedSize != 0) size = storedSize - 1;
+
+  return readString(section.entries, pos, checksum);
+}
+
+bool BinaryManifestView::entry(const Section &section, size_t index, std::string_view &name, uint64_t &size, std::string_view &checksum) const {
+  size_t pos = decodeFixed32(section.offsets.data() + 4 * index);
+  if(pos > section.entries.size()) return false;
+  return readEntry(section, pos, name, size, checksum);
+}
+
+bool BinaryManifestView::lowerBound(const Section &section, std::string_view name, size_t &index) const {
+  size_t low = 0;
+  size_t high = section.count;
+
+  while(low < high) {
+    size_t mid = low + (high - low) / 2;
+
+    std::string_view candidate;
+    uint64_t size;
+    std::string_view checksum;
+    if(!entry(section, mid, candidate, size, checksum)) return false;
+
+    if(candidate < name) {
+      low = mid + 1;
+    }
+    else {
+      high = mid;
+    }
+  }
+
+  index = low;
+  return true;
+}
+
+bool BinaryManifestView::verify(Entries *entries) const {
+  if(HashCalculator::sha256(body) != contents.substr(body.size())) return false;
+
+  if(!entries) {
+    return verifySection(subdirs, nullptr, nullptr, nullptr) && verifySection(files, nullptr, nullptr, nullptr);
+  }
+
+  entries->subdirs.clear();
+  entries->files.clear();
+  entries->sizes.clear();
+  entries->checksums.clear();
+
+  return verifySection(subdirs, &entries->subdirs, nullptr, nullptr) &&
+         verifySection(files, &entries->files, &entries->sizes, &entries->checksums);
+}
+
+//------------------------------------------------------------------------------
+// Entries must follow each other without gaps, in strictly increasing order,
+// exactly filling up the section.
+//------------------------------------------------------------------------------
+bool BinaryManifestView::verifySection(const Section &section, std::vector<std::string_view> *names, std::vector<uint64_t> *sizes,
+  std::vector<std::string_view> *checksums) const {
+
+  size_t pos = 0;
+  std::string_view previous;
+
+  if(names) names->reserve(section.count);
+  if(sizes) sizes->reserve(section.count);
+  if(checksums) checksums->reserve(section.count);
+
+  for(size_t i = 0; i < section.count; i++) {
+    if(decodeFixed32(section.offsets.data() + 4 * i) != pos) return false;
+
+    std::string_view name;
+    uint64_t size;
+    std::string_view checksum;
+    if(!readEntry(section, pos, name, size, checksum)) return false;
+
+    if(i != 0 && previous >= name) return false;
+    previous = name;
+
+    if(names) names->push_back(name);
+    if(sizes) sizes->push_back(size);
+    if(checksums) checksums->push_back(checksum);
+  }
+
+  return pos == section.entries.size();
+}
+
+std::string_view BinaryManifestView::getShard(size_t index) const {
+  size_t pos = 0;
+  std::string_view shard;
+
+  for(size_t i = 0; i <= index; i++) {
+    if(!readString(shards.names, pos, shard)) return std::string_view();
+  }
+
+  return shard;
+}
+
+std::string_view BinaryManifestView::getSubdir(size_t index) const {
+  std::string_view name;
+  uint64_t size;
+  std::string_view checksum;
+  if(!entry(subdirs, index, name, size, checksum)) return std::string_view();
+  return name;
+}
+
+std::string_view BinaryManifestView::getFile(size_t index) const {
+  std::string_view name;
+  uint64_t size;
+  std::string_view checksum;
+  if(!entry(files, index, name, size, checksum)) return std::string_view();
+  return name;
+}
+
+std::string_view BinaryManifestView::getChecksum(size_t index) const {
+  std::string_view name;
+  uint64_t size;
+  std::string_view checksum;
+  if(!entry(files, index, name, size, checksum)) return std::string_view();
+  return checksum;
+}
+
+uint64_t BinaryManifestView::getSize(size_t index) const {
+  std::string_view name;
+  uint64_t size;
+  std::string_view checksum;
+  if(!entry(files, index, name, size, checksum)) return kNoSize;
+  return size;
+}
+
+bool BinaryManifestView::containsSubdir(std::string_view name) const {
+  size_t index = 0;
+  return lowerBound(subdirs, name, index) && index < subdirs.count && getSubdir(index) == name;
+}
+
+bool BinaryManifestView::findFile(std::string_view name, std::string_view &checksum) const {
+  uint64_t size;
+  return findFile(name, checksum, size);
+}
+
+bool BinaryManifestView::findFile(std::string_view name, std::string_view &checksum, uint64_t &size) const {
+  size_t index = 0;
+  if(!lowerBound(files, name, index) || index >= files.count) return false;
+
+  std::string_view found;
+  return entry(files, index, found, size, checksum) && found == name;
+}
@@ -0,0 +1,129 @@
+// ----------------------------------------------------------------------
+// File: BinaryManifestView.hh
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef EOSTESTER_BINARY_MANIFEST_VIEW_H
+#define EOSTESTER_BINARY_MANIFEST_VIEW_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace eostest {
+
+class Manifest;
+
+//------------------------------------------------------------------------------
+// MANIFEST v2, a binary alternative to the text format. Names are stored in
+// sorted order behind fixed-width offset tables, so the contents can be
+// looked up in place - in a downloaded buffer, or an mmapped file - with a
+// binary search, without parsing the whole thing first.
+//
+//   "EOSTMNF2", u32 version, u32 reserved
+//   filename, varint shard count, shard names
+//   subdirs: varint count n, varint size of entries, n u32 entry offsets,
+//            entries: name
+//   files:   varint count n, varint size of entries, n u32 entry offsets,
+//            entries: name, varint size + 1 (0 if not recorded),
+//                     checksum ("type:value", or empty)
+//   raw SHA-256 of everything above
+//
+// Strings are a varint length followed by the bytes, fixed-width integers
+// are little-endian, offsets relative to the start of the entries.
+//------------------------------------------------------------------------------
+class BinaryManifestView {
+public:
+  static constexpr uint64_t kNoSize = UINT64_MAX;
+
+  static bool isBinary(std::string_view contents);
+  static std::string encode(const Manifest &manifest);
+
+  //----------------------------------------------------------------------------
+  // Check the layout, in constant time: accessors below are safe after this,
+  // though they may come back empty on a corrupt entry. verify then checks
+  // the digest and every entry, in linear time - optionally collecting the
+  // entries along the way, so a full decode needs just the one pass.
+  //----------------------------------------------------------------------------
+  struct Entries {
+    std::vector<std::string_view> subdirs;
+    std::vector<std::string_view> files;
+    std::vector<uint64_t> sizes;             // one per file, kNoSize if none
+    std::vector<std::string_view> checksums; // one per file, empty if none
+  };
+
+  bool open(std::string_view contents);
+  bool verify(Entries *entries = nullptr) const;
+
+  std::string_view getFilename() const { return filename; }
+
+  size_t shardCount() const { return shards.count; }
+  std::string_view getShard(size_t index) const;
+
+  size_t subdirCount() const { return subdirs.count; }
+  std::string_view getSubdir(size_t index) const;
+
+  size_t fileCount() const { return files.count; }
+  std::string_view getFile(size_t index) const;
+  std::string_view getChecksum(size_t index) const;
+  uint64_t getSize(size_t index) const;
+
+  //----------------------------------------------------------------------------
+  // O(log n) lookups. findFile also gives back the checksum and size of the
+  // file.
+  //----------------------------------------------------------------------------
+  bool containsSubdir(std::string_view name) const;
+  bool findFile(std::string_view name, std::string_view &checksum) const;
+  bool findFile(std::string_view name, std::string_view &checksum, uint64_t &size) const;
+
+private:
+  struct Section {
+    bool fileEntries = false; // with size and checksum
+    size_t count = 0;
+    std::string_view offsets;
+    std::string_view entries;
+  };
+
+  bool openSection(size_t &index, Section &section);
+  bool entry(const Section &section, size_t index, std::string_view &name, uint64_t &size, std::string_view &checksum) const;
+  static bool readEntry(const Section &section, size_t &pos, std::string_view &name, uint64_t &size, std::string_view &checksum);
+  bool lowerBound(const Section &section, std::string_view name, size_t &index) const;
+  bool verifySection(const Section &section, std::vector<std::string_view> *names, std::vector<uint64_t> *sizes,
+    std::vector<std::string_view> *checksums) const;
+
+  std::string_view contents;
+  std::string_view filename;
+  std::string_view body; // everything covered by the digest
+
+  // Shard names are few, and simply follow each other
+  struct {
+    size_t count = 0;
+    std::string_view names;
+  } shards;
+
+  Section subdirs;
+  Section files;
+};
+
+}
+
+#endif
@@ -0,0 +1,168 @@
+// ----------------------------------------------------------------------
+// File: CommandLine.cc
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "CommandLine.hh"
+using namespace eostest;
+
+CommandLine::CommandLine() {
+  treeSubcommand = app.add_subcommand("tree", "Build and verify namespace trees");
+  app.require_subcommand();
+
+  buildOpt = treeSubcommand->add_option("--build", targetPath, "Build a namespace tree in the specified URL.");
+  auto seedOpt = treeSubcommand->add_option("--seed", builderOpts.seed, "Random seed to use when building a namespace tree.", true)
+    ->needs(buildOpt);
+
+  auto depthOpt = treeSubcommand->add_option("--depth", builderOpts.depth, "The depth of the namespace tree to be created.", true)
+    ->needs(buildOpt);
+
+  auto nfilesOpt = treeSubcommand->add_option("--nfiles", builderOpts.files, "The size in number of files for the namesapce tree to build")
+   ->needs(buildOpt);
+
+  auto templatesOpt = treeSubcommand->add_flag("--content-templates", builderOpts.contentTemplates, "Files of equal size share the same random bytes, only header and checksum differ. Cheaper to generate, validates the same.")
+   ->needs(buildOpt);
+
+  auto subdirsOpt = treeSubcommand->add_option("--subdirs", subdirsSpec, "Distribution of the number of subdirectories per directory, ie 4, uniform:0-10, lognormal:8,1.5, zipf:1000,1.1, or file:PATH with an empirical histogram. Default uniform:0-10.")
+   ->needs(buildOpt);
+
+  auto filesOpt = treeSubcommand->add_option("--files-per-dir", filesSpec, "Distribution of the number of files per directory, not counting the MANIFEST. Default uniform:1-11.")
+   ->needs(buildOpt);
+
+  auto fileSizeOpt = treeSubcommand->add_option("--file-size", fileSizeSpec, "Distribution of the number of random bytes per file, ie lognormal:4K,2, or lognormal:4K,2,64M to clamp the tail. At most 64M per file. Default uniform:1-256.")
+   ->needs(buildOpt);
+
+  auto depthDistributionOpt = treeSubcommand->add_option("--depth-distribution", depthSpec, "Draw the depth of each top-level branch from this distribution, instead of using --depth for all.")
+   ->needs(buildOpt)
+   ->excludes(depthOpt);
+
+  auto checksumsOpt = treeSubcommand->add_option("--checksums", builderOpts.checksumType, "Record the checksum of every file in its MANIFEST, so that the tree can later be validated with --server-checksums. One of adler32, crc32c.")
+   ->needs(buildOpt);
+
+  auto manifestShardSizeOpt = treeSubcommand->add_option("--manifest-shard-size", builderOpts.manifestShardSize, "Split the MANIFEST of directories with more entries than this into shards MANIFEST.0, MANIFEST.1, ... of at most this many entries, indexed by the MANIFEST. Zero never shards.", true)
+   ->needs(buildOpt);
+
+  auto binaryManifestsOpt = treeSubcommand->add_flag("--binary-manifests", builderOpts.binaryManifests, "Write MANIFESTs in the compact binary v2 format. --validate and --destroy read both formats.")
+   ->needs(buildOpt);
+
+  treeSubcommand->add_option("--max-inflight", builderOpts.maxInflight, "Maximum number of operations in flight when building or validating a namespace tree.", true);
+
+  auto targetP99Opt = treeSubcommand->add_option("--target-p99", targetP99, "Adapt the number of operations in flight, up to --max-inflight, to keep p99 latency under this many milliseconds. Zero disables.", true);
+
+  auto connectionsOpt = treeSubcommand->add_option("--connections", builderOpts.connections, "Number of physical connections to spread the tree build or destruction over.", true);
+
+  auto placementOpt = treeSubcommand->add_option("--placement", placement, "How to assign operations to connections: round-robin, subtree (one connection per directory), or least-loaded.", true)
+   ->needs(connectionsOpt);
+
+  auto shardsOpt = treeSubcommand->add_option("--shards", builderOpts.shards, "Split the tree build into this many shards, each built by its own worker process. Unless --shard or --remote-workers is given, the workers are forked locally, and their results merged into one report.", true)
+   ->needs(buildOpt);
+
+  shardOpt = treeSubcommand->add_option("--shard", shard, "Run as the worker building only this shard, from 0 to --shards minus one, and publish the results into --spool, once a coordinator has claimed it.")
+   ->needs(shardsOpt);
+
+  auto spoolOpt = treeSubcommand->add_option("--spool", spool, "Directory through which workers pass their results to the coordinator. Must be shared between all hosts involved. Defaults to a fresh temporary directory, when all workers are local.")
+   ->needs(shardsOpt);
+
+  auto remoteWorkersOpt = treeSubcommand->add_flag("--remote-workers", remoteWorkers, "Don't fork any workers, only claim --spool, then wait for and merge the results of workers started elsewhere with --shard. Results left in the spool by earlier runs are ignored.")
+   ->needs(spoolOpt)
+   ->excludes(shardOpt);
+
+  auto journalOpt = treeSubcommand->add_option("--journal", builderOpts.journal, "Record completed entries into this local file, so that an interrupted build can be picked up again with --resume.")
+   ->needs(buildOpt);
+
+  auto resumeOpt = treeSubcommand->add_flag("--resume", builderOpts.resume, "Continue an interrupted build, skipping everything recorded in --journal as done. Must be given the same tree options as the original build.")
+   ->needs(journalOpt);
+
+  validateOpt = treeSubcommand->add_option("--validate", targetPath, "Verify a namespace tree present in the specified URL.")
+    ->excludes(buildOpt)
+    ->excludes(seedOpt)
+    ->excludes(depthOpt)
+    ->excludes(nfilesOpt)
+    ->excludes(templatesOpt)
+    ->excludes(subdirsOpt)
+    ->excludes(filesOpt)
+    ->excludes(fileSizeOpt)
+    ->excludes(depthDistributionOpt)
+    ->excludes(checksumsOpt)
+    ->excludes(manifestShardSizeOpt)
+    ->excludes(binaryManifestsOpt)
+    ->excludes(targetP99Opt)
+    ->excludes(connectionsOpt)
+    ->excludes(placementOpt)
+    ->excludes(shardsOpt)
+    ->excludes(shardOpt)
+    ->excludes(spoolOpt)
+    ->excludes(remoteWorkersOpt)
+    ->excludes(journalOpt)
+    ->excludes(resumeOpt);
+
+  auto metadataOnlyOpt = treeSubcommand->add_flag("--metadata-only", validatorOpts.metadataOnly, "Only cross-check MANIFESTs against directory listings, and file sizes against their names. Reads no file contents.")
+    ->needs(validateOpt);
+
+  treeSubcommand->add_flag("--server-checksums", validatorOpts.serverChecksums, "Compare file checksums computed by the server against those recorded in MANIFESTs by --checksums, instead of reading file contents.")
+    ->needs(validateOpt)
+    ->excludes(metadataOnlyOpt);
+
+  treeSubcommand->add_option("--sample-rate", validatorOpts.sampleRate, "Fraction of files to validate, between 0 and 1. Which files is decided by hashing their paths.", true)
+    ->needs(validateOpt);
+
+  treeSubcommand->add_option("--sample-seed", validatorOpts.sampleSeed, "Seed for choosing the sampled files - use a different one on each run to eventually cover the whole tree.", true)
+    ->needs(validateOpt);
+
+  treeSubcommand->add_flag("--sample-directories", validatorOpts.sampleDirectories, "Sample directories as well: those not chosen are skipped along with their whole subtree.")
+    ->needs(validateOpt);
+
+  treeSubcommand->add_option("--workers", validatorOpts.workers, "Number of threads validating the tree, stealing unexplored subtrees from each other.", true)
+    ->needs(validateOpt);
+
+  destroyOpt = treeSubcommand->add_option("--destroy", targetPath, "Remove everything below the specified URL, bottom-up, going by the MANIFESTs of a tree built with --build where present.")
+    ->excludes(buildOpt)
+    ->excludes(validateOpt)
+    ->excludes(seedOpt)
+    ->excludes(depthOpt)
+    ->excludes(nfilesOpt)
+    ->excludes(templatesOpt)
+    ->excludes(subdirsOpt)
+    ->excludes(filesOpt)
+    ->excludes(fileSizeOpt)
+    ->excludes(depthDistributionOpt)
+    ->excludes(checksumsOpt)
+    ->excludes(manifestShardSizeOpt)
+    ->excludes(binaryManifestsOpt)
+    ->excludes(shardsOpt)
+    ->excludes(journalOpt);
+
+  buildOpt->group("Operation");
+  validateOpt->group("Operation");
+  destroyOpt->group("Operation");
+
+  largeFileSubcommand = app.add_subcommand("largefile", "Measure bandwidth with large files, streamed in chunks");
+  writeOpt = largeFileSubcommand->add_option("--write", largeFileOpts.url, "Write a large file to the specified URL.");
+  readOpt = largeFileSubcommand->add_option("--read", largeFileOpts.url, "Read back and verify a large file written with --write, using the same --size and --seed.");
+  largeFileSubcommand->add_option("--size", largeFileSize, "Size of the file, ie 1G, 500M.", true);
+  largeFileSubcommand->add_option("--chunk-size", chunkSize, "Size of each individual read or write request.", true);
+  largeFileSubcommand->add_option("--inflight", largeFileOpts.streaming.inflight, "Maximum number of requests in flight, per file.", true);
+  largeFileSubcommand->add_option("--seed", largeFileOpts.seed, "Random seed for the file contents.", true);
+  writeOpt->group("Operation");
+  readOpt->group("Operation");
+  writeOpt->excludes(readOpt);
+  readOpt->excludes(writeOpt);
+}
@@ -0,0 +1,81 @@
+// ----------------------------------------------------------------------
+// File: CommandLine.hh
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef EOSTESTER_COMMAND_LINE_H
+#define EOSTESTER_COMMAND_LINE_H
+
+#include <string>
+#include <CLI11.hpp>
+
+#include "testcases/TreeBuilder.hh"
+#include "testcases/TreeValidator.hh"
+#include "testcases/LargeFileTester.hh"
+
+namespace eostest {
+
+//------------------------------------------------------------------------------
+// The command line of eos-tester: every option, along with the variables
+// parsing fills in. Kept out of main() so that tests can check which
+// combinations of options are accepted.
+//
+// The options bind to the members below, so this can be neither copied nor
+// moved.
+//------------------------------------------------------------------------------
+struct CommandLine {
+  CommandLine();
+  CommandLine(const CommandLine&) = delete;
+  CommandLine& operator=(const CommandLine&) = delete;
+
+  CLI::App app {"This tool collects a number of functional and stress tests for the EOS storage system."};
+
+  TreeBuilder::Options builderOpts;
+  TreeValidator::Options validatorOpts;
+  LargeFileTester::Options largeFileOpts;
+
+  std::string targetPath;
+  std::string subdirsSpec;
+  std::string filesSpec;
+  std::string fileSizeSpec;
+  std::string depthSpec;
+  int64_t targetP99 = 0;
+  std::string placement = "round-robin";
+  int64_t shard = -1;
+  std::string spool;
+  bool remoteWorkers = false;
+  std::string largeFileSize = "1G";
+  std::string chunkSize = "4M";
+
+  CLI::App *treeSubcommand = nullptr;
+  CLI::App *largeFileSubcommand = nullptr;
+
+  CLI::Option *buildOpt = nullptr;
+  CLI::Option *validateOpt = nullptr;
+  CLI::Option *destroyOpt = nullptr;
+  CLI::Option *shardOpt = nullptr;
+  CLI::Option *writeOpt = nullptr;
+  CLI::Option *readOpt = nullptr;
+};
+
+}
+
+#endif
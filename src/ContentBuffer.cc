@@ -0,0 +1,59 @@
+// ----------------------------------------------------------------------
+// File: ContentBuffer.cc
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "ContentBuffer.hh"
+using namespace eostest;
+
+ContentBuffer::ContentBuffer(std::string &&contents) {
+  append(std::move(contents));
+}
+
+ContentBuffer::ContentBuffer(const std::string &contents) {
+  append(std::string(contents));
+}
+
+ContentBuffer::ContentBuffer(const char *contents) {
+  append(std::string(contents));
+}
+
+void ContentBuffer::append(std::string &&contents) {
+  append(std::make_shared<const std::string>(std::move(contents)));
+}
+
+void ContentBuffer::append(const Segment &segment) {
+  if(!segment || segment->empty()) return;
+
+  segments.emplace_back(segment);
+  totalSize += segment->size();
+}
+
+std::string ContentBuffer::toString() const {
+  std::string retval;
+  retval.reserve(totalSize);
+
+  for(const Segment &segment : segments) {
+    retval.append(*segment);
+  }
+
+  return retval;
+}
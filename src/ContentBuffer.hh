@@ -0,0 +1,75 @@
+// ----------------------------------------------------------------------
+// File: ContentBuffer.hh
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef EOSTESTER_CONTENT_BUFFER_H
+#define EOSTESTER_CONTENT_BUFFER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace eostest {
+
+//------------------------------------------------------------------------------
+// Immutable file contents, made up of one or more refcounted segments.
+// Copying a ContentBuffer never copies the bytes, and a segment can be
+// shared between any number of buffers - for example the identical body of
+// many templated files, of which only the header differs.
+//------------------------------------------------------------------------------
+class ContentBuffer {
+public:
+  using Segment = std::shared_ptr<const std::string>;
+
+  ContentBuffer() {}
+  ContentBuffer(std::string &&contents);
+  ContentBuffer(const std::string &contents);
+  ContentBuffer(const char *contents);
+
+  void append(std::string &&contents);
+  void append(const Segment &segment);
+
+  size_t size() const {
+    return totalSize;
+  }
+
+  bool empty() const {
+    return totalSize == 0;
+  }
+
+  const std::vector<Segment>& getSegments() const {
+    return segments;
+  }
+
+  //----------------------------------------------------------------------------
+  // Flatten into a single string - this one does copy.
+  //----------------------------------------------------------------------------
+  std::string toString() const;
+
+private:
+  std::vector<Segment> segments;
+  size_t totalSize = 0;
+};
+
+}
+
+#endif
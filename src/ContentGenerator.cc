@@ -0,0 +1,100 @@
+// ----------------------------------------------------------------------
+// File: ContentGenerator.cc
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include <cstring>
+#include <algorithm>
+#include "ContentGenerator.hh"
+#include "Macros.hh"
+using namespace eostest;
+
+PatternGenerator::PatternGenerator(uint64_t sd, uint64_t sz)
+: seed(sd), length(sz) {}
+
+uint64_t PatternGenerator::size() const {
+  return length;
+}
+
+uint64_t PatternGenerator::wordAt(uint64_t index) const {
+  // splitmix64 finalizer
+  uint64_t z = seed + (index + 1) * 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+void PatternGenerator::fill(uint64_t offset, char *buffer, size_t len) const {
+  while(len > 0) {
+    uint64_t word = wordAt(offset / 8);
+    size_t skip = offset % 8;
+    size_t toCopy = std::min(len, 8 - skip);
+
+    memcpy(buffer, reinterpret_cast<char*>(&word) + skip, toCopy);
+    buffer += toCopy;
+    offset += toCopy;
+    len -= toCopy;
+  }
+}
+
+GeneratorVerifier::GeneratorVerifier(std::shared_ptr<ContentGenerator> gen)
+: generator(std::move(gen)) {}
+
+void GeneratorVerifier::consume(const char *data, size_t length) {
+  if(mismatch) return;
+
+  if(offset + length > generator->size()) {
+    mismatch = true;
+    mismatchOffset = generator->size();
+    return;
+  }
+
+  if(expectedCapacity < length) {
+    expected.reset(new char[length]);
+    expectedCapacity = length;
+  }
+
+  generator->fill(offset, expected.get(), length);
+
+  if(memcmp(expected.get(), data, length) != 0) {
+    mismatch = true;
+    for(size_t i = 0; i < length; i++) {
+      if(expected[i] != data[i]) {
+        mismatchOffset = offset + i;
+        break;
+      }
+    }
+  }
+
+  offset += length;
+}
+
+TestcaseStatus GeneratorVerifier::finish() {
+  if(mismatch) {
+    return TestcaseStatus(SSTR("Contents differ from expected, starting at offset " << mismatchOffset));
+  }
+
+  if(offset != generator->size()) {
+    return TestcaseStatus(SSTR("Expected " << generator->size() << " bytes, received " << offset));
+  }
+
+  return TestcaseStatus();
+}
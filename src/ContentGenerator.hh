@@ -0,0 +1,109 @@
+// ----------------------------------------------------------------------
+// File: ContentGenerator.hh
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef EOSTESTER_CONTENT_GENERATOR_H
+#define EOSTESTER_CONTENT_GENERATOR_H
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include "utils/TestcaseStatus.hh"
+
+namespace eostest {
+
+//------------------------------------------------------------------------------
+// Produces the contents of a file one chunk at a time, so that arbitrarily
+// large files can be written without ever holding them in memory. fill()
+// must be deterministic, and callable for any range, in any order, from
+// any thread.
+//------------------------------------------------------------------------------
+class ContentGenerator {
+public:
+  virtual ~ContentGenerator() {}
+  virtual uint64_t size() const = 0;
+  virtual void fill(uint64_t offset, char *buffer, size_t length) const = 0;
+};
+
+//------------------------------------------------------------------------------
+// Pseudo-random bytes, where every 8-byte word is a hash of (seed, position).
+// Cheap enough to generate at memory bandwidth.
+//------------------------------------------------------------------------------
+class PatternGenerator : public ContentGenerator {
+public:
+  PatternGenerator(uint64_t seed, uint64_t size);
+
+  virtual uint64_t size() const override;
+  virtual void fill(uint64_t offset, char *buffer, size_t length) const override;
+
+private:
+  uint64_t wordAt(uint64_t index) const;
+
+  uint64_t seed;
+  uint64_t length;
+};
+
+//------------------------------------------------------------------------------
+// Receives the contents of a file one chunk at a time, as it's being read
+// back. consume() is called with consecutive chunks, in order, and never
+// concurrently. finish() is called once at the end, and gives the verdict.
+//------------------------------------------------------------------------------
+class ChunkConsumer {
+public:
+  virtual ~ChunkConsumer() {}
+  virtual void consume(const char *data, size_t length) = 0;
+  virtual TestcaseStatus finish() = 0;
+};
+
+//------------------------------------------------------------------------------
+// Compare the incoming stream against what a ContentGenerator would produce.
+//------------------------------------------------------------------------------
+class GeneratorVerifier : public ChunkConsumer {
+public:
+  GeneratorVerifier(std::shared_ptr<ContentGenerator> generator);
+
+  virtual void consume(const char *data, size_t length) override;
+  virtual TestcaseStatus finish() override;
+
+private:
+  std::shared_ptr<ContentGenerator> generator;
+  std::unique_ptr<char[]> expected;
+  size_t expectedCapacity = 0;
+
+  uint64_t offset = 0;
+  bool mismatch = false;
+  uint64_t mismatchOffset = 0;
+};
+
+//------------------------------------------------------------------------------
+// Streaming parameters: the file is written or read in chunks of chunkSize
+// bytes, with up to "inflight" requests outstanding at any time. Memory
+// usage per file is bounded by chunkSize * inflight.
+//------------------------------------------------------------------------------
+struct StreamingOptions {
+  size_t chunkSize = 4 * 1024 * 1024;
+  size_t inflight = 4;
+};
+
+}
+
+#endif
@@ -0,0 +1,93 @@
+// ----------------------------------------------------------------------
+// File: Executor.hh
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef EOSTESTER_EXECUTOR_H
+#define EOSTESTER_EXECUTOR_H
+
+#include <memory>
+#include <string>
+#include "utils/TestcaseStatus.hh"
+#include "ContentBuffer.hh"
+#include "ContentGenerator.hh"
+#include <folly/futures/Future.h>
+#include <XrdCl/XrdClXRootDResponses.hh>
+
+namespace eostest {
+
+class ReadOutcome;
+
+class ReadStatus : public TestcaseStatus {
+public:
+  using TestcaseStatus::TestcaseStatus;
+  ReadStatus(ReadOutcome &&outcome);
+  std::string contents;
+};
+
+class DirListStatus : public TestcaseStatus {
+public:
+  using TestcaseStatus::TestcaseStatus;
+  std::unique_ptr<XrdCl::DirectoryList> contents;
+};
+
+class ChecksumStatus : public TestcaseStatus {
+public:
+  using TestcaseStatus::TestcaseStatus;
+  std::string type;
+  std::string value;
+};
+
+//------------------------------------------------------------------------------
+// The storage backend the testcases talk to. URLs are always of the form
+// proto://host//path, connectionId selects the physical connection to use,
+// if the backend has such a notion.
+//------------------------------------------------------------------------------
+class Executor {
+public:
+  virtual ~Executor() {}
+
+  virtual folly::Future<TestcaseStatus> mkdir(size_t connectionId, const std::string &url) = 0;
+
+  //----------------------------------------------------------------------------
+  // Like mkdir -p: create any missing parents too, and succeed if the
+  // directory exists already.
+  //----------------------------------------------------------------------------
+  virtual folly::Future<TestcaseStatus> mkdirs(size_t connectionId, const std::string &url) = 0;
+
+  virtual folly::Future<TestcaseStatus> put(size_t connectionId, const std::string &url, const ContentBuffer &contents) = 0;
+  virtual folly::Future<TestcaseStatus> putStream(size_t connectionId, const std::string &url, std::shared_ptr<ContentGenerator> generator, const StreamingOptions &opts) = 0;
+  virtual folly::Future<TestcaseStatus> rm(size_t connectionId, const std::string &url) = 0;
+  virtual folly::Future<ReadStatus> get(size_t connectionId, const std::string &url) = 0;
+  virtual folly::Future<TestcaseStatus> getStream(size_t connectionId, const std::string &url, std::shared_ptr<ChunkConsumer> consumer, const StreamingOptions &opts) = 0;
+  virtual folly::Future<DirListStatus> dirList(size_t connectionId, const std::string &url) = 0;
+  virtual folly::Future<TestcaseStatus> rmdir(size_t connectionId, const std::string &url) = 0;
+
+  //----------------------------------------------------------------------------
+  // Ask the server for the checksum of a file, of the given type, computed on
+  // its side - no data is transferred.
+  //----------------------------------------------------------------------------
+  virtual folly::Future<ChecksumStatus> checksum(size_t connectionId, const std::string &url, const std::string &type) = 0;
+};
+
+}
+
+#endif
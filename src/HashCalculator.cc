@@ -21,11 +21,32 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
  ************************************************************************/
 
+#include <openssl/evp.h>
 #include <openssl/sha.h>
+#include <algorithm>
+#include <cstdio>
 #include "HashCalculator.hh"
+#include "Macros.hh"
 using namespace eostest;
 
-std::string HashCalculator::base16Encode(const std::string &source) {
+namespace {
+  struct Crc32cTable {
+    uint32_t entries[256];
+
+    Crc32cTable() {
+      // Castagnoli polynomial, reflected
+      for(uint32_t i = 0; i < 256; i++) {
+        uint32_t value = i;
+        for(size_t bit = 0; bit < 8; bit++) {
+          value = (value & 1) ? (value >> 1) ^ 0x82F63B78 : (value >> 1);
+        }
+        entries[i] = value;
+      }
+    }
+  };
+}
+
+std::string HashCalculator::base16Encode(std::string_view source) {
   static const char* hexTable[] = {
     "00", "01", "02", "03", "04", "05", "06", "07", "08", "09", "0a", "0b", "0c", "0d", "0e", "0f", "10", "11",
     "12", "13", "14", "15", "16", "17", "18", "19", "1a", "1b", "1c", "1d", "1e", "1f", "20", "21", "22", "23",
@@ -55,9 +76,103 @@ std::string HashCalculator::base16Encode(const std::string &source) {
   return ret;
 }
 
-std::string HashCalculator::sha256(const std::string &contents) {
+std::string HashCalculator::sha256(std::string_view contents) {
   unsigned char hash[SHA256_DIGEST_LENGTH];
   SHA256( (const unsigned char*) contents.data(), contents.size(), hash);
 
   return std::string(  (char*) hash, SHA256_DIGEST_LENGTH);
 }
+
+std::string HashCalculator::sha256(std::string_view first, std::string_view second) {
+  unsigned char hash[SHA256_DIGEST_LENGTH];
+  unsigned int length = 0;
+
+  EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+  eost_assert(ctx != nullptr);
+
+  bool ok = EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr) == 1 &&
+            EVP_DigestUpdate(ctx, first.data(), first.size()) == 1 &&
+            EVP_DigestUpdate(ctx, second.data(), second.size()) == 1 &&
+            EVP_DigestFinal_ex(ctx, hash, &length) == 1;
+
+  EVP_MD_CTX_free(ctx);
+  eost_assert(ok && length == SHA256_DIGEST_LENGTH);
+
+  return std::string(  (char*) hash, SHA256_DIGEST_LENGTH);
+}
+
+uint64_t HashCalculator::hash64(const std::string &contents, uint64_t seed) {
+  // FNV-1a, followed by the splitmix64 finalizer to spread the bits
+  uint64_t hash = 0xcbf29ce484222325ULL ^ seed;
+  for(size_t i = 0; i < contents.size(); i++) {
+    hash ^= (unsigned char) contents[i];
+    hash *= 0x100000001b3ULL;
+  }
+
+  hash ^= hash >> 30;
+  hash *= 0xbf58476d1ce4e5b9ULL;
+  hash ^= hash >> 27;
+  hash *= 0x94d049bb133111ebULL;
+  hash ^= hash >> 31;
+  return hash;
+}
+
+uint32_t HashCalculator::adler32(uint32_t running, const char *data, size_t len) {
+  const uint32_t kModulo = 65521;
+  // Largest number of bytes before the sums could overflow 32 bits
+  const size_t kBlock = 5552;
+
+  uint32_t a = running & 0xffff;
+  uint32_t b = running >> 16;
+
+  while(len > 0) {
+    size_t block = std::min(len, kBlock);
+    len -= block;
+
+    for(size_t i = 0; i < block; i++) {
+      a += (unsigned char) data[i];
+      b += a;
+    }
+
+    data += block;
+    a %= kModulo;
+    b %= kModulo;
+  }
+
+  return (b << 16) | a;
+}
+
+uint32_t HashCalculator::crc32c(uint32_t running, const char *data, size_t len) {
+  static const Crc32cTable table;
+
+  uint32_t crc = ~running;
+  for(size_t i = 0; i < len; i++) {
+    crc = table.entries[(crc ^ (unsigned char) data[i]) & 0xff] ^ (crc >> 8);
+  }
+
+  return ~crc;
+}
+
+bool HashCalculator::isSupportedChecksum(const std::string &type) {
+  return type == "adler32" || type == "crc32c";
+}
+
+std::string HashCalculator::checksum(const std::string &type, const ContentBuffer &contents) {
+  if(!isSupportedChecksum(type)) return "";
+
+  bool adler = (type == "adler32");
+  uint32_t value = adler ? 1 : 0;
+
+  for(const ContentBuffer::Segment &segment : contents.getSegments()) {
+    if(adler) {
+      value = adler32(value, segment->data(), segment->size());
+    }
+    else {
+      value = crc32c(value, segment->data(), segment->size());
+    }
+  }
+
+  char buffer[9];
+  snprintf(buffer, sizeof(buffer), "%08x", value);
+  return std::string(buffer);
+}
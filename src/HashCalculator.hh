@@ -24,14 +24,34 @@
 #ifndef EOSTESTER_HASH_CALCULATOR_H
 #define EOSTESTER_HASH_CALCULATOR_H
 
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include "ContentBuffer.hh"
 
 namespace eostest {
 
 class HashCalculator {
 public:
-  static std::string sha256(const std::string &contents);
-  static std::string base16Encode(const std::string &contents);
+  static std::string sha256(std::string_view contents);
+  // Hash of first + second, without concatenating them.
+  static std::string sha256(std::string_view first, std::string_view second);
+  static std::string base16Encode(std::string_view contents);
+
+  // Fast, non-cryptographic hash - stable across platforms and runs.
+  static uint64_t hash64(const std::string &contents, uint64_t seed);
+
+  // Running checksums - start from the value returned for no data.
+  static uint32_t adler32(uint32_t running, const char *data, size_t len);
+  static uint32_t crc32c(uint32_t running, const char *data, size_t len);
+
+  //----------------------------------------------------------------------------
+  // Checksum of the given type ("adler32" or "crc32c") over all segments, as
+  // eight lowercase hex digits - the same form XRootD servers report. Empty
+  // string on unknown type.
+  //----------------------------------------------------------------------------
+  static bool isSupportedChecksum(const std::string &type);
+  static std::string checksum(const std::string &type, const ContentBuffer &contents);
 };
 
 }
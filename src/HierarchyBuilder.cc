@@ -21,89 +21,412 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
  ************************************************************************/
 
+#include <algorithm>
+#include <limits>
 #include <sstream>
 #include <iostream>
 #include "HierarchyBuilder.hh"
 #include "Macros.hh"
 #include "Utils.hh"
 #include "SelfCheckedFile.hh"
+#include "HashCalculator.hh"
 using namespace eostest;
 
 HierarchyBuilder::HierarchyBuilder(const HierarchyConstructionOptions &opt)
-: options(opt), generator(options.seed) {
+: options(opt), end(std::numeric_limits<uint64_t>::max()) {
 
-  options.files -= 1; // take top-level MANIFEST into account
+  // There's always at least the top-level MANIFEST
+  options.files = std::max<size_t>(1, options.files);
 
   while(!options.base.empty() && options.base.back() == '/') {
     options.base.pop_back();
   }
 
-  insertNode(options.base, 0);
+  stack.push_back(makeRoot());
 }
 
-void HierarchyBuilder::insertNode(const std::string &path, size_t depth) {
-  stack.emplace(path);
+uint64_t HierarchyBuilder::getTotalFiles() const {
+  return options.files;
+}
+
+std::mt19937 HierarchyBuilder::streamFor(const std::string &key) const {
+  uint64_t hash = HashCalculator::hash64(key, (uint64_t) options.seed);
+  std::seed_seq seq { (uint32_t) hash, (uint32_t) (hash >> 32) };
+  return std::mt19937(seq);
+}
+
+HierarchyBuilder::Node HierarchyBuilder::makeRoot() {
+  // With a depth distribution, each top-level directory draws the depth of
+  // its branch
+  size_t maxDepth = options.depth;
+  if(!options.shape.depth.empty()) maxDepth = std::numeric_limits<size_t>::max();
+
+  return makeNode("", 0, maxDepth, 0, options.files);
+}
+
+HierarchyBuilder::Node HierarchyBuilder::makeNode(const std::string &relativePath, size_t depth, size_t maxDepth, uint64_t firstIndex, uint64_t budget) {
+  Node node;
+  node.relativePath = relativePath;
+  node.path = options.base + relativePath;
+  node.depth = depth;
+  node.maxDepth = maxDepth;
+  node.firstIndex = firstIndex;
+  node.budget = budget;
+  node.manifest = Manifest(node.path + "/MANIFEST");
+
+  std::mt19937 generator = streamFor(relativePath);
+
+  if(depth == 1 && !options.shape.depth.empty()) {
+    node.maxDepth = std::max<uint64_t>(1, options.shape.depth.sample(generator));
+  }
 
   // Roll dice to decide how many subdirs and files to insert
-  std::uniform_int_distribution<> distr(0, 10);
-  size_t files = distr(generator) + 1;
-  size_t subdirs = distr(generator);
+  uint64_t remaining = budget - 1;
+  uint64_t files = std::min<uint64_t>(remaining, options.shape.files.sample(generator));
+  uint64_t subdirs = options.shape.subdirs.sample(generator);
+
+  if(depth >= node.maxDepth) {
+    // No deeper levels to hand the rest of the budget to
+    files = remaining;
+    subdirs = 0;
+  }
+  else {
+    subdirs = std::min(remaining - files, subdirs);
+    if(subdirs == 0 && remaining > files) subdirs = 1;
+  }
+
+  // Too many entries for a single MANIFEST: the shards are paid for out of
+  // the budget like any other file - first from what the subdirectories
+  // would inherit, then from this directory's own files and subdirs.
+  uint64_t shards = 0;
+  uint64_t shardSize = options.manifestShardSize;
+
+  if(shardSize != 0 && files + subdirs > shardSize) {
+    if(subdirs == 0) {
+      // Everything goes to files, leave room for the shards listing them
+      shards = (files + shardSize) / (shardSize + 1);
+      files -= shards;
+    }
+    else {
+      shards = (files + subdirs + shardSize - 1) / shardSize;
+      uint64_t missing = shards - std::min(shards, remaining - files - subdirs);
+      uint64_t fromFiles = std::min(files, missing);
+      files -= fromFiles;
+      subdirs -= missing - fromFiles;
+    }
+
+    remaining -= shards;
+  }
+
+  remaining -= files;
+
+  // Each round draws as many names as are still missing, so what's kept is
+  // exactly the first distinct names of the stream - same as adding them one
+  // at a time, without inserting into the middle of the table each time.
+  std::vector<std::string> names;
+  while(node.manifest.fileCount() != files) {
+    names.clear();
+    for(size_t i = node.manifest.fileCount(); i < files; i++) {
+      names.emplace_back(getRandomAlphanumericBytes(5, generator));
+    }
+
+    node.manifest.tryAddFiles(names);
+  }
+
+  while(node.manifest.subdirCount() != subdirs) {
+    names.clear();
+    for(size_t i = node.manifest.subdirCount(); i < subdirs; i++) {
+      names.emplace_back(getRandomAlphanumericBytes(5, generator));
+    }
+
+    node.manifest.tryAddSubdirs(names);
+  }
 
-  files = std::min(options.files, files);
-  options.files -= files;
+  if(shards != 0) {
+    splitManifest(node, shards);
+  }
+
+  // Every subdirectory gets its own MANIFEST, plus a random share of what's
+  // left over.
+  if(subdirs != 0) {
+    std::uniform_int_distribution<uint64_t> weightDistr(1, 100);
+    std::vector<uint64_t> weights(subdirs);
+    uint64_t totalWeight = 0;
+
+    for(size_t i = 0; i < subdirs; i++) {
+      weights[i] = weightDistr(generator);
+      totalWeight += weights[i];
+    }
+
+    uint64_t extra = remaining - subdirs;
+    uint64_t assigned = 0;
+    std::vector<uint64_t> budgets(subdirs);
+
+    for(size_t i = 0; i < subdirs; i++) {
+      budgets[i] = 1 + (extra * weights[i]) / totalWeight;
+      assigned += budgets[i] - 1;
+    }
+
+    for(size_t i = 0; assigned < extra; i++, assigned++) {
+      budgets[i]++;
+    }
+
+    // Lay out the children one after the other, following this directory's
+    // own files
+    node.subdirStarts.reserve(subdirs + 1);
+    node.subdirStarts.push_back(firstIndex + node.fileSlots());
+
+    for(size_t i = 0; i < subdirs; i++) {
+      node.subdirStarts.push_back(node.subdirStarts.back() + budgets[i]);
+    }
+  }
+
+  for(std::string_view file : node.files()) {
+    if(options.checksumType.empty()) {
+      node.manifest.setSize(file, getFileSize(SSTR(relativePath << "/" << file), SSTR(node.path << "/" << file)));
+      continue;
+    }
+
+    // Contents are a function of the path alone - hash them now, and
+    // generate them again once the file is emitted, rather than holding the
+    // whole directory's data in memory.
+    ContentBuffer contents = getFileContents(SSTR(relativePath << "/" << file), SSTR(node.path << "/" << file));
+    node.manifest.setSize(file, contents.size());
+    node.manifest.setChecksum(file, SSTR(options.checksumType << ":" << HashCalculator::checksum(options.checksumType, contents)));
+  }
+
+  return node;
+}
+
+void HierarchyBuilder::splitManifest(Node &node, size_t shards) {
+  // Cut the merged, sorted listing of files and subdirs into consecutive
+  // slices of near-equal size
+  const NameTable &files = node.files();
+  const NameTable &subdirs = node.subdirs();
+  size_t total = files.size() + subdirs.size();
+  size_t file = 0;
+  size_t subdir = 0;
+
+  for(size_t i = 0; i <= shards; i++) {
+    size_t start = (total * i) / shards;
 
-  while(stack.top().manifest.fileCount() != files) {
-    stack.top().manifest.tryAddFile(getRandomAlphanumericBytes(5, generator));
+    while(file + subdir < start) {
+      if(subdir == subdirs.size() || (file < files.size() && files[file] < subdirs[subdir])) {
+        file++;
+      }
+      else {
+        subdir++;
+      }
+    }
+
+    node.shardBounds.emplace_back(file, subdir);
   }
+}
+
+Manifest HierarchyBuilder::makeManifestIndex(const Node &node) const {
+  Manifest index(node.manifest.getFilename());
+  for(size_t i = 0; i < node.shardCount(); i++) {
+    index.addShard(Manifest::shardName(i));
+  }
+
+  return index;
+}
 
-  if(depth >= options.depth) return;
+Manifest HierarchyBuilder::makeManifestShard(const Node &node, size_t shard) const {
+  Manifest manifest(SSTR(node.path << "/" << Manifest::shardName(shard)));
 
-  subdirs = std::min(options.files, subdirs);
-  options.files -= subdirs;
+  for(size_t i = node.shardBounds[shard].first; i < node.shardBounds[shard + 1].first; i++) {
+    manifest.tryAddFile(node.files()[i]);
 
-  while(stack.top().manifest.subdirCount() != subdirs) {
-    stack.top().manifest.tryAddSubdir(getRandomAlphanumericBytes(5, generator));
+    uint64_t size;
+    if(node.manifest.getSize(node.files()[i], size)) {
+      manifest.setSize(node.files()[i], size);
+    }
+
+    std::string checksum;
+    if(node.manifest.getChecksum(node.files()[i], checksum)) {
+      manifest.setChecksum(node.files()[i], checksum);
+    }
   }
+
+  for(size_t i = node.shardBounds[shard].second; i < node.shardBounds[shard + 1].second; i++) {
+    manifest.tryAddSubdir(node.subdirs()[i]);
+  }
+
+  return manifest;
+}
+
+std::string HierarchyBuilder::serialize(const Manifest &manifest) const {
+  return options.binaryManifests ? manifest.toBinary() : manifest.toString();
+}
+
+uint64_t HierarchyBuilder::childIndex(const Node &parent, size_t subdir) const {
+  return parent.subdirStarts[subdir];
+}
+
+HierarchyBuilder::Node HierarchyBuilder::makeChild(const Node &parent, size_t subdir) {
+  return makeNode(SSTR(parent.relativePath << "/" << parent.subdirs()[subdir]), parent.depth + 1,
+    parent.maxDepth, childIndex(parent, subdir), parent.subdirStarts[subdir + 1] - parent.subdirStarts[subdir]);
+}
+
+//------------------------------------------------------------------------------
+// Size of what getFileContents would return, drawing only the length.
+//------------------------------------------------------------------------------
+uint64_t HierarchyBuilder::getFileSize(const std::string &relativePath, const std::string &path) const {
+  std::mt19937 generator = streamFor(relativePath);
+  return SelfCheckedFile::sizeFor(path, options.shape.fileSize.sample(generator));
 }
 
-std::string HierarchyBuilder::getRandomFileContents() {
+ContentBuffer HierarchyBuilder::getFileContents(const std::string &relativePath, const std::string &path) {
+  std::mt19937 generator = streamFor(relativePath);
+
   // Roll dice to decide file length
-  std::uniform_int_distribution<> distr(1, 256);
-  return getRandomPrintableBytes(distr(generator), generator);
+  size_t length = options.shape.fileSize.sample(generator);
+
+  if(!options.contentTemplates) {
+    return SelfCheckedFile(path, getRandomPrintableBytes(length, generator)).toString();
+  }
+
+  // Re-use the body for all files of this length
+  auto it = templates.find(length);
+  if(it == templates.end()) {
+    // Wide size distributions give nearly every file its own length - start
+    // over rather than keep them all. Bodies still in use stay alive through
+    // their segments.
+    if(templateBytes + length > kMaxTemplateBytes) {
+      templates.clear();
+      templateBytes = 0;
+    }
+
+    std::mt19937 templateGenerator = streamFor(SSTR("#template-" << length));
+    ContentBuffer::Segment body = SelfCheckedFile::makeTemplateBody(getRandomPrintableBytes(length, templateGenerator));
+    it = templates.emplace(length, body).first;
+    templateBytes += length;
+  }
+
+  return SelfCheckedFile::fromTemplate(path, it->second);
 }
 
-bool HierarchyBuilder::next(HierarchyEntry &result) {
-  while(!stack.empty()) {
-    if(!stack.top().manifestDone) {
-      stack.top().manifestDone = true;
-      result.fullPath = stack.top().manifest.getFilename();
-      result.contents = stack.top().manifest.toString();
-      result.dir = false;
+bool HierarchyBuilder::seek(uint64_t index) {
+  if(index >= getTotalFiles()) return false;
+
+  stack.clear();
+  stack.push_back(makeRoot());
+
+  while(true) {
+    Node &top = stack.back();
+
+    if(index < top.firstIndex + top.fileSlots()) {
+      top.nextFile = index - top.firstIndex;
       return true;
     }
 
-    std::string nextFile;
-    if(stack.top().manifest.popFile(nextFile)) {
-      result.fullPath = SSTR(stack.top().path <<  "/" << nextFile);
-      result.contents = SelfCheckedFile(result.fullPath, getRandomFileContents() ).toString();
+    top.nextFile = top.fileSlots();
+
+    // The last subdirectory starting at or before index contains it
+    size_t subdir = std::upper_bound(top.subdirStarts.begin(), top.subdirStarts.end() - 1, index) - top.subdirStarts.begin() - 1;
+
+    if(childIndex(top, subdir) == index) {
+      // A subdirectory's MANIFEST: start from its directory entry
+      top.nextSubdir = subdir;
+      return true;
+    }
+
+    top.nextSubdir = subdir + 1;
+    Node child = makeChild(top, subdir);
+    stack.push_back(std::move(child));
+  }
+}
+
+bool HierarchyBuilder::seekToDirectory(const std::string &fullPath) {
+  std::string path = fullPath;
+  while(!path.empty() && path.back() == '/') {
+    path.pop_back();
+  }
+
+  if(path.compare(0, options.base.size(), options.base) != 0) return false;
+  std::string relativePath = path.substr(options.base.size());
+  if(!relativePath.empty() && relativePath[0] != '/') return false;
+
+  Node node = makeRoot();
+
+  size_t pos = 0;
+  while(pos < relativePath.size()) {
+    size_t next = relativePath.find('/', pos + 1);
+    if(next == std::string::npos) next = relativePath.size();
+    std::string component = relativePath.substr(pos + 1, next - pos - 1);
+    pos = next;
+
+    size_t subdir = node.subdirs().lowerBound(component);
+    if(subdir == node.subdirs().size() || node.subdirs()[subdir] != component) return false;
+
+    Node child = makeChild(node, subdir);
+    node = std::move(child);
+  }
+
+  stack.clear();
+  stack.push_back(std::move(node));
+  return true;
+}
+
+void HierarchyBuilder::setEnd(uint64_t index) {
+  end = index;
+}
+
+bool HierarchyBuilder::next(HierarchyEntry &result) {
+  while(!stack.empty()) {
+    Node &top = stack.back();
+
+    if(top.nextFile < top.fileSlots()) {
+      result.index = top.firstIndex + top.nextFile;
+      if(result.index >= end) break;
+
       result.dir = false;
+
+      if(top.nextFile == 0 && top.shardCount() == 0) {
+        result.fullPath = top.manifest.getFilename();
+        result.contents = serialize(top.manifest);
+      }
+      else if(top.nextFile == 0) {
+        Manifest index = makeManifestIndex(top);
+        result.fullPath = index.getFilename();
+        result.contents = serialize(index);
+      }
+      else if(top.nextFile <= top.shardCount()) {
+        Manifest shard = makeManifestShard(top, top.nextFile - 1);
+        result.fullPath = shard.getFilename();
+        result.contents = serialize(shard);
+      }
+      else {
+        std::string_view file = top.files()[top.nextFile - 1 - top.shardCount()];
+        result.fullPath = SSTR(top.path << "/" << file);
+        result.contents = getFileContents(SSTR(top.relativePath << "/" << file), result.fullPath);
+      }
+
+      top.nextFile++;
       return true;
     }
 
     // No more files, add next directory
-    std::string nextDir;
-    if(stack.top().manifest.popSubdir(nextDir)) {
-      result.fullPath = SSTR(stack.top().path << "/" << nextDir);
-      result.contents = "";
+    if(top.nextSubdir < top.subdirs().size()) {
+      result.index = childIndex(top, top.nextSubdir);
+      if(result.index >= end) break;
+
+      Node child = makeChild(top, top.nextSubdir);
+      top.nextSubdir++;
+
+      result.fullPath = child.path;
+      result.contents = ContentBuffer();
       result.dir = true;
 
-      insertNode(result.fullPath, stack.size());
+      stack.push_back(std::move(child));
       return true;
     }
 
     // Nope, pop
-    stack.pop();
+    stack.pop_back();
   }
 
+  stack.clear();
   return false;
 }
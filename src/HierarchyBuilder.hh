@@ -24,11 +24,15 @@
 #ifndef EOSTESTER_HIERARCHY_BUILDER_H
 #define EOSTESTER_HIERARCHY_BUILDER_H
 
+#include <cstdint>
+#include <map>
 #include <string>
 #include <random>
-#include <stack>
+#include <vector>
 
+#include "ContentBuffer.hh"
 #include "Manifest.hh"
+#include "TreeShape.hh"
 
 namespace eostest {
 
@@ -37,36 +41,147 @@ struct HierarchyConstructionOptions {
   int32_t seed;
   size_t depth;
   size_t files; // total number of files, including manifests
+
+  // Files of equal size share the same random bytes, only the header and
+  // checksum differ - much cheaper to generate, and no per-file body in memory.
+  bool contentTemplates = false;
+
+  // Record the checksum of each file in its MANIFEST, using this algorithm
+  // (adler32 or crc32c). File contents of a directory are then generated
+  // when its MANIFEST is, and kept until emitted.
+  std::string checksumType;
+
+  // Distributions of directory fan-out, file counts and sizes. With a depth
+  // distribution, it replaces depth above.
+  TreeShape shape;
+
+  // Directories with more entries than this get a sharded MANIFEST: an index,
+  // plus shards of at most this many entries each, which count as files of
+  // the tree. 0 never shards.
+  size_t manifestShardSize = 0;
+
+  // Write MANIFESTs in the binary v2 format instead of text.
+  bool binaryManifests = false;
 };
 
 struct HierarchyEntry {
   std::string fullPath;
-  std::string contents;
+  ContentBuffer contents;
   bool dir;
+
+  // Position in the tree: for files, the number of files (including
+  // MANIFESTs) preceding this one in the walk. A directory carries the
+  // index of its own MANIFEST.
+  uint64_t index = 0;
 };
 
+//------------------------------------------------------------------------------
+// Generates a random namespace tree, as a depth-first walk: each directory
+// is followed by its MANIFEST (and any MANIFEST shards), its files, then its
+// subdirectories.
+//
+// Every directory draws its random numbers from its own stream, seeded by
+// (seed, path relative to base), and splits the files of its subtree among
+// its subdirectories up-front. Any directory or file index can thus be
+// reached directly without walking everything before it, and shards of the
+// walk produced independently join up into exactly the sequential tree.
+//------------------------------------------------------------------------------
 class HierarchyBuilder {
 public:
   HierarchyBuilder(const HierarchyConstructionOptions &opts);
   bool next(HierarchyEntry &result);
 
-private:
-  void insertNode(const std::string &path, size_t depth);
-  std::string getRandomFileContents();
+  //----------------------------------------------------------------------------
+  // Total number of files in the tree, including MANIFESTs.
+  //----------------------------------------------------------------------------
+  uint64_t getTotalFiles() const;
 
-  HierarchyConstructionOptions options;
-  std::mt19937 generator;
+  //----------------------------------------------------------------------------
+  // Continue the walk from file index: next() returns that file - or, for
+  // the MANIFEST of a subdirectory, the directory entry right before it.
+  // Ancestor directories are considered already visited. False if out of
+  // range.
+  //----------------------------------------------------------------------------
+  bool seek(uint64_t index);
+
+  //----------------------------------------------------------------------------
+  // Restrict the walk to the subtree rooted at the given directory, full
+  // path: next() begins with its MANIFEST, and ends once the subtree is
+  // done. False if there's no such directory.
+  //----------------------------------------------------------------------------
+  bool seekToDirectory(const std::string &path);
 
+  //----------------------------------------------------------------------------
+  // Stop the walk right before what seek(end) would start from. Combined
+  // with seek(begin), yields shard [begin, end) of the walk: consecutive
+  // shards add up to exactly the full walk.
+  //----------------------------------------------------------------------------
+  void setEnd(uint64_t end);
+
+private:
   struct Node {
-    Node(const std::string &dirname) : manifest(dirname + "/MANIFEST"),
-      path(dirname) {}
+    std::string path;
+    std::string relativePath;
+    size_t depth = 0;
+    size_t maxDepth = 0; // of the branch this directory is in
 
+    uint64_t firstIndex = 0; // index of this directory's MANIFEST
+    uint64_t budget = 0;     // files in the whole subtree, MANIFEST included
+
+    // Names of files and subdirs, in order, live only in the MANIFEST
     Manifest manifest;
-    bool manifestDone = false;
-    std::string path;
+    // Index of each subdirectory's MANIFEST, in order, followed by the end
+    // of this subtree as a sentinel. Empty if there are no subdirectories.
+    std::vector<uint64_t> subdirStarts;
+
+    const NameTable& files() const {
+      return manifest.getFiles();
+    }
+
+    const NameTable& subdirs() const {
+      return manifest.getDirectories();
+    }
+
+    // Sharded MANIFEST: shard i lists files [first, next first) and subdirs
+    // [second, next second), with a sentinel at the end. Empty if unsharded.
+    std::vector<std::pair<size_t, size_t>> shardBounds;
+
+    size_t shardCount() const {
+      return shardBounds.empty() ? 0 : shardBounds.size() - 1;
+    }
+
+    // MANIFEST, shards and files
+    uint64_t fileSlots() const {
+      return 1 + shardCount() + files().size();
+    }
+
+    // Walk position: 0 is the MANIFEST, then shards, then files, then
+    // subdirectories
+    size_t nextFile = 0;
+    size_t nextSubdir = 0;
   };
 
-  std::stack<Node> stack;
+  Node makeNode(const std::string &relativePath, size_t depth, size_t maxDepth, uint64_t firstIndex, uint64_t budget);
+  Node makeRoot();
+  Node makeChild(const Node &parent, size_t subdir);
+  uint64_t childIndex(const Node &parent, size_t subdir) const;
+  void splitManifest(Node &node, size_t shards);
+  Manifest makeManifestIndex(const Node &node) const;
+  Manifest makeManifestShard(const Node &node, size_t shard) const;
+  std::string serialize(const Manifest &manifest) const;
+
+  std::mt19937 streamFor(const std::string &key) const;
+  uint64_t getFileSize(const std::string &relativePath, const std::string &path) const;
+  ContentBuffer getFileContents(const std::string &relativePath, const std::string &path);
+
+  HierarchyConstructionOptions options;
+  uint64_t end;
+
+  // Template bodies by length, holding at most kMaxTemplateBytes
+  static constexpr uint64_t kMaxTemplateBytes = 64 * 1024 * 1024;
+  std::map<size_t, ContentBuffer::Segment> templates;
+  uint64_t templateBytes = 0;
+  std::vector<Node> stack;
 };
 
 }
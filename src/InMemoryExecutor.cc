@@ -0,0 +1,319 @@
+// ----------------------------------------------------------------------
+// File: InMemoryExecutor.cc
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include <folly/concurrency/ConcurrentHashMap.h>
+
+#include "InMemoryExecutor.hh"
+#include "utils/Sealing.hh"
+#include "Macros.hh"
+#include "Utils.hh"
+#include "HashCalculator.hh"
+using namespace eostest;
+
+struct InMemoryExecutor::Inode {
+  using Children = folly::ConcurrentHashMap<std::string, std::shared_ptr<Inode>>;
+
+  // Directory
+  Inode() : children(new Children()) {}
+
+  // File
+  Inode(std::string cont) : contents(std::move(cont)) {}
+
+  bool isDir() const {
+    return children.get() != nullptr;
+  }
+
+  const std::string contents;
+  const std::unique_ptr<Children> children;
+};
+
+using Inode = InMemoryExecutor::Inode;
+
+namespace {
+
+std::vector<std::string> splitComponents(const std::string &url) {
+  std::string host, path;
+  if(!splitURL(url, host, path)) {
+    path = url;
+  }
+
+  size_t opaque = path.find('?');
+  if(opaque != std::string::npos) {
+    path.erase(opaque);
+  }
+
+  std::vector<std::string> components;
+  size_t start = 0;
+  while(start <= path.size()) {
+    size_t end = path.find('/', start);
+    if(end == std::string::npos) end = path.size();
+
+    if(end != start) {
+      components.emplace_back(path, start, end - start);
+    }
+
+    start = end + 1;
+  }
+
+  return components;
+}
+
+//------------------------------------------------------------------------------
+// Walk the first "count" components, starting from root. Returns nullptr if
+// any of them is missing, or not a directory.
+//------------------------------------------------------------------------------
+std::shared_ptr<Inode> lookup(std::shared_ptr<Inode> current, const std::vector<std::string> &components, size_t count) {
+  for(size_t i = 0; i < count; i++) {
+    if(!current->isDir()) return nullptr;
+
+    auto it = current->children->find(components[i]);
+    if(it == current->children->end()) return nullptr;
+    current = it->second;
+  }
+
+  return current;
+}
+
+std::shared_ptr<Inode> lookupParent(std::shared_ptr<Inode> root, const std::vector<std::string> &components) {
+  if(components.empty()) return nullptr;
+
+  std::shared_ptr<Inode> parent = lookup(root, components, components.size() - 1);
+  if(!parent || !parent->isDir()) return nullptr;
+  return parent;
+}
+
+TestcaseStatus insert(std::shared_ptr<Inode> root, const std::string &url, std::shared_ptr<Inode> inode) {
+  std::vector<std::string> components = splitComponents(url);
+
+  std::shared_ptr<Inode> parent = lookupParent(root, components);
+  if(!parent) {
+    return TestcaseStatus(SSTR("No such directory: parent of " << url));
+  }
+
+  if(!parent->children->insert(components.back(), inode).second) {
+    return TestcaseStatus(SSTR("File exists: " << url));
+  }
+
+  return TestcaseStatus();
+}
+
+TestcaseStatus insertPath(std::shared_ptr<Inode> root, const std::string &url) {
+  std::vector<std::string> components = splitComponents(url);
+
+  std::shared_ptr<Inode> current = root;
+  for(size_t i = 0; i < components.size(); i++) {
+    // Whoever gets to insert first wins, the rest of us walk into theirs
+    std::shared_ptr<Inode> dir = current->children->insert(components[i], std::make_shared<Inode>()).first->second;
+    if(!dir->isDir()) {
+      return TestcaseStatus(SSTR("Not a directory: " << components[i] << " in " << url));
+    }
+
+    current = dir;
+  }
+
+  return TestcaseStatus();
+}
+
+TestcaseStatus remove(std::shared_ptr<Inode> root, const std::string &url, bool dir) {
+  std::vector<std::string> components = splitComponents(url);
+
+  std::shared_ptr<Inode> parent = lookupParent(root, components);
+  if(!parent) {
+    return TestcaseStatus(SSTR("No such directory: parent of " << url));
+  }
+
+  auto it = parent->children->find(components.back());
+  if(it == parent->children->end()) {
+    return TestcaseStatus(SSTR("No such file or directory: " << url));
+  }
+
+  if(it->second->isDir() != dir) {
+    return TestcaseStatus(SSTR((dir ? "Not a directory: " : "Is a directory: ") << url));
+  }
+
+  // Not atomic with respect to concurrent insertions into the directory
+  // being removed, but good enough for a fake server.
+  if(dir && !it->second->children->empty()) {
+    return TestcaseStatus(SSTR("Directory not empty: " << url));
+  }
+
+  parent->children->erase(components.back());
+  return TestcaseStatus();
+}
+
+}
+
+InMemoryExecutor::InMemoryExecutor(std::chrono::milliseconds latency)
+: root(std::make_shared<Inode>()) {
+  latencies.fill(latency);
+}
+
+void InMemoryExecutor::setLatency(OpType op, std::chrono::milliseconds latency) {
+  latencies[(size_t) op] = latency;
+}
+
+InMemoryExecutor::~InMemoryExecutor() {}
+
+template<typename T, typename F>
+folly::Future<T> InMemoryExecutor::execute(OpType op, F &&operation, const std::string &description) {
+  std::chrono::milliseconds latency = latencies[(size_t) op];
+
+  if(latency.count() == 0) {
+    return Sealing::seal(folly::makeFuture<T>(operation()), description, op);
+  }
+
+  folly::Future<T> fut = folly::futures::sleep(latency)
+    .thenValue([op = std::move(operation)](folly::Unit) mutable { return op(); });
+
+  return Sealing::seal(std::move(fut), description, op);
+}
+
+folly::Future<TestcaseStatus> InMemoryExecutor::mkdir(size_t connectionId, const std::string &url) {
+  std::shared_ptr<Inode> r = root;
+  return execute<TestcaseStatus>(OpType::kMkdir, [r, url]() {
+    return insert(r, url, std::make_shared<Inode>());
+  }, SSTR("memory::mkdir on '" << url << "'"));
+}
+
+folly::Future<TestcaseStatus> InMemoryExecutor::mkdirs(size_t connectionId, const std::string &url) {
+  std::shared_ptr<Inode> r = root;
+  return execute<TestcaseStatus>(OpType::kMkdir, [r, url]() {
+    return insertPath(r, url);
+  }, SSTR("memory::mkdirs on '" << url << "'"));
+}
+
+folly::Future<TestcaseStatus> InMemoryExecutor::put(size_t connectionId, const std::string &url, const ContentBuffer &contents) {
+  std::shared_ptr<Inode> r = root;
+  std::shared_ptr<Inode> inode = std::make_shared<Inode>(contents.toString());
+
+  return execute<TestcaseStatus>(OpType::kPut, [r, url, inode]() {
+    return insert(r, url, inode);
+  }, SSTR("memory::put on '" << url << "'"));
+}
+
+folly::Future<TestcaseStatus> InMemoryExecutor::putStream(size_t connectionId, const std::string &url, std::shared_ptr<ContentGenerator> generator, const StreamingOptions &opts) {
+  // Go through the generator chunk by chunk as a real server would see it,
+  // but we have to keep the result in memory, of course.
+  std::string contents;
+  contents.resize(generator->size());
+
+  for(uint64_t offset = 0; offset < generator->size(); offset += opts.chunkSize) {
+    size_t length = std::min<uint64_t>(opts.chunkSize, generator->size() - offset);
+    generator->fill(offset, &contents[offset], length);
+  }
+
+  std::shared_ptr<Inode> r = root;
+  std::shared_ptr<Inode> inode = std::make_shared<Inode>(std::move(contents));
+
+  return execute<TestcaseStatus>(OpType::kPutStream, [r, url, inode]() {
+    return insert(r, url, inode);
+  }, SSTR("memory::putStream on '" << url << "'"));
+}
+
+folly::Future<TestcaseStatus> InMemoryExecutor::rm(size_t connectionId, const std::string &url) {
+  std::shared_ptr<Inode> r = root;
+  return execute<TestcaseStatus>(OpType::kRm, [r, url]() {
+    return remove(r, url, false);
+  }, SSTR("memory::rm on '" << url << "'"));
+}
+
+folly::Future<TestcaseStatus> InMemoryExecutor::rmdir(size_t connectionId, const std::string &url) {
+  std::shared_ptr<Inode> r = root;
+  return execute<TestcaseStatus>(OpType::kRmdir, [r, url]() {
+    return remove(r, url, true);
+  }, SSTR("memory::rmdir on '" << url << "'"));
+}
+
+folly::Future<ReadStatus> InMemoryExecutor::get(size_t connectionId, const std::string &url) {
+  std::shared_ptr<Inode> r = root;
+  return execute<ReadStatus>(OpType::kGet, [r, url]() {
+    std::vector<std::string> components = splitComponents(url);
+    std::shared_ptr<Inode> inode = lookup(r, components, components.size());
+
+    if(!inode) return ReadStatus(SSTR("No such file or directory: " << url));
+    if(inode->isDir()) return ReadStatus(SSTR("Is a directory: " << url));
+
+    ReadStatus status;
+    status.contents = inode->contents;
+    return status;
+  }, SSTR("memory::get on '" << url << "'"));
+}
+
+folly::Future<TestcaseStatus> InMemoryExecutor::getStream(size_t connectionId, const std::string &url, std::shared_ptr<ChunkConsumer> consumer, const StreamingOptions &opts) {
+  std::shared_ptr<Inode> r = root;
+  size_t chunkSize = std::max<size_t>(opts.chunkSize, 1);
+
+  return execute<TestcaseStatus>(OpType::kGetStream, [r, url, consumer, chunkSize]() {
+    std::vector<std::string> components = splitComponents(url);
+    std::shared_ptr<Inode> inode = lookup(r, components, components.size());
+
+    if(!inode) return TestcaseStatus(SSTR("No such file or directory: " << url));
+    if(inode->isDir()) return TestcaseStatus(SSTR("Is a directory: " << url));
+
+    const std::string &contents = inode->contents;
+    for(size_t offset = 0; offset < contents.size(); offset += chunkSize) {
+      consumer->consume(contents.c_str() + offset, std::min(chunkSize, contents.size() - offset));
+    }
+
+    return consumer->finish();
+  }, SSTR("memory::getStream on '" << url << "'"));
+}
+
+folly::Future<DirListStatus> InMemoryExecutor::dirList(size_t connectionId, const std::string &url) {
+  std::shared_ptr<Inode> r = root;
+  return execute<DirListStatus>(OpType::kDirList, [r, url]() {
+    std::vector<std::string> components = splitComponents(url);
+    std::shared_ptr<Inode> inode = lookup(r, components, components.size());
+
+    if(!inode) return DirListStatus(SSTR("No such file or directory: " << url));
+    if(!inode->isDir()) return DirListStatus(SSTR("Not a directory: " << url));
+
+    DirListStatus status;
+    status.contents.reset(new XrdCl::DirectoryList());
+
+    for(auto it = inode->children->cbegin(); it != inode->children->cend(); it++) {
+      uint32_t flags = it->second->isDir() ? XrdCl::StatInfo::IsDir : 0;
+      XrdCl::StatInfo *statInfo = new XrdCl::StatInfo("0", it->second->contents.size(), flags, 0);
+      status.contents->Add(new XrdCl::DirectoryList::ListEntry("", it->first, statInfo));
+    }
+
+    return status;
+  }, SSTR("memory::DirList on '" << url << "'"));
+}
+
+folly::Future<ChecksumStatus> InMemoryExecutor::checksum(size_t connectionId, const std::string &url, const std::string &type) {
+  std::shared_ptr<Inode> r = root;
+  return execute<ChecksumStatus>(OpType::kChecksum, [r, url, type]() {
+    std::vector<std::string> components = splitComponents(url);
+    std::shared_ptr<Inode> inode = lookup(r, components, components.size());
+
+    if(!inode) return ChecksumStatus(SSTR("No such file or directory: " << url));
+    if(inode->isDir()) return ChecksumStatus(SSTR("Is a directory: " << url));
+    if(!HashCalculator::isSupportedChecksum(type)) return ChecksumStatus(SSTR("Unsupported checksum type: " << type));
+
+    ChecksumStatus status;
+    status.type = type;
+    status.value = HashCalculator::checksum(type, ContentBuffer(inode->contents));
+    return status;
+  }, SSTR("memory::checksum on '" << url << "'"));
+}
@@ -0,0 +1,78 @@
+// ----------------------------------------------------------------------
+// File: InMemoryExecutor.hh
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef EOSTESTER_IN_MEMORY_EXECUTOR_H
+#define EOSTESTER_IN_MEMORY_EXECUTOR_H
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include "Executor.hh"
+#include "utils/LatencyHistogram.hh"
+
+namespace eostest {
+
+//------------------------------------------------------------------------------
+// A fake, in-process server: keeps a namespace in memory, one
+// folly::ConcurrentHashMap per directory, so lookups are lock-free. Useful for
+// measuring the throughput ceiling of the tester itself, and for running
+// testcases without any network.
+//
+// If latency is non-zero, every operation is applied and completed only
+// after the given delay has elapsed, simulating a round-trip to a server.
+// setLatency() overrides it per operation type, ie to model a slow MGM.
+// The host part of the URL, and connectionId, are ignored.
+//------------------------------------------------------------------------------
+class InMemoryExecutor : public Executor {
+public:
+  InMemoryExecutor(std::chrono::milliseconds latency = std::chrono::milliseconds(0));
+  virtual ~InMemoryExecutor();
+
+  // Not thread-safe: call before issuing any operations.
+  void setLatency(OpType op, std::chrono::milliseconds latency);
+
+  virtual folly::Future<TestcaseStatus> mkdir(size_t connectionId, const std::string &url) override;
+  virtual folly::Future<TestcaseStatus> mkdirs(size_t connectionId, const std::string &url) override;
+  virtual folly::Future<TestcaseStatus> put(size_t connectionId, const std::string &url, const ContentBuffer &contents) override;
+  virtual folly::Future<TestcaseStatus> putStream(size_t connectionId, const std::string &url, std::shared_ptr<ContentGenerator> generator, const StreamingOptions &opts) override;
+  virtual folly::Future<TestcaseStatus> rm(size_t connectionId, const std::string &url) override;
+  virtual folly::Future<TestcaseStatus> getStream(size_t connectionId, const std::string &url, std::shared_ptr<ChunkConsumer> consumer, const StreamingOptions &opts) override;
+  virtual folly::Future<ReadStatus> get(size_t connectionId, const std::string &url) override;
+  virtual folly::Future<DirListStatus> dirList(size_t connectionId, const std::string &url) override;
+  virtual folly::Future<TestcaseStatus> rmdir(size_t connectionId, const std::string &url) override;
+  virtual folly::Future<ChecksumStatus> checksum(size_t connectionId, const std::string &url, const std::string &type) override;
+
+  struct Inode;
+
+private:
+  std::shared_ptr<Inode> root;
+  std::array<std::chrono::milliseconds, (size_t) OpType::kCount> latencies;
+
+  template<typename T, typename F>
+  folly::Future<T> execute(OpType op, F &&operation, const std::string &description);
+};
+
+}
+
+#endif
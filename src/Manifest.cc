@@ -21,12 +21,12 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
  ************************************************************************/
 
-#include <sstream>
-#include <iostream>
+#include <algorithm>
 
 #include <XrdCl/XrdClXRootDResponses.hh>
 
 #include "Manifest.hh"
+#include "BinaryManifestView.hh"
 #include "HashCalculator.hh"
 #include "Utils.hh"
 #include "Macros.hh"
@@ -37,6 +37,27 @@ namespace {
   const std::string kSeparator = "----------\n";
   const std::string kSubdir = "SUBDIR: ";
   const std::string kFile = "FILE: ";
+  const std::string kSize = " SIZE: ";
+  const std::string kChecksum = " CHECKSUM: ";
+  const std::string kShard = "SHARD: ";
+}
+
+//------------------------------------------------------------------------------
+// First of the sorted names not present in the table, by merge-join.
+//------------------------------------------------------------------------------
+static bool findUnknown(const std::vector<std::string_view> &names, const NameTable &table, std::string_view &unknown) {
+  size_t pos = 0;
+
+  for(std::string_view name : names) {
+    while(pos < table.size() && table[pos] < name) pos++;
+
+    if(pos == table.size() || table[pos] != name) {
+      unknown = name;
+      return true;
+    }
+  }
+
+  return false;
 }
 
 Manifest::Manifest() {}
@@ -52,36 +73,76 @@ std::string Manifest::checksum() const {
 }
 
 std::string Manifest::toString() const {
-  std::ostringstream ss;
-  ss << toStringWithoutChecksum();
-  ss << HashCalculator::base16Encode(checksum()) << std::endl;
-  return ss.str();
+  std::string contents = toStringWithoutChecksum();
+  contents += HashCalculator::base16Encode(HashCalculator::sha256(contents));
+  contents += '\n';
+  return contents;
+}
+
+std::string Manifest::toBinary() const {
+  return BinaryManifestView::encode(*this);
 }
 
 std::string Manifest::toStringWithoutChecksum() const {
-  std::ostringstream ss;
+  std::string ss;
+  ss.reserve(64 + (directories.size() + files.size()) * 16);
+
+  auto line = [&ss](std::string_view prefix, std::string_view value) {
+    ss.append(prefix.data(), prefix.size());
+    ss.append(value.data(), value.size());
+    ss += '\n';
+  };
+
+  line(kManifest, filename);
+  ss += kSeparator;
+
+  for(std::string_view subdir : directories) {
+    line(kSubdir, subdir);
+  }
+
+  ss += kSeparator;
+
+  // Sizes and checksums are sorted just like the files, walk all three side
+  // by side
+  auto size = sizes.begin();
+  auto it = checksums.begin();
+  for(std::string_view file : files) {
+    while(size != sizes.end() && size->first < file) size++;
+    while(it != checksums.end() && it->first < file) it++;
+
+    ss += kFile;
+    ss.append(file.data(), file.size());
 
-  ss << kManifest << filename << std::endl;
-  ss << kSeparator;
+    if(size != sizes.end() && size->first == file) {
+      ss += kSize;
+      ss += std::to_string(size->second);
+    }
+
+    if(it != checksums.end() && it->first == file) {
+      ss += kChecksum;
+      ss += it->second;
+    }
 
-  for(const std::string& subdir : directories) {
-    ss << kSubdir << subdir << std::endl;
+    ss += '\n';
   }
 
-  ss << kSeparator;
+  ss += kSeparator;
 
-  for(const std::string& file : files) {
-    ss << kFile << file << std::endl;
+  // Only sharded MANIFESTs carry the extra section, so unsharded ones look
+  // just like they always did
+  if(!shards.empty()) {
+    for(const std::string& shard : shards) {
+      line(kShard, shard);
+    }
+
+    ss += kSeparator;
   }
 
-  ss << kSeparator;
-  return ss.str();
+  return ss;
 }
 
-bool Manifest::exists(const std::string &name) {
-  if(files.count(name) != 0) return true;
-  if(directories.count(name) != 0) return true;
-  return false;
+bool Manifest::exists(std::string_view name) const {
+  return files.contains(name) || directories.contains(name);
 }
 
 size_t Manifest::fileCount() const {
@@ -92,32 +153,115 @@ size_t Manifest::subdirCount() const {
   return directories.size();
 }
 
-bool Manifest::tryAddFile(const std::string &file) {
-  if(exists(file)) return false;
-  files.insert(file);
+bool Manifest::tryAddFile(std::string_view file) {
+  if(directories.contains(file)) return false;
+  return files.insert(file);
+}
+
+bool Manifest::tryAddSubdir(std::string_view subdir) {
+  if(files.contains(subdir)) return false;
+  return directories.insert(subdir);
+}
+
+size_t Manifest::tryAddFiles(const std::vector<std::string> &names) {
+  return tryAddAll(files, names);
+}
+
+size_t Manifest::tryAddSubdirs(const std::vector<std::string> &names) {
+  return tryAddAll(directories, names);
+}
+
+size_t Manifest::tryAddAll(NameTable &table, const std::vector<std::string> &names) {
+  std::vector<std::string_view> added(names.begin(), names.end());
+  std::sort(added.begin(), added.end());
+  added.erase(std::unique(added.begin(), added.end()), added.end());
+
+  added.erase(std::remove_if(added.begin(), added.end(), [this](std::string_view name) {
+    return exists(name);
+  }), added.end());
+
+  table.merge(added);
+  return added.size();
+}
+
+void Manifest::setChecksum(std::string_view file, const std::string &checksum) {
+  checksums[std::string(file)] = checksum;
+}
+
+bool Manifest::getChecksum(std::string_view file, std::string &checksum) const {
+  auto it = checksums.find(file);
+  if(it == checksums.end()) return false;
+
+  checksum = it->second;
   return true;
 }
 
-bool Manifest::tryAddSubdir(const std::string &subdir) {
-  if(exists(subdir)) return false;
-  directories.insert(subdir);
+void Manifest::setSize(std::string_view file, uint64_t size) {
+  sizes[std::string(file)] = size;
+}
+
+bool Manifest::getSize(std::string_view file, uint64_t &size) const {
+  auto it = sizes.find(file);
+  if(it == sizes.end()) return false;
+
+  size = it->second;
   return true;
 }
 
-bool Manifest::popFile(std::string &file) {
-  if(files.empty()) return false;
-  auto it = files.begin();
-  file = *it;
-  files.erase(it);
+std::string Manifest::shardName(size_t shard) {
+  return SSTR("MANIFEST." << shard);
+}
+
+void Manifest::addShard(const std::string &name) {
+  shards.emplace_back(name);
+}
+
+const std::vector<std::string>& Manifest::getShards() const {
+  return shards;
+}
+
+bool Manifest::isSharded() const {
+  return !shards.empty();
+}
+
+bool Manifest::isManifestFile(const std::string &name) const {
+  if(name == "MANIFEST") return true;
+
+  // Checked for every entry of a listing, keep it cheap for the rest
+  if(shards.empty() || name.compare(0, 9, "MANIFEST.") != 0) return false;
+  return std::find(shards.begin(), shards.end(), name) != shards.end();
+}
+
+bool Manifest::absorbShard(const Manifest &shard) {
+  for(std::string_view subdir : shard.directories) {
+    if(!tryAddSubdir(subdir)) return false;
+  }
+
+  for(std::string_view file : shard.files) {
+    if(!tryAddFile(file)) return false;
+  }
+
+  for(auto it = shard.checksums.begin(); it != shard.checksums.end(); it++) {
+    checksums[it->first] = it->second;
+  }
+
+  for(auto it = shard.sizes.begin(); it != shard.sizes.end(); it++) {
+    sizes[it->first] = it->second;
+  }
+
   return true;
 }
 
+bool Manifest::popFile(std::string &file) {
+  return files.popFront(file);
+}
+
 bool Manifest::popSubdir(std::string &subdir) {
-  if(directories.empty()) return false;
-  auto it = directories.begin();
-  subdir = *it;
-  directories.erase(it);
-  return true;
+  return directories.popFront(subdir);
+}
+
+bool Manifest::popLastSubdir(std::string &subdir) {
+  return directories.popBack(subdir);
 }
 
 std::string Manifest::getFilename() const {
@@ -128,54 +272,130 @@ void Manifest::clear() {
   filename.clear();
   files.clear();
   directories.clear();
+  checksums.clear();
+  sizes.clear();
+  shards.clear();
 }
 
-bool Manifest::parse(const std::string &contents) {
+bool Manifest::parse(std::string_view contents) {
   clear();
 
+  if(BinaryManifestView::isBinary(contents)) {
+    return parseBinary(contents);
+  }
+
+  // Single pass, validating in place: names go straight from the input into
+  // the tables, and the checksum is taken over the input bytes as they are.
+  // That's only equivalent to re-serializing if the input is in canonical
+  // form, so names must be sorted, as toString writes them.
   size_t index = 0;
-  if(!extractLineWithPrefix(contents, index, kManifest, filename)) return false;
-  index += kManifest.size() + 1 + filename.size();
+  std::string_view value;
+  if(!consumeLine(contents, index, kManifest, value)) return false;
+  filename = std::string(value);
 
-  if(!isEqualAndProgressIndex(contents, index, kSeparator)) return false;
+  if(!consumeString(contents, index, kSeparator)) return false;
   if(!parseList(contents, index, true)) return false;
   if(!parseList(contents, index, false)) return false;
 
-  std::string givenChecksum;
-  if(!extractLineWithPrefix(contents.c_str(), index, "", givenChecksum)) return false;
-  if(givenChecksum.size() != 64) return false;
+  if(contents.compare(index, kShard.size(), kShard) == 0) {
+    if(!parseShards(contents, index)) return false;
+  }
+
+  size_t checksummed = index;
+  std::string_view givenChecksum;
+  if(!consumeLine(contents, index, "", givenChecksum)) return false;
+  if(givenChecksum.size() != 64 || index != contents.size()) return false;
+
+  return HashCalculator::base16Encode(HashCalculator::sha256(contents.substr(0, checksummed))) == givenChecksum;
+}
+
+bool Manifest::parseBinary(std::string_view contents) {
+  BinaryManifestView view;
+  BinaryManifestView::Entries entries;
+  if(!view.open(contents) || !view.verify(&entries)) return false;
+
+  filename = std::string(view.getFilename());
+
+  for(size_t i = 0; i < view.shardCount(); i++) {
+    std::string_view shard = view.getShard(i);
+    if(shard.compare(0, 9, "MANIFEST.") != 0 || shard.find('/') != std::string_view::npos) return false;
+    shards.emplace_back(shard);
+  }
+
+  // Verified to be sorted and unique
+  directories.merge(entries.subdirs);
+  files.merge(entries.files);
+
+  for(size_t i = 0; i < entries.files.size(); i++) {
+    if(entries.sizes[i] != BinaryManifestView::kNoSize) {
+      sizes.emplace(std::string(entries.files[i]), entries.sizes[i]);
+    }
+
+    if(!entries.checksums[i].empty()) {
+      checksums.emplace(std::string(entries.files[i]), std::string(entries.checksums[i]));
+    }
+  }
 
-  if(HashCalculator::base16Encode(checksum()) != givenChecksum) return false;
-  if(index + givenChecksum.size() + 1 != contents.size()) return false;
   return true;
 }
 
-bool Manifest::parseList(const std::string &contents, size_t& index, bool dirs) {
-  std::string prefix = kFile;
-  if(dirs) prefix = kSubdir;
+bool Manifest::parseList(std::string_view contents, size_t& index, bool dirs) {
+  std::string_view prefix = dirs ? kSubdir : kFile;
+  NameTable &table = dirs ? directories : files;
 
   while(true) {
-    if(contents.size() <= index) return false;
-    if(isEqualAndProgressIndex(contents, index, kSeparator)) return true;
+    if(consumeString(contents, index, kSeparator)) return true;
+
+    std::string_view line;
+    if(!consumeLine(contents, index, prefix, line)) return false;
 
-    std::string tmp;
-    if(!extractLineWithPrefix(contents, index, prefix, tmp)) return false;
-    index += prefix.size() + 1 + tmp.size();
+    // Name, then optionally its size, then optionally its checksum
+    std::string_view name = line;
+    std::string_view checksum;
+    size_t checksumPos = dirs ? std::string_view::npos : name.find(kChecksum);
 
-    if(dirs) {
-      directories.insert(tmp);
+    if(checksumPos != std::string_view::npos) {
+      checksum = name.substr(checksumPos + kChecksum.size());
+      name = name.substr(0, checksumPos);
     }
-    else {
-      files.insert(tmp);
+
+    size_t sizePos = dirs ? std::string_view::npos : name.find(kSize);
+
+    if(sizePos != std::string_view::npos) {
+      uint64_t size = 0;
+      if(!parseCanonicalDecimal(name.substr(sizePos + kSize.size()), size)) return false;
+
+      name = name.substr(0, sizePos);
+      sizes.emplace(std::string(name), size);
+    }
+
+    if(checksumPos != std::string_view::npos) {
+      checksums.emplace(std::string(name), std::string(checksum));
     }
+
+    // Strictly increasing, which also makes every insertion an append
+    if(!table.empty() && table[table.size() - 1] >= name) return false;
+    table.insert(name);
   }
 }
 
-std::set<std::string>& Manifest::getDirectories() {
+bool Manifest::parseShards(std::string_view contents, size_t& index) {
+  while(true) {
+    if(consumeString(contents, index, kSeparator)) return !shards.empty();
+
+    std::string_view shard;
+    if(!consumeLine(contents, index, kShard, shard)) return false;
+
+    if(shard.compare(0, 9, "MANIFEST.") != 0 || shard.find('/') != std::string_view::npos) return false;
+    shards.emplace_back(shard);
+  }
+}
+
+const NameTable& Manifest::getDirectories() const {
   return directories;
 }
 
-std::set<std::string>& Manifest::getFiles() {
+const NameTable& Manifest::getFiles() const {
   return files;
 }
 
@@ -183,28 +403,39 @@ TestcaseStatus Manifest::crossCheckDirlist(XrdCl::DirectoryList& dirlist) {
   TestcaseStatus retval;
   retval.seal("Cross-check directory contents predicted by MANIFEST, and actual dirlist");
 
-  size_t directoryCount = 0;
-  size_t fileCount = 0;
+  // Sort the listing once, then walk it alongside the MANIFEST, which is
+  // sorted already
+  std::vector<std::string_view> listedDirectories;
+  std::vector<std::string_view> listedFiles;
 
   for(size_t i = 0; i < dirlist.GetSize(); i++) {
-    // Directory?
+    const std::string &name = dirlist.At(i)->GetName();
+
     if(dirlist.At(i)->GetStatInfo()->TestFlags(XrdCl::StatInfo::IsDir)) {
-      directoryCount++;
-      if(directories.count(dirlist.At(i)->GetName()) == 0) {
-        retval.addError(SSTR("Found directory on server, but not in MANIFEST: " << dirlist.At(i)->GetName()));
-        return retval;
-      }
+      listedDirectories.emplace_back(name);
     }
-    else if(dirlist.At(i)->GetName() != "MANIFEST") {
-      // File
-      fileCount++;
-      if(files.count(dirlist.At(i)->GetName()) == 0) {
-        retval.addError(SSTR("Found file on server, but not in MANIFEST: " << dirlist.At(i)->GetName()));
-        return retval;
-      }
+    else if(!isManifestFile(name)) {
+      listedFiles.emplace_back(name);
     }
   }
 
+  std::sort(listedDirectories.begin(), listedDirectories.end());
+  std::sort(listedFiles.begin(), listedFiles.end());
+
+  std::string_view unknown;
+  if(findUnknown(listedDirectories, directories, unknown)) {
+    retval.addError(SSTR("Found directory on server, but not in MANIFEST: " << unknown));
+    return retval;
+  }
+
+  if(findUnknown(listedFiles, files, unknown)) {
+    retval.addError(SSTR("Found file on server, but not in MANIFEST: " << unknown));
+    return retval;
+  }
+
+  size_t directoryCount = listedDirectories.size();
+  size_t fileCount = listedFiles.size();
+
   if(directories.size() != directoryCount) {
     retval.addError(SSTR("Mismatch between number of directories predicted by MANIFEST (" << directories.size() << ") and reality (" << directoryCount << ")"));
   }
@@ -215,14 +446,14 @@ TestcaseStatus Manifest::crossCheckDirlist(XrdCl::DirectoryList& dirlist) {
 
   if(!retval.ok()) {
     retval.addError("MANIFEST files: ");
-    for(auto it = files.begin(); it != files.end(); it++) {
-      retval.addError(*it);
+    for(std::string_view file : files) {
+      retval.addError(std::string(file));
     }
 
     retval.addError("");
     retval.addError("MANIFEST directories: ");
-    for(auto it = directories.begin(); it != directories.end(); it++) {
-      retval.addError(*it);
+    for(std::string_view subdir : directories) {
+      retval.addError(std::string(subdir));
     }
 
     retval.addError("");
@@ -24,9 +24,14 @@
 #ifndef EOSTESTER_MANIFEST_H
 #define EOSTESTER_MANIFEST_H
 
-#include <set>
+#include <cstdint>
+#include <functional>
+#include <map>
 #include <string>
+#include <string_view>
+#include <vector>
 #include "utils/TestcaseStatus.hh"
+#include "NameTable.hh"
 
 namespace XrdCl {
   class DirectoryList;
@@ -41,34 +46,101 @@ public:
 
   std::string toString() const;
   std::string toStringWithoutChecksum() const;
+
+  //----------------------------------------------------------------------------
+  // MANIFEST v2, see BinaryManifestView. parse accepts either format.
+  //----------------------------------------------------------------------------
+  std::string toBinary() const;
   std::string checksum() const;
   bool fromString(const std::string &filename, std::string &error);
 
-  bool exists(const std::string &name);
-  bool tryAddFile(const std::string &file);
-  bool tryAddSubdir(const std::string &subdir);
+  bool exists(std::string_view name) const;
+  bool tryAddFile(std::string_view file);
+  bool tryAddSubdir(std::string_view subdir);
+
+  //----------------------------------------------------------------------------
+  // Add all of the given names which aren't present yet, in one pass over
+  // the table. Returns how many were added.
+  //----------------------------------------------------------------------------
+  size_t tryAddFiles(const std::vector<std::string> &names);
+  size_t tryAddSubdirs(const std::vector<std::string> &names);
 
   size_t fileCount() const;
   size_t subdirCount() const;
 
+  //----------------------------------------------------------------------------
+  // Optional expected checksum of a file, as "type:value", eg
+  // "adler32:0a1b2c3d". Survives popFile.
+  //----------------------------------------------------------------------------
+  void setChecksum(std::string_view file, const std::string &checksum);
+  bool getChecksum(std::string_view file, std::string &checksum) const;
+
+  // All of them, sorted by file name
+  const std::map<std::string, std::string, std::less<>>& getChecksums() const {
+    return checksums;
+  }
+
+  //----------------------------------------------------------------------------
+  // Optional exact size of a file in bytes, checkable against a directory
+  // listing without reading anything. Survives popFile.
+  //----------------------------------------------------------------------------
+  void setSize(std::string_view file, uint64_t size);
+  bool getSize(std::string_view file, uint64_t &size) const;
+
+  // All of them, sorted by file name
+  const std::map<std::string, uint64_t, std::less<>>& getSizes() const {
+    return sizes;
+  }
+
+  //----------------------------------------------------------------------------
+  // Sharded MANIFEST: for huge directories, the top-level MANIFEST is only an
+  // index naming its shards - sibling files MANIFEST.0, MANIFEST.1, ... -
+  // which each list a slice of the directory's contents.
+  //----------------------------------------------------------------------------
+  static std::string shardName(size_t shard);
+  void addShard(const std::string &name);
+  const std::vector<std::string>& getShards() const;
+  bool isSharded() const;
+
+  //----------------------------------------------------------------------------
+  // Is this file the MANIFEST, or one of its shards?
+  //----------------------------------------------------------------------------
+  bool isManifestFile(const std::string &name) const;
+
+  //----------------------------------------------------------------------------
+  // Merge the contents of a shard into this index. False if the shard lists
+  // an entry already present.
+  //----------------------------------------------------------------------------
+  bool absorbShard(const Manifest &shard);
+
   bool popFile(std::string &file);
   bool popSubdir(std::string &subdir);
+  bool popLastSubdir(std::string &subdir);
   std::string getFilename() const;
 
   void clear();
-  bool parse(const std::string &contents);
+  //----------------------------------------------------------------------------
+  // Accepts only the canonical form, as produced by toString.
+  //----------------------------------------------------------------------------
+  bool parse(std::string_view contents);
 
-  std::set<std::string>& getDirectories();
-  std::set<std::string>& getFiles();
+  const NameTable& getDirectories() const;
+  const NameTable& getFiles() const;
 
   TestcaseStatus crossCheckDirlist(XrdCl::DirectoryList &dirlist);
 
 private:
-  bool parseList(const std::string &contents, size_t& index, bool dir);
+  bool parseBinary(std::string_view contents);
+  bool parseList(std::string_view contents, size_t& index, bool dir);
+  bool parseShards(std::string_view contents, size_t& index);
+  size_t tryAddAll(NameTable &table, const std::vector<std::string> &names);
 
   std::string filename;
-  std::set<std::string> directories;
-  std::set<std::string> files;
+  NameTable directories;
+  NameTable files;
+  std::map<std::string, std::string, std::less<>> checksums;
+  std::map<std::string, uint64_t, std::less<>> sizes;
+  std::vector<std::string> shards;
 };
 
 }
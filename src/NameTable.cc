@@ -0,0 +1,129 @@
+// ----------------------------------------------------------------------
+// File: NameTable.cc
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include <algorithm>
+#include <cstring>
+
+#include "NameTable.hh"
+#include "Macros.hh"
+using namespace eostest;
+
+NameTable::Slot NameTable::makeSlot(std::string_view name) {
+  Slot slot;
+  memset(slot.bytes, 0, sizeof(slot.bytes));
+
+  if(name.size() <= kInlineLength) {
+    memcpy(slot.bytes, name.data(), name.size());
+    slot.bytes[7] = name.size();
+    return slot;
+  }
+
+  eost_assert(name.size() < (1u << 24));
+  eost_assert(arena.size() + name.size() <= UINT32_MAX);
+
+  uint32_t offset = arena.size();
+  uint32_t length = name.size();
+  arena.append(name.data(), name.size());
+
+  for(size_t i = 0; i < 4; i++) {
+    slot.bytes[i] = (offset >> (8 * i)) & 0xFF;
+  }
+
+  for(size_t i = 0; i < 3; i++) {
+    slot.bytes[4 + i] = (length >> (8 * i)) & 0xFF;
+  }
+
+  slot.bytes[7] = kInArena;
+  return slot;
+}
+
+size_t NameTable::lowerBound(std::string_view name) const {
+  auto it = std::lower_bound(slots.begin() + front, slots.end(), name, [this](const Slot &slot, std::string_view value) {
+    return view(slot) < value;
+  });
+
+  return it - (slots.begin() + front);
+}
+
+bool NameTable::contains(std::string_view name) const {
+  size_t pos = lowerBound(name);
+  return pos != size() && (*this)[pos] == name;
+}
+
+bool NameTable::insert(std::string_view name) {
+  // Fast path: names coming in sorted order, as when parsing
+  if(empty() || view(slots.back()) < name) {
+    slots.push_back(makeSlot(name));
+    return true;
+  }
+
+  size_t pos = lowerBound(name);
+  if((*this)[pos] == name) return false;
+
+  slots.insert(slots.begin() + front + pos, makeSlot(name));
+  return true;
+}
+
+void NameTable::merge(const std::vector<std::string_view> &names) {
+  if(names.empty()) return;
+
+  std::vector<Slot> merged;
+  merged.reserve(size() + names.size());
+
+  size_t i = front;
+  for(std::string_view name : names) {
+    while(i < slots.size() && view(slots[i]) < name) {
+      merged.push_back(slots[i++]);
+    }
+
+    merged.push_back(makeSlot(name));
+  }
+
+  merged.insert(merged.end(), slots.begin() + i, slots.end());
+  slots = std::move(merged);
+  front = 0;
+}
+
+bool NameTable::popFront(std::string &name) {
+  if(empty()) return false;
+  name = std::string(view(slots[front]));
+  front++;
+  return true;
+}
+
+bool NameTable::popBack(std::string &name) {
+  if(empty()) return false;
+  name = std::string(view(slots.back()));
+  slots.pop_back();
+  return true;
+}
+
+void NameTable::clear() {
+  slots.clear();
+  arena.clear();
+  front = 0;
+}
+
+size_t NameTable::memoryUsage() const {
+  return slots.capacity() * sizeof(Slot) + arena.capacity();
+}
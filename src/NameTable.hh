@@ -0,0 +1,150 @@
+// ----------------------------------------------------------------------
+// File: NameTable.hh
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef EOSTESTER_NAME_TABLE_H
+#define EOSTESTER_NAME_TABLE_H
+
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace eostest {
+
+//------------------------------------------------------------------------------
+// A sorted set of names, stored flat: one 8-byte slot per name, in order.
+// Names of up to 7 bytes live inside their slot, longer ones in a single
+// arena shared by the whole table. No allocation per name, and lookups are
+// a binary search over contiguous memory.
+//
+// Inserting in sorted order is O(1), anywhere else O(n) - bulk insertions
+// should go through merge. Popping from either end is O(1); the arena bytes
+// of a popped name are only reclaimed by clear.
+//------------------------------------------------------------------------------
+class NameTable {
+public:
+  class const_iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const std::string_view*;
+    using reference = std::string_view;
+
+    const_iterator(const NameTable *t, size_t i) : table(t), index(i) {}
+
+    std::string_view operator*() const { return (*table)[index]; }
+    const_iterator& operator++() { index++; return *this; }
+    const_iterator operator++(int) { const_iterator prev = *this; index++; return prev; }
+    bool operator==(const const_iterator &other) const { return index == other.index; }
+    bool operator!=(const const_iterator &other) const { return index != other.index; }
+
+  private:
+    const NameTable *table;
+    size_t index;
+  };
+
+  size_t size() const {
+    return slots.size() - front;
+  }
+
+  bool empty() const {
+    return size() == 0;
+  }
+
+  std::string_view operator[](size_t index) const {
+    return view(slots[front + index]);
+  }
+
+  const_iterator begin() const {
+    return const_iterator(this, 0);
+  }
+
+  const_iterator end() const {
+    return const_iterator(this, size());
+  }
+
+  //----------------------------------------------------------------------------
+  // Position of the first name not less than the given one - size() if
+  // there's none.
+  //----------------------------------------------------------------------------
+  size_t lowerBound(std::string_view name) const;
+  bool contains(std::string_view name) const;
+
+  //----------------------------------------------------------------------------
+  // False if already present.
+  //----------------------------------------------------------------------------
+  bool insert(std::string_view name);
+
+  //----------------------------------------------------------------------------
+  // Insert names which must be sorted, unique, and not present yet, in a
+  // single pass over the table.
+  //----------------------------------------------------------------------------
+  void merge(const std::vector<std::string_view> &names);
+
+  bool popFront(std::string &name);
+  bool popBack(std::string &name);
+  void clear();
+
+  //----------------------------------------------------------------------------
+  // Bytes of memory held, for comparison against other representations.
+  //----------------------------------------------------------------------------
+  size_t memoryUsage() const;
+
+private:
+  static constexpr size_t kInlineLength = 7;
+  static constexpr uint8_t kInArena = 0xFF;
+
+  // Inline: bytes [0, 7) are the name, byte 7 its length. Otherwise byte 7
+  // is kInArena, bytes [0, 4) the arena offset, [4, 7) the length, both
+  // little-endian.
+  struct Slot {
+    char bytes[8];
+  };
+
+  static uint32_t decode(const Slot &slot, size_t from, size_t count) {
+    uint32_t value = 0;
+    for(size_t i = 0; i < count; i++) {
+      value |= uint32_t((uint8_t) slot.bytes[from + i]) << (8 * i);
+    }
+
+    return value;
+  }
+
+  std::string_view view(const Slot &slot) const {
+    uint8_t tag = slot.bytes[7];
+    if(tag != kInArena) return std::string_view(slot.bytes, tag);
+    return std::string_view(arena.data() + decode(slot, 0, 4), decode(slot, 4, 3));
+  }
+
+  Slot makeSlot(std::string_view name);
+
+  std::vector<Slot> slots;
+  std::string arena;
+  size_t front = 0;
+};
+
+}
+
+#endif
@@ -33,6 +33,19 @@ namespace {
   const std::string kFilenamePrefix = "FILENAME: ";
   const std::string kRandomBytesPrefix = "RANDOM-BYTES: ";
   const std::string kSeparator = "----------\n";
+
+  std::string header(const std::string &filename) {
+    return SSTR(kFilenamePrefix << filename << std::endl);
+  }
+
+  std::string body(const std::string &randomBytes) {
+    std::stringstream ss;
+    ss << kRandomBytesPrefix << randomBytes.size() << std::endl;
+    ss << kSeparator;
+    ss << randomBytes << std::endl;
+    ss << kSeparator;
+    return ss.str();
+  }
 }
 
 SelfCheckedFile::SelfCheckedFile() { }
@@ -45,13 +58,7 @@ std::string SelfCheckedFile::checksum() const {
 }
 
 std::string SelfCheckedFile::toStringWithoutChecksum() const {
-  std::stringstream ss;
-  ss << kFilenamePrefix << filename << std::endl;
-  ss << kRandomBytesPrefix << randomBytes.size() << std::endl;
-  ss << kSeparator;
-  ss << randomBytes << std::endl;
-  ss << kSeparator;
-  return ss.str();
+  return header(filename) + body(randomBytes);
 }
 
 std::string SelfCheckedFile::toString() const {
@@ -67,31 +74,43 @@ void SelfCheckedFile::clear() {
 }
 
 bool SelfCheckedFile::parse(const std::string &contents) {
-  clear();
+  std::string_view name;
+  std::string_view bytes;
+  bool ok = parseInPlace(contents, name, bytes);
 
-  std::string value;
-  if(!extractLineWithPrefix(contents.c_str(), 0, kFilenamePrefix, filename)) return false;
-  size_t index = kFilenamePrefix.size() + 1 + filename.size();
+  filename = std::string(name);
+  randomBytes = std::string(bytes);
+  return ok;
+}
 
-  if(!extractLineWithPrefix(contents.c_str(), index, kRandomBytesPrefix, value)) return false;
-  int64_t randomBytesLength = -1;
-  if(!my_strtoll(value, randomBytesLength)) return false;
-  index += kRandomBytesPrefix.size() + 1 + value.size();
+bool SelfCheckedFile::parseInPlace(std::string_view contents, std::string_view &name, std::string_view &bytes) {
+  name = std::string_view();
+  bytes = std::string_view();
 
-  if(!isEqualAndProgressIndex(contents, index, kSeparator)) return false;
+  size_t index = 0;
+  if(!consumeLine(contents, index, kFilenamePrefix, name)) return false;
 
-  if(contents.size() <= index + randomBytesLength) return false;
-  randomBytes = std::string(contents.c_str(), index, randomBytesLength);
+  std::string_view value;
+  uint64_t randomBytesLength = 0;
+  if(!consumeLine(contents, index, kRandomBytesPrefix, value)) return false;
+  if(!parseCanonicalDecimal(value, randomBytesLength)) return false;
+
+  if(!consumeString(contents, index, kSeparator)) return false;
+
+  if(randomBytesLength >= contents.size() - index) return false;
+  bytes = contents.substr(index, randomBytesLength);
   index += randomBytesLength;
 
-  if(!isEqualAndProgressIndex(contents, index, SSTR("\n" << kSeparator))) return false;
+  if(!consumeString(contents, index, "\n") || !consumeString(contents, index, kSeparator)) return false;
 
-  std::string givenChecksum;
-  if(!extractLineWithPrefix(contents.c_str(), index, "", givenChecksum)) return false;
+  // Everything up to here is exactly what toStringWithoutChecksum would
+  // produce, hash it as it is
+  size_t checksummed = index;
+  std::string_view givenChecksum;
+  if(!consumeLine(contents, index, "", givenChecksum)) return false;
   if(givenChecksum.size() != 64) return false;
 
-  if(HashCalculator::base16Encode(checksum()) != givenChecksum) return false;
-  return true;
+  return HashCalculator::base16Encode(HashCalculator::sha256(contents.substr(0, checksummed))) == givenChecksum;
 }
 
 std::string SelfCheckedFile::getFilename() const {
@@ -106,15 +125,56 @@ bool SelfCheckedFile::operator==(const SelfCheckedFile &rhs) const {
   return filename == rhs.filename && randomBytes == rhs.randomBytes;
 }
 
-TestcaseStatus SelfCheckedFile::validate(std::string fileContents, std::string expectedFilename) {
-  SelfCheckedFile scf;
-  if(!scf.parse(fileContents)) {
+TestcaseStatus SelfCheckedFile::validate(std::string_view fileContents, std::string_view expectedFilename) {
+  std::string_view filename;
+  std::string_view randomBytes;
+
+  if(!parseInPlace(fileContents, filename, randomBytes)) {
     return TestcaseStatus(SSTR("Could not parse self-checked-file contents: " << expectedFilename));
   }
 
-  if(scf.getFilename() != expectedFilename) {
-    return TestcaseStatus(SSTR("Expected self-checked-file path " << expectedFilename << ", received " << scf.getFilename()));
+  if(filename != expectedFilename) {
+    return TestcaseStatus(SSTR("Expected self-checked-file path " << expectedFilename << ", received " << filename));
   }
 
   return TestcaseStatus();
 }
+
+//------------------------------------------------------------------------------
+// Everything but the random bytes and the digits of their length: the header,
+// prefix and separators, plus a base16 checksum line.
+//------------------------------------------------------------------------------
+static uint64_t fixedOverhead(const std::string &filename) {
+  return header(filename).size() + body("").size() - 1 + 65;
+}
+
+uint64_t SelfCheckedFile::sizeFor(const std::string &filename, uint64_t randomBytes) {
+  return fixedOverhead(filename) + std::to_string(randomBytes).size() + randomBytes;
+}
+
+bool SelfCheckedFile::isPlausibleSize(const std::string &filename, uint64_t size) {
+  uint64_t fixed = fixedOverhead(filename);
+
+  for(uint64_t digits = 1; digits <= 20; digits++) {
+    if(size < fixed + digits) break;
+
+    uint64_t randomBytes = size - fixed - digits;
+    if(std::to_string(randomBytes).size() == digits) return true;
+  }
+
+  return false;
+}
+
+ContentBuffer::Segment SelfCheckedFile::makeTemplateBody(const std::string &randomBytes) {
+  return std::make_shared<const std::string>(body(randomBytes));
+}
+
+ContentBuffer SelfCheckedFile::fromTemplate(const std::string &filename, const ContentBuffer::Segment &templateBody) {
+  std::string head = header(filename);
+  std::string checksum = HashCalculator::sha256(head, *templateBody);
+
+  ContentBuffer retval(std::move(head));
+  retval.append(templateBody);
+  retval.append(SSTR(HashCalculator::base16Encode(checksum) << std::endl));
+  return retval;
+}
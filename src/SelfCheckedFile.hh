@@ -25,7 +25,9 @@
 #define EOSTESTER_SELF_CHECKED_FILE_H
 
 #include <string>
+#include <string_view>
 #include "utils/TestcaseStatus.hh"
+#include "ContentBuffer.hh"
 
 namespace eostest {
 
@@ -39,12 +41,43 @@ public:
   std::string checksum() const;
 
   bool parse(const std::string &contents);
+
+  //----------------------------------------------------------------------------
+  // Parse and verify without copying anything: on success, filename and
+  // randomBytes point into contents. Only the canonical form, as produced by
+  // toString, is accepted.
+  //----------------------------------------------------------------------------
+  static bool parseInPlace(std::string_view contents, std::string_view &filename, std::string_view &randomBytes);
+
   std::string getFilename() const;
   std::string getRandomBytes() const;
   bool operator==(const SelfCheckedFile &rhs) const;
   void clear();
 
-  static TestcaseStatus validate(std::string contents, std::string expectedFilename);
+  static TestcaseStatus validate(std::string_view contents, std::string_view expectedFilename);
+
+  //----------------------------------------------------------------------------
+  // Exact size of a self-checked file with the given filename and number of
+  // random bytes, without building it.
+  //----------------------------------------------------------------------------
+  static uint64_t sizeFor(const std::string &filename, uint64_t randomBytes);
+
+  //----------------------------------------------------------------------------
+  // Could a self-checked file with the given filename be exactly this large,
+  // for some number of random bytes? Only rules out sizes below the fixed
+  // overhead, and a handful of others - a weak check, for files whose exact
+  // size isn't known.
+  //----------------------------------------------------------------------------
+  static bool isPlausibleSize(const std::string &filename, uint64_t size);
+
+  //----------------------------------------------------------------------------
+  // Everything following the filename line depends only on the random bytes,
+  // so files with identical random bytes can share it: build that part once
+  // with makeTemplateBody, and stamp out files with fromTemplate. The result
+  // is byte-for-byte what toString() would give.
+  //----------------------------------------------------------------------------
+  static ContentBuffer::Segment makeTemplateBody(const std::string &randomBytes);
+  static ContentBuffer fromTemplate(const std::string &filename, const ContentBuffer::Segment &templateBody);
 
 private:
   std::string filename;
@@ -0,0 +1,301 @@
+// ----------------------------------------------------------------------
+// File: TreeShape.cc
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include "TreeShape.hh"
+#include "Macros.hh"
+#include "Utils.hh"
+using namespace eostest;
+
+// Zipf is sampled through a table of cumulative weights, one per value
+static constexpr uint64_t kMaxZipfValues = 10 * 1000 * 1000;
+
+static bool parseDouble(const std::string &str, double &ret) {
+  if(str.empty()) return false;
+
+  char *endptr = nullptr;
+  errno = 0;
+  ret = strtod(str.c_str(), &endptr);
+  return endptr == str.c_str() + str.size() && errno == 0 && std::isfinite(ret);
+}
+
+//------------------------------------------------------------------------------
+// Split "A<separator>B" in two, both non-empty.
+//------------------------------------------------------------------------------
+static bool splitPair(const std::string &str, char separator, std::string &first, std::string &second) {
+  size_t pos = str.find(separator);
+  if(pos == std::string::npos || pos == 0 || pos == str.size() - 1) return false;
+
+  first = str.substr(0, pos);
+  second = str.substr(pos + 1);
+  return true;
+}
+
+Distribution::Distribution() {}
+
+Distribution Distribution::fixed(uint64_t value) {
+  Distribution distr;
+  distr.kind = Kind::kFixed;
+  distr.low = value;
+  distr.high = value;
+  distr.description = SSTR("fixed:" << value);
+  return distr;
+}
+
+Distribution Distribution::uniform(uint64_t lo, uint64_t hi) {
+  Distribution distr;
+  distr.kind = Kind::kUniform;
+  distr.low = std::min(lo, hi);
+  distr.high = std::max(lo, hi);
+  distr.description = SSTR("uniform:" << distr.low << "-" << distr.high);
+  return distr;
+}
+
+Distribution Distribution::logNormal(double med, double sig, uint64_t ceiling) {
+  Distribution distr;
+  distr.kind = Kind::kLogNormal;
+  distr.median = std::max(0.0, med);
+  distr.sigma = std::max(0.0, sig);
+  distr.high = std::min(ceiling, kMaxSample);
+  distr.description = SSTR("lognormal:" << distr.median << "," << distr.sigma);
+  if(distr.high != kMaxSample) distr.description += SSTR("," << distr.high);
+  return distr;
+}
+
+Distribution Distribution::zipf(uint64_t count, double exponent) {
+  count = std::max<uint64_t>(1, std::min(count, kMaxZipfValues));
+
+  std::vector<Bucket> table;
+  table.reserve(count);
+
+  double total = 0;
+  for(uint64_t k = 1; k <= count; k++) {
+    total += 1.0 / std::pow((double) k, exponent);
+    table.push_back(Bucket {k, k, total});
+  }
+
+  Distribution distr;
+  distr.kind = Kind::kBuckets;
+  distr.high = count;
+  distr.buckets = std::make_shared<const std::vector<Bucket>>(std::move(table));
+  distr.description = SSTR("zipf:" << count << "," << exponent);
+  return distr;
+}
+
+bool Distribution::parseHistogram(const std::string &contents, Distribution &out, std::string &error) {
+  std::vector<Bucket> table;
+  double total = 0;
+  uint64_t largest = 0;
+
+  std::istringstream ss(contents);
+  std::string line;
+  size_t lineno = 0;
+
+  while(std::getline(ss, line)) {
+    lineno++;
+
+    size_t comment = line.find('#');
+    if(comment != std::string::npos) line.erase(comment);
+
+    std::istringstream fields(line);
+    std::string range, weightStr, trailing;
+    if(!(fields >> range)) continue;
+
+    Bucket bucket;
+    std::string lowStr, highStr;
+    double weight;
+
+    bool ok = (fields >> weightStr) && !(fields >> trailing) && parseDouble(weightStr, weight) && weight >= 0;
+    if(ok && splitPair(range, '-', lowStr, highStr)) {
+      ok = parseSize(lowStr, bucket.low) && parseSize(highStr, bucket.high) && bucket.low <= bucket.high;
+    }
+    else if(ok) {
+      ok = parseSize(range, bucket.low);
+      bucket.high = bucket.low;
+    }
+
+    if(!ok) {
+      error = SSTR("line " << lineno << ": expected \"VALUE WEIGHT\" or \"LOW-HIGH WEIGHT\", got: " << line);
+      return false;
+    }
+
+    if(weight == 0) continue;
+
+    total += weight;
+    largest = std::max(largest, bucket.high);
+    bucket.cumulativeWeight = total;
+    table.push_back(bucket);
+  }
+
+  if(table.empty()) {
+    error = "histogram is empty, or has no positive weights";
+    return false;
+  }
+
+  out = Distribution();
+  out.kind = Kind::kBuckets;
+  out.high = largest;
+  out.buckets = std::make_shared<const std::vector<Bucket>>(std::move(table));
+  out.description = SSTR("empirical:" << out.buckets->size() << "-buckets");
+  return true;
+}
+
+bool Distribution::parse(const std::string &spec, Distribution &out, std::string &error) {
+  uint64_t value;
+  if(parseSize(spec, value)) {
+    out = fixed(value);
+    return true;
+  }
+
+  std::string kindStr, params;
+  if(!splitPair(spec, ':', kindStr, params)) {
+    error = SSTR("expected KIND:PARAMETERS, or a plain number: " << spec);
+    return false;
+  }
+
+  std::string first, second;
+
+  if(kindStr == "fixed" && parseSize(params, value)) {
+    out = fixed(value);
+    return true;
+  }
+
+  uint64_t low, high;
+  if(kindStr == "uniform" && splitPair(params, '-', first, second) &&
+     parseSize(first, low) && parseSize(second, high) && low <= high) {
+    out = uniform(low, high);
+    return true;
+  }
+
+  double sig;
+  if(kindStr == "lognormal" && splitPair(params, ',', first, second)) {
+    std::string sigStr = second, ceilingStr;
+    uint64_t ceiling = kMaxSample;
+    bool ok = parseSize(first, value);
+
+    if(splitPair(second, ',', sigStr, ceilingStr)) {
+      ok = ok && parseSize(ceilingStr, ceiling);
+    }
+
+    if(ok && parseDouble(sigStr, sig) && sig >= 0) {
+      out = logNormal(value, sig, ceiling);
+      return true;
+    }
+  }
+
+  double exponent;
+  if(kindStr == "zipf" && splitPair(params, ',', first, second) &&
+     parseSize(first, value) && value >= 1 && value <= kMaxZipfValues &&
+     parseDouble(second, exponent) && exponent >= 0) {
+    out = zipf(value, exponent);
+    return true;
+  }
+
+  if(kindStr == "file") {
+    std::ifstream in(params);
+    if(!in) {
+      error = SSTR("could not open histogram file " << params);
+      return false;
+    }
+
+    std::stringstream contents;
+    contents << in.rdbuf();
+
+    if(!parseHistogram(contents.str(), out, error)) {
+      error = SSTR(params << ", " << error);
+      return false;
+    }
+
+    out.description = SSTR("file:" << params);
+    return true;
+  }
+
+  error = SSTR("unknown distribution, or invalid parameters: " << spec);
+  return false;
+}
+
+bool Distribution::empty() const {
+  return kind == Kind::kNone;
+}
+
+uint64_t Distribution::sample(std::mt19937 &generator) const {
+  switch(kind) {
+    case Kind::kNone:
+    case Kind::kFixed: {
+      return low;
+    }
+    case Kind::kUniform: {
+      return std::uniform_int_distribution<uint64_t>(low, high)(generator);
+    }
+    case Kind::kLogNormal: {
+      if(median <= 0) return 0;
+      double value = std::lognormal_distribution<double>(std::log(median), sigma)(generator);
+      return value >= (double) high ? high : (uint64_t) std::llround(value);
+    }
+    case Kind::kBuckets: {
+      const std::vector<Bucket> &table = *buckets;
+      double point = std::uniform_real_distribution<double>(0, table.back().cumulativeWeight)(generator);
+
+      auto it = std::upper_bound(table.begin(), table.end(), point, [](double p, const Bucket &bucket) {
+        return p < bucket.cumulativeWeight;
+      });
+
+      if(it == table.end()) it--;
+      if(it->low == it->high) return it->low;
+      return std::uniform_int_distribution<uint64_t>(it->low, it->high)(generator);
+    }
+  }
+
+  return 0;
+}
+
+uint64_t Distribution::maximum() const {
+  return high;
+}
+
+std::string Distribution::describe() const {
+  if(kind == Kind::kNone) return "none";
+  return description;
+}
+
+std::string TreeShape::describe() const {
+  std::ostringstream ss;
+  ss << "subdirs " << subdirs.describe() << ", files " << files.describe() << ", file size " << fileSize.describe();
+  if(!depth.empty()) ss << ", depth " << depth.describe();
+  return ss.str();
+}
+
+std::string TreeShape::check() const {
+  if(fileSize.maximum() > kMaxFileSize) {
+    return SSTR("file size " << fileSize.describe() << " may draw files of up to " << fileSize.maximum()
+      << " bytes, but tree files are generated in memory and may be at most " << kMaxFileSize
+      << " - narrow it, or cap a lognormal with a third parameter, ie lognormal:1M,2,64M");
+  }
+
+  return "";
+}
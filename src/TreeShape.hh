@@ -0,0 +1,127 @@
+// ----------------------------------------------------------------------
+// File: TreeShape.hh
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef EOSTESTER_TREE_SHAPE_H
+#define EOSTESTER_TREE_SHAPE_H
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace eostest {
+
+//------------------------------------------------------------------------------
+// A distribution of non-negative integers, given in text form as one of:
+//
+//   fixed:N           always N - a bare N works, too
+//   uniform:A-B       any of A..B, equally likely
+//   lognormal:M,S     median M, with S the standard deviation of its log
+//   lognormal:M,S,MAX same, with draws above MAX clamped to MAX
+//   zipf:N,S          1..N, with k being 1/k^S as likely as 1
+//   file:PATH         empirical histogram: one "VALUE WEIGHT" or
+//                     "LOW-HIGH WEIGHT" per line, # starts a comment
+//
+// Integers take size suffixes, ie 4K. Sampling only depends on the state of
+// the given generator.
+//------------------------------------------------------------------------------
+class Distribution {
+public:
+  // Nothing is ever drawn above this
+  static constexpr uint64_t kMaxSample = 1000ull * 1000 * 1000 * 1000 * 1000 * 1000;
+
+  Distribution();
+
+  static Distribution fixed(uint64_t value);
+  static Distribution uniform(uint64_t low, uint64_t high);
+  static Distribution logNormal(double median, double sigma, uint64_t ceiling = kMaxSample);
+  static Distribution zipf(uint64_t count, double exponent);
+
+  static bool parse(const std::string &spec, Distribution &out, std::string &error);
+  static bool parseHistogram(const std::string &contents, Distribution &out, std::string &error);
+
+  bool empty() const;
+  uint64_t sample(std::mt19937 &generator) const;
+
+  // Largest value sample() may return
+  uint64_t maximum() const;
+  std::string describe() const;
+
+private:
+  enum class Kind {
+    kNone,
+    kFixed,
+    kUniform,
+    kLogNormal,
+    kBuckets
+  };
+
+  // Values in [low, high], chosen with probability proportional to weight.
+  struct Bucket {
+    uint64_t low;
+    uint64_t high;
+    double cumulativeWeight;
+  };
+
+  Kind kind = Kind::kNone;
+  uint64_t low = 0;
+  uint64_t high = 0;
+  double median = 0;
+  double sigma = 0;
+  std::shared_ptr<const std::vector<Bucket>> buckets;
+  std::string description;
+};
+
+//------------------------------------------------------------------------------
+// The shape of a generated namespace tree: how many subdirectories and files
+// each directory gets, how large files are, and how deep branches go.
+//------------------------------------------------------------------------------
+struct TreeShape {
+  // Files are generated whole in memory, keep each one well below what a
+  // few hundred in-flight writes can afford.
+  static constexpr uint64_t kMaxFileSize = 64 * 1024 * 1024;
+
+  Distribution subdirs = Distribution::uniform(0, 10);
+
+  // Not counting the MANIFEST
+  Distribution files = Distribution::uniform(1, 11);
+
+  // Number of random bytes in each file - the self-checking header and
+  // checksum add some more.
+  Distribution fileSize = Distribution::uniform(1, 256);
+
+  // Maximum depth of each branch, drawn separately for every top-level
+  // directory. If empty, the fixed depth of the construction options
+  // applies.
+  Distribution depth;
+
+  std::string describe() const;
+
+  // Empty if the shape can be built, an explanation otherwise
+  std::string check() const;
+};
+
+}
+
+#endif
@@ -22,6 +22,8 @@
  ************************************************************************/
 
 #include <climits>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include "Utils.hh"
 using namespace eostest;
@@ -44,22 +46,35 @@ bool eostest::my_strtoll(const std::string &str, int64_t &ret) {
   return true;
 }
 
-bool eostest::extractLineWithPrefix(const std::string &str, size_t start, const std::string &prefix, std::string &val) {
-  size_t index = start;
-  if(!startswith(str, index, prefix)) return false;
+bool eostest::parseSize(const std::string &str, uint64_t &ret) {
+  if(str.empty()) return false;
 
-  size_t startIndex = start + prefix.size();
-  size_t endIndex = startIndex;
+  uint64_t multiplier = 1;
+  std::string number = str;
 
-  while(endIndex < str.size() && str[endIndex] != '\n') {
-    endIndex++;
+  switch(str.back()) {
+    case 'K': case 'k': multiplier = 1024ull; break;
+    case 'M': case 'm': multiplier = 1024ull * 1024; break;
+    case 'G': case 'g': multiplier = 1024ull * 1024 * 1024; break;
+    case 'T': case 't': multiplier = 1024ull * 1024 * 1024 * 1024; break;
   }
 
-  if(str[endIndex] != '\n') return false;
-  val = std::string(str.c_str() + startIndex, endIndex - startIndex);
+  if(multiplier != 1) number.pop_back();
+  if(number.empty()) return false;
+
+  int64_t value;
+  if(!my_strtoll(number, value) || value < 0) return false;
+  if(value != 0 && (uint64_t) value > UINT64_MAX / multiplier) return false;
+
+  ret = value * multiplier;
+  return true;
+}
 
-  if(val.empty()) return false;
+bool eostest::extractLineWithPrefix(const std::string &str, size_t start, const std::string &prefix, std::string &val) {
+  std::string_view value;
+  if(!consumeLine(str, start, prefix, value)) return false;
 
+  val = std::string(value);
   return true;
 }
 
@@ -68,3 +83,100 @@ bool eostest::isEqualAndProgressIndex(const std::string &str, size_t &index, con
   index += compare.size();
   return true;
 }
+
+bool eostest::consumeString(std::string_view str, size_t &index, std::string_view expected) {
+  if(index > str.size() || str.compare(index, expected.size(), expected) != 0) return false;
+  index += expected.size();
+  return true;
+}
+
+bool eostest::consumeLine(std::string_view str, size_t &index, std::string_view prefix, std::string_view &value) {
+  size_t start = index;
+  if(!consumeString(str, start, prefix)) return false;
+
+  const char *newline = (const char*) memchr(str.data() + start, '\n', str.size() - start);
+  if(newline == nullptr) return false;
+
+  size_t end = newline - str.data();
+  if(end == start) return false;
+
+  value = str.substr(start, end - start);
+  index = end + 1;
+  return true;
+}
+
+bool eostest::parseCanonicalDecimal(std::string_view str, uint64_t &value) {
+  if(str.empty() || str.size() > 19) return false;
+  if(str[0] == '0' && str.size() != 1) return false;
+
+  value = 0;
+  for(char c : str) {
+    if(c < '0' || c > '9') return false;
+    value = value * 10 + (c - '0');
+  }
+
+  return true;
+}
+
+void eostest::appendVarint(std::string &out, uint64_t value) {
+  while(value >= 0x80) {
+    out.push_back((char) ((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+
+  out.push_back((char) value);
+}
+
+bool eostest::consumeVarint(std::string_view str, size_t &index, uint64_t &value) {
+  value = 0;
+
+  for(size_t i = index, shift = 0; i < str.size() && shift < 64; i++, shift += 7) {
+    uint8_t byte = str[i];
+    value |= uint64_t(byte & 0x7F) << shift;
+
+    if((byte & 0x80) == 0) {
+      index = i + 1;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void eostest::appendFixed32(std::string &out, uint32_t value) {
+  for(size_t i = 0; i < 4; i++) {
+    out.push_back((char) ((value >> (8 * i)) & 0xFF));
+  }
+}
+
+uint32_t eostest::decodeFixed32(const char *data) {
+  uint32_t value = 0;
+  for(size_t i = 0; i < 4; i++) {
+    value |= uint32_t((uint8_t) data[i]) << (8 * i);
+  }
+
+  return value;
+}
+
+bool eostest::splitURL(const std::string &url, std::string &host, std::string &path) {
+  size_t protocolEnd = url.find("://");
+  if(protocolEnd == std::string::npos || protocolEnd == 0) return false;
+
+  size_t hostStart = protocolEnd + 3;
+  size_t hostEnd = url.find('/', hostStart);
+  if(hostEnd == std::string::npos || hostEnd == hostStart) return false;
+
+  // Drop any username, callers attach their own
+  size_t at = url.find('@', hostStart);
+  if(at != std::string::npos && at < hostEnd) {
+    hostStart = at + 1;
+    if(hostStart == hostEnd) return false;
+  }
+
+  host.reserve(protocolEnd + 3 + hostEnd - hostStart);
+  host.assign(url, 0, protocolEnd + 3);
+  host.append(url, hostStart, hostEnd - hostStart);
+
+  path.assign(url, hostEnd + 1, std::string::npos);
+  return true;
+}
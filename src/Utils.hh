@@ -26,6 +26,7 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include <random>
 #include <sstream>
 
@@ -33,9 +34,39 @@ namespace eostest {
 
 bool startswith(const std::string &str, size_t start, const std::string &prefix);
 bool my_strtoll(const std::string &str, int64_t &ret);
+bool parseSize(const std::string &str, uint64_t &ret); // "4096", "4K", "1G", ...
 bool extractLineWithPrefix(const std::string &str, size_t start, const std::string &prefix, std::string &val);
 bool isEqualAndProgressIndex(const std::string &str, size_t &index, const std::string &compare);
 
+//------------------------------------------------------------------------------
+// Non-allocating counterparts of the above, for parsers which validate their
+// input in place. On success, index moves past what was consumed, and value
+// points into str. A line is "prefix value\n", with a non-empty value.
+//------------------------------------------------------------------------------
+bool consumeString(std::string_view str, size_t &index, std::string_view expected);
+bool consumeLine(std::string_view str, size_t &index, std::string_view prefix, std::string_view &value);
+
+//------------------------------------------------------------------------------
+// Digits only, without sign or leading zeroes - so that printing the value
+// gives back exactly str.
+//------------------------------------------------------------------------------
+bool parseCanonicalDecimal(std::string_view str, uint64_t &value);
+
+//------------------------------------------------------------------------------
+// Binary encoding: LEB128 varints, and fixed-width little-endian integers.
+//------------------------------------------------------------------------------
+void appendVarint(std::string &out, uint64_t value);
+bool consumeVarint(std::string_view str, size_t &index, uint64_t &value);
+void appendFixed32(std::string &out, uint32_t value);
+uint32_t decodeFixed32(const char *data);
+
+//------------------------------------------------------------------------------
+// Split "root://user@host:port//some/path?opaque" into "root://host:port"
+// and "/some/path?opaque", without going through XrdCl::URL. Returns false
+// if the URL does not look like proto://host/path.
+//------------------------------------------------------------------------------
+bool splitURL(const std::string &url, std::string &host, std::string &path);
+
 inline std::string chopPath(const std::string &path) {
   std::string retval = path;
   for(size_t i = retval.size() - 1; i != 0; i--) {
@@ -0,0 +1,64 @@
+// ----------------------------------------------------------------------
+// File: XrdClConnectionPool.cc
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "XrdClConnectionPool.hh"
+#include "Macros.hh"
+#include "Utils.hh"
+using namespace eostest;
+
+XrdClEndpoint& XrdClConnectionPool::getEndpoint(size_t connectionId, const std::string &host) {
+  std::lock_guard<std::mutex> lock(mtx);
+
+  std::unique_ptr<XrdClEndpoint> &endpoint = endpoints[std::make_pair(connectionId, host)];
+  if(!endpoint) {
+    size_t protocolEnd = host.find("://");
+    endpoint.reset(new XrdClEndpoint(SSTR(host.substr(0, protocolEnd + 3) << "t" << connectionId << "@" << host.substr(protocolEnd + 3) << "/")));
+  }
+
+  return *endpoint;
+}
+
+XrdClTarget XrdClConnectionPool::resolve(size_t connectionId, const std::string &url) {
+  XrdClTarget target;
+
+  std::string host;
+  if(!splitURL(url, host, target.path)) return target;
+
+  target.endpoint = &getEndpoint(connectionId, host);
+  target.url.reserve(target.endpoint->prefix.size() + target.path.size());
+  target.url.append(target.endpoint->prefix);
+  target.url.append(target.path);
+
+  // FileSystem calls take the bare path, without any opaque info
+  size_t opaque = target.path.find('?');
+  if(opaque != std::string::npos) {
+    target.path.erase(opaque);
+  }
+
+  return target;
+}
+
+size_t XrdClConnectionPool::size() {
+  std::lock_guard<std::mutex> lock(mtx);
+  return endpoints.size();
+}
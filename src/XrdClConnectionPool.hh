@@ -0,0 +1,72 @@
+// ----------------------------------------------------------------------
+// File: XrdClConnectionPool.hh
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef EOSTESTER_XRDCL_CONNECTION_POOL_H
+#define EOSTESTER_XRDCL_CONNECTION_POOL_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <XrdCl/XrdClFileSystem.hh>
+
+namespace eostest {
+
+//------------------------------------------------------------------------------
+// A FileSystem object bound to a single (connectionId, host) pair, together
+// with the pre-built URL prefix for that pair, ie "root://t3@host:1094/".
+// Endpoints are never destroyed while the owning pool is alive, so it's safe
+// to hand out references to in-flight handlers.
+//------------------------------------------------------------------------------
+struct XrdClEndpoint {
+  XrdClEndpoint(const std::string &pref) : prefix(pref), fs(pref) {}
+
+  std::string prefix;
+  XrdCl::FileSystem fs;
+};
+
+//------------------------------------------------------------------------------
+// The result of resolving a URL through the pool: the endpoint to use,
+// the path to pass to FileSystem calls, and the full URL including the
+// connection-specific username, for File::Open.
+//------------------------------------------------------------------------------
+struct XrdClTarget {
+  XrdClEndpoint *endpoint = nullptr;
+  std::string path;
+  std::string url;
+};
+
+class XrdClConnectionPool {
+public:
+  XrdClEndpoint& getEndpoint(size_t connectionId, const std::string &host);
+  XrdClTarget resolve(size_t connectionId, const std::string &url);
+  size_t size();
+
+private:
+  std::mutex mtx;
+  std::map<std::pair<size_t, std::string>, std::unique_ptr<XrdClEndpoint>> endpoints;
+};
+
+}
+
+#endif
@@ -21,16 +21,35 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
  ************************************************************************/
 
+#include <algorithm>
 #include <iostream>
+#include <mutex>
+#include <sys/uio.h>
 #include <XrdCl/XrdClFileSystem.hh>
 #include <XrdCl/XrdClFile.hh>
 
 #include "XrdClExecutor.hh"
+#include "XrdClConnectionPool.hh"
+#include "utils/HandlerPool.hh"
+#include "utils/Sealing.hh"
 #include "Macros.hh"
 
 using namespace eostest;
 
-class HandlerHelper {
+XrdClExecutor::XrdClExecutor() : connectionPool(new XrdClConnectionPool()) {}
+XrdClExecutor::~XrdClExecutor() {}
+
+template<typename T>
+folly::Future<T> invalidURL(const std::string &url, const std::string &description) {
+  return Sealing::seal(folly::makeFuture<T>(T(SSTR("Invalid URL: " << url))), description);
+}
+
+//------------------------------------------------------------------------------
+// Base of all per-operation handlers. These are allocated on the submitting
+// thread and deleted on an XrdCl callback thread, many thousands of times per
+// second - recycle their memory through HandlerPool.
+//------------------------------------------------------------------------------
+class HandlerHelper : public PooledAllocation {
 public:
   HandlerHelper() {}
   virtual ~HandlerHelper() {}
@@ -62,13 +81,14 @@ public:
 
 class MkdirHandler : public HandlerHelper, XrdCl::ResponseHandler {
 public:
-  MkdirHandler(const XrdCl::URL &ur) : url(ur), fs(ur.GetURL()) { }
+  MkdirHandler(XrdClTarget &&targ, XrdCl::MkDirFlags::Flags fl = XrdCl::MkDirFlags::None)
+  : target(std::move(targ)), flags(fl) { }
   virtual ~MkdirHandler() {}
 
   folly::Future<TestcaseStatus> initialize() {
     folly::Future<TestcaseStatus> fut = promise.getFuture();
 
-    XrdCl::XRootDStatus status = fs.MkDir(url.GetPath(), XrdCl::MkDirFlags::None, XrdCl::Access::OR, this);
+    XrdCl::XRootDStatus status = target.endpoint->fs.MkDir(target.path, flags, XrdCl::Access::OR, this);
     if(!status.IsOK()) {
       setValueAndDeleteThis(promise, TestcaseStatus(status.ToString()));
       return fut;
@@ -82,8 +102,8 @@ public:
   }
 
 private:
-  XrdCl::URL url;
-  XrdCl::FileSystem fs;
+  XrdClTarget target;
+  XrdCl::MkDirFlags::Flags flags;
   folly::Promise<TestcaseStatus> promise;
 };
 
@@ -107,9 +127,9 @@ public:
 
 class OpenHandler : public HandlerHelper, XrdCl::ResponseHandler {
 public:
-  OpenHandler(const XrdCl::URL &ur, const XrdCl::OpenFlags::Flags &flag,
+  OpenHandler(std::string &&ur, const XrdCl::OpenFlags::Flags &flag,
     const XrdCl::Access::Mode &mod)
-  : url(ur), flags(flag), mode(mod) {}
+  : url(std::move(ur)), flags(flag), mode(mod) {}
 
   virtual ~OpenHandler() {}
 
@@ -117,7 +137,7 @@ public:
     folly::Future<OpenStatus> fut = promise.getFuture();
 
     file.reset(new XrdCl::File());
-    XrdCl::XRootDStatus status = file->Open(url.GetURL(), flags, mode, this);
+    XrdCl::XRootDStatus status = file->Open(url, flags, mode, this);
     if(!status.IsOK()) {
       setValueAndDeleteThis(promise, OpenStatus(status.ToString()));
     }
@@ -134,7 +154,7 @@ public:
   }
 
 private:
-  XrdCl::URL url;
+  std::string url;
   XrdCl::OpenFlags::Flags flags;
   XrdCl::Access::Mode mode;
 
@@ -143,9 +163,13 @@ private:
 };
 
 
+//------------------------------------------------------------------------------
+// Writes the contents in a single request. Multi-segment buffers go out as
+// one vectored write straight from the segments, without flattening them.
+//------------------------------------------------------------------------------
 class WriteHandler : public HandlerHelper, XrdCl::ResponseHandler {
 public:
-  WriteHandler(const std::string &cont) : contents(cont) {}
+  WriteHandler(const ContentBuffer &cont) : contents(cont) {}
 
   folly::Future<OpenStatus> initialize(OpenStatus openStatus) {
     folly::Future<OpenStatus> fut = promise.getFuture();
@@ -155,7 +179,25 @@ public:
       return fut;
     }
 
-    XrdCl::XRootDStatus status = openStatus.file->Write(0, contents.size(), contents.c_str(), this);
+    XrdCl::XRootDStatus status;
+    const std::vector<ContentBuffer::Segment> &segments = contents.getSegments();
+
+    if(segments.size() == 1) {
+      status = openStatus.file->Write(0, segments[0]->size(), segments[0]->c_str(), this);
+    }
+    else if(segments.empty()) {
+      status = openStatus.file->Write(0, 0, "", this);
+    }
+    else {
+      iov.resize(segments.size());
+      for(size_t i = 0; i < segments.size(); i++) {
+        iov[i].iov_base = (void*) segments[i]->c_str();
+        iov[i].iov_len = segments[i]->size();
+      }
+
+      status = openStatus.file->WriteV(0, iov.data(), iov.size(), this);
+    }
+
     if(!status.IsOK()) {
       openStatus.addError(status.ToString());
       setValueAndDeleteThis(promise, std::move(openStatus));
@@ -175,7 +217,135 @@ public:
   }
 
 private:
-  std::string contents;
+  ContentBuffer contents;
+  std::vector<struct iovec> iov;
+  OpenStatus file;
+  folly::Promise<OpenStatus> promise;
+};
+
+//------------------------------------------------------------------------------
+// Writes the output of a ContentGenerator in chunks, keeping up to
+// opts.inflight writes outstanding. Each slot owns one chunk-sized buffer,
+// which is refilled and re-issued as soon as its previous write completes,
+// so memory usage is constant regardless of file size.
+//------------------------------------------------------------------------------
+class StreamingWriteHandler : public HandlerHelper {
+public:
+  StreamingWriteHandler(std::shared_ptr<ContentGenerator> gen, const StreamingOptions &opts)
+  : generator(std::move(gen)), chunkSize(std::max<size_t>(opts.chunkSize, 1)) {
+
+    size_t chunks = (generator->size() + chunkSize - 1) / chunkSize;
+    size_t slotCount = std::max<size_t>(1, std::min<size_t>(opts.inflight, chunks));
+
+    for(size_t i = 0; i < slotCount; i++) {
+      slots.emplace_back(new Slot(this, chunkSize));
+    }
+  }
+
+  folly::Future<OpenStatus> initialize(OpenStatus openStatus) {
+    folly::Future<OpenStatus> fut = promise.getFuture();
+
+    if(!openStatus.ok()) {
+      setValueAndDeleteThis(promise, std::move(openStatus));
+      return fut;
+    }
+
+    file = std::move(openStatus);
+
+    // Hold an extra reference while issuing, so that a fast completion on
+    // another thread cannot finish the operation and delete us mid-loop.
+    inFlight = 1;
+
+    for(size_t i = 0; i < slots.size(); i++) {
+      issue(*slots[i]);
+    }
+
+    chunkDone(XrdCl::XRootDStatus());
+    return fut;
+  }
+
+private:
+  struct Slot : public XrdCl::ResponseHandler {
+    Slot(StreamingWriteHandler *p, size_t size) : parent(p), buffer(new char[size]) {}
+
+    virtual void HandleResponse(XrdCl::XRootDStatus *status, XrdCl::AnyObject *response) override {
+      StreamingWriteHandler *p = parent;
+      XrdCl::XRootDStatus st = *status;
+
+      delete status;
+      if(response) delete response;
+
+      // Re-issue before accounting for this completion: while our own write
+      // still counts as in-flight, nobody can finish the operation and
+      // delete the parent (and this slot) under our feet.
+      if(st.IsOK()) {
+        p->issue(*this);
+      }
+
+      p->chunkDone(st);
+    }
+
+    StreamingWriteHandler *parent;
+    std::unique_ptr<char[]> buffer;
+  };
+
+  //----------------------------------------------------------------------------
+  // Claim the next chunk, fill the slot buffer and send it off. Returns false
+  // if there's nothing left to write, or we've already failed.
+  //----------------------------------------------------------------------------
+  bool issue(Slot &slot) {
+    uint64_t offset;
+    size_t length;
+
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      if(failed || nextOffset >= generator->size()) return false;
+
+      offset = nextOffset;
+      length = std::min<uint64_t>(chunkSize, generator->size() - nextOffset);
+      nextOffset += length;
+      inFlight++;
+    }
+
+    generator->fill(offset, slot.buffer.get(), length);
+
+    XrdCl::XRootDStatus status = file.file->Write(offset, length, slot.buffer.get(), &slot);
+    if(!status.IsOK()) {
+      chunkDone(status);
+      return false;
+    }
+
+    return true;
+  }
+
+  void chunkDone(const XrdCl::XRootDStatus &status) {
+    bool done = false;
+
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      if(!status.IsOK()) {
+        failed = true;
+        file.addError(status.ToString());
+      }
+
+      inFlight--;
+      done = (inFlight == 0) && (failed || nextOffset >= generator->size());
+    }
+
+    if(done) {
+      setValueAndDeleteThis(promise, std::move(file));
+    }
+  }
+
+  std::shared_ptr<ContentGenerator> generator;
+  size_t chunkSize;
+  std::vector<std::unique_ptr<Slot>> slots;
+
+  std::mutex mtx;
+  uint64_t nextOffset = 0;
+  size_t inFlight = 0;
+  bool failed = false;
+
   OpenStatus file;
   folly::Promise<OpenStatus> promise;
 };
@@ -216,20 +386,28 @@ private:
   folly::Promise<OutgoingStatus> promise;
 };
 
-std::string makeURL(size_t connectionId, const std::string &path) {
-  XrdCl::URL url(path);
-  url.SetUserName(SSTR("t" << connectionId));
-  return url.GetURL();
+folly::Future<TestcaseStatus> XrdClExecutor::mkdir(size_t connectionId, const std::string &path) {
+  XrdClTarget target = connectionPool->resolve(connectionId, path);
+  if(!target.endpoint) return invalidURL<TestcaseStatus>(path, SSTR("xroot::mkdir on '" << path << "'"));
+
+  MkdirHandler *handler = new MkdirHandler(std::move(target));
+  return Sealing::seal(handler->initialize(), SSTR("xroot::mkdir on '" << path << "'"), OpType::kMkdir);
 }
 
-folly::Future<TestcaseStatus> XrdClExecutor::mkdir(size_t connectionId, const std::string &path) {
-  MkdirHandler *handler = new MkdirHandler(makeURL(connectionId, path));
-  return Sealing::seal(handler->initialize(), SSTR("xroot::mkdir on '" << path << "'"));
+folly::Future<TestcaseStatus> XrdClExecutor::mkdirs(size_t connectionId, const std::string &path) {
+  XrdClTarget target = connectionPool->resolve(connectionId, path);
+  if(!target.endpoint) return invalidURL<TestcaseStatus>(path, SSTR("xroot::mkdirs on '" << path << "'"));
+
+  MkdirHandler *handler = new MkdirHandler(std::move(target), XrdCl::MkDirFlags::MakePath);
+  return Sealing::seal(handler->initialize(), SSTR("xroot::mkdirs on '" << path << "'"), OpType::kMkdir);
 }
 
-folly::Future<TestcaseStatus> XrdClExecutor::put(size_t connectionId, const std::string &path, const std::string &contents) {
+folly::Future<TestcaseStatus> XrdClExecutor::put(size_t connectionId, const std::string &path, const ContentBuffer &contents) {
+  XrdClTarget target = connectionPool->resolve(connectionId, path);
+  if(!target.endpoint) return invalidURL<TestcaseStatus>(path, SSTR("xroot::put on '" << path << "'"));
+
   OpenHandler *openHandler = new OpenHandler(
-    makeURL(connectionId, path),
+    std::move(target.url),
     XrdCl::OpenFlags::Update | XrdCl::OpenFlags::New,
     XrdCl::Access::None
   );
@@ -241,18 +419,38 @@ folly::Future<TestcaseStatus> XrdClExecutor::put(size_t connectionId, const std:
     .then(&WriteHandler::initialize, writeHandler)
     .then(&CloseHandler<OpenStatus, TestcaseStatus>::initialize, closeHandler);
 
-  return Sealing::seal(std::move(fullOperation), SSTR("xroot::put on '" << path << "'"));
+  return Sealing::seal(std::move(fullOperation), SSTR("xroot::put on '" << path << "'"), OpType::kPut);
+}
+
+folly::Future<TestcaseStatus> XrdClExecutor::putStream(size_t connectionId, const std::string &path, std::shared_ptr<ContentGenerator> generator, const StreamingOptions &opts) {
+  XrdClTarget target = connectionPool->resolve(connectionId, path);
+  if(!target.endpoint) return invalidURL<TestcaseStatus>(path, SSTR("xroot::putStream on '" << path << "'"));
+
+  OpenHandler *openHandler = new OpenHandler(
+    std::move(target.url),
+    XrdCl::OpenFlags::Update | XrdCl::OpenFlags::New,
+    XrdCl::Access::None
+  );
+
+  StreamingWriteHandler *writeHandler = new StreamingWriteHandler(std::move(generator), opts);
+  CloseHandler<OpenStatus, TestcaseStatus> *closeHandler = new CloseHandler<OpenStatus, TestcaseStatus>();
+
+  folly::Future<TestcaseStatus> fullOperation = openHandler->initialize()
+    .then(&StreamingWriteHandler::initialize, writeHandler)
+    .then(&CloseHandler<OpenStatus, TestcaseStatus>::initialize, closeHandler);
+
+  return Sealing::seal(std::move(fullOperation), SSTR("xroot::putStream on '" << path << "'"), OpType::kPutStream);
 }
 
 class RmHandler : public HandlerHelper, XrdCl::ResponseHandler {
 public:
-  RmHandler(const XrdCl::URL &ur) : url(ur), fs(ur.GetURL()) { }
+  RmHandler(XrdClTarget &&targ) : target(std::move(targ)) { }
   virtual ~RmHandler() {}
 
   folly::Future<TestcaseStatus> initialize() {
     folly::Future<TestcaseStatus> fut = promise.getFuture();
 
-    XrdCl::XRootDStatus status = fs.Rm(url.GetPath(), this);
+    XrdCl::XRootDStatus status = target.endpoint->fs.Rm(target.path, this);
     if(!status.IsOK()) {
       setValueAndDeleteThis(promise, TestcaseStatus(status.ToString()));
       return fut;
@@ -266,8 +464,7 @@ public:
   }
 
 private:
-  XrdCl::URL url;
-  XrdCl::FileSystem fs;
+  XrdClTarget target;
   folly::Promise<TestcaseStatus> promise;
 };
 
@@ -298,10 +495,23 @@ ReadStatus::ReadStatus(ReadOutcome &&outcome) {
   *this = std::move(outcome.readStatus);
 }
 
-class ReadHandler : public HandlerHelper, XrdCl::ResponseHandler {
+//------------------------------------------------------------------------------
+// Reads a whole file in chunks, keeping up to opts.inflight reads outstanding,
+// and hands the chunks to a ChunkConsumer strictly in file order. The size
+// comes from the stat information cached by open, so there's no extra
+// round-trip, and no guessing of buffer sizes.
+//
+// Reads may complete out of order: a completed chunk stays in its slot until
+// every chunk before it has been consumed, at which point the slot gets
+// re-issued for the next unread offset. Whichever thread completes the chunk
+// at the head of the file does the consuming, one thread at a time.
+//------------------------------------------------------------------------------
+class StreamingReadHandler : public HandlerHelper {
 public:
-  ReadHandler(size_t size = 4096) {
-    retval.readStatus.contents.resize(size);
+  StreamingReadHandler(std::shared_ptr<ChunkConsumer> cons, const StreamingOptions &opts)
+  : consumer(std::move(cons)), options(opts), statHandler(this) {
+    options.chunkSize = std::max<size_t>(options.chunkSize, 1);
+    options.inflight = std::max<size_t>(options.inflight, 1);
   }
 
   folly::Future<ReadOutcome> initialize(OpenStatus openStatus) {
@@ -313,77 +523,289 @@ public:
     }
 
     retval.file = std::move(openStatus.file);
-    XrdCl::XRootDStatus status = retval.file->Read(
-      0,
-      retval.readStatus.contents.size(),
-      (void*) retval.readStatus.contents.c_str(),
-      this
-    );
+    pending = 1;
 
+    XrdCl::XRootDStatus status = retval.file->Stat(false, &statHandler);
     if(!status.IsOK()) {
-      retval.readStatus.addError(status.ToString());
-      setValueAndDeleteThis(promise, std::move(retval));
-      return fut;
+      fail(status.ToString());
+      release();
     }
 
     return fut;
   }
 
-  virtual void HandleResponse(XrdCl::XRootDStatus *status, XrdCl::AnyObject *response) override {
-    if(!status->IsOK()) {
-      retval.readStatus.addError(status->ToString());
+private:
+  struct StatResponse : public XrdCl::ResponseHandler {
+    StatResponse(StreamingReadHandler *p) : parent(p) {}
+
+    virtual void HandleResponse(XrdCl::XRootDStatus *status, XrdCl::AnyObject *response) override {
+      if(!status->IsOK()) {
+        parent->fail(status->ToString());
+        delete status;
+        if(response) delete response;
+        return parent->release();
+      }
+
+      XrdCl::StatInfo *info;
+      response->Get(info);
+      uint64_t size = info->GetSize();
+
+      delete status;
+      delete response;
+      parent->statDone(size);
     }
-    else {
-      XrdCl::ChunkInfo *chunk;
-      response->Get(chunk);
-      response->Set( (int*) 0);
-      size_t bytesRead = chunk->length;
-      delete chunk;
 
-      retval.readStatus.contents.resize(bytesRead);
+    StreamingReadHandler *parent;
+  };
+
+  struct Slot : public XrdCl::ResponseHandler {
+    Slot(StreamingReadHandler *p, size_t size) : parent(p), buffer(new char[size]) {}
+
+    virtual void HandleResponse(XrdCl::XRootDStatus *status, XrdCl::AnyObject *response) override {
+      StreamingReadHandler *p = parent;
+
+      if(!status->IsOK()) {
+        p->fail(status->ToString());
+      }
+      else {
+        XrdCl::ChunkInfo *chunk;
+        response->Get(chunk);
+        response->Set( (int*) 0);
+        bytesRead = chunk->length;
+        delete chunk;
+      }
+
+      delete status;
+      if(response) delete response;
+
+      p->readDone(*this);
     }
 
-    return finalize(promise, status, response, std::move(retval));
+    StreamingReadHandler *parent;
+    std::unique_ptr<char[]> buffer;
+
+    uint64_t offset = 0;
+    size_t length = 0;
+    size_t bytesRead = 0;
+    bool ready = false;
+  };
+
+  void statDone(uint64_t size) {
+    fileSize = size;
+
+    size_t chunkSize = std::min<uint64_t>(options.chunkSize, fileSize);
+    size_t chunks = chunkSize == 0 ? 0 : (fileSize + chunkSize - 1) / chunkSize;
+    size_t slotCount = std::min<size_t>(options.inflight, chunks);
+
+    for(size_t i = 0; i < slotCount; i++) {
+      slots.emplace_back(new Slot(this, chunkSize));
+    }
+
+    for(size_t i = 0; i < slots.size(); i++) {
+      issue(*slots[i]);
+    }
+
+    // The stat itself is done.
+    release();
   }
 
-private:
+  //----------------------------------------------------------------------------
+  // Point the slot at the next unread chunk and send it off.
+  //----------------------------------------------------------------------------
+  void issue(Slot &slot) {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      if(failed || nextReadOffset >= fileSize) return;
+
+      slot.offset = nextReadOffset;
+      slot.length = std::min<uint64_t>(options.chunkSize, fileSize - nextReadOffset);
+      slot.bytesRead = 0;
+      slot.ready = false;
+      nextReadOffset += slot.length;
+      pending++;
+    }
+
+    XrdCl::XRootDStatus status = retval.file->Read(slot.offset, slot.length, slot.buffer.get(), &slot);
+    if(!status.IsOK()) {
+      fail(status.ToString());
+      release();
+    }
+  }
+
+  void readDone(Slot &slot) {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      slot.ready = true;
+    }
+
+    drain();
+
+    // Only now give up our reference: drain() may have touched any slot.
+    release();
+  }
+
+  //----------------------------------------------------------------------------
+  // Feed the consumer every chunk which is next in line, re-issuing each slot
+  // once its contents are no longer needed. If another thread is already
+  // consuming, it will pick up our chunk before it stops.
+  //----------------------------------------------------------------------------
+  void drain() {
+    while(true) {
+      Slot *head = nullptr;
+
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        if(consuming || failed) return;
+
+        for(size_t i = 0; i < slots.size(); i++) {
+          if(slots[i]->ready && slots[i]->offset == nextConsumeOffset) {
+            head = slots[i].get();
+            break;
+          }
+        }
+
+        if(!head) return;
+        head->ready = false;
+        consuming = true;
+      }
+
+      if(head->bytesRead != head->length) {
+        fail(SSTR("Short read at offset " << head->offset << ": expected " << head->length <<
+          " bytes, received " << head->bytesRead << " - file changed size after open?"));
+      }
+      else {
+        consumer->consume(head->buffer.get(), head->bytesRead);
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        nextConsumeOffset += head->length;
+        consuming = false;
+      }
+
+      issue(*head);
+    }
+  }
+
+  void fail(const std::string &err) {
+    std::lock_guard<std::mutex> lock(mtx);
+    failed = true;
+    retval.addError(err);
+  }
+
+  void release() {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      pending--;
+      if(pending != 0) return;
+    }
+
+    if(!failed) {
+      retval.readStatus.absorbErrors(consumer->finish());
+    }
+
+    setValueAndDeleteThis(promise, std::move(retval));
+  }
+
+  std::shared_ptr<ChunkConsumer> consumer;
+  StreamingOptions options;
+  StatResponse statHandler;
+  std::vector<std::unique_ptr<Slot>> slots;
+
+  std::mutex mtx;
+  uint64_t fileSize = 0;
+  uint64_t nextReadOffset = 0;
+  uint64_t nextConsumeOffset = 0;
+  size_t pending = 0;
+  bool consuming = false;
+  bool failed = false;
+
   ReadOutcome retval;
   folly::Promise<ReadOutcome> promise;
 };
 
+//------------------------------------------------------------------------------
+// Collects the entire file into a string, for get().
+//------------------------------------------------------------------------------
+class StringConsumer : public ChunkConsumer {
+public:
+  virtual void consume(const char *data, size_t length) override {
+    contents.append(data, length);
+  }
+
+  virtual TestcaseStatus finish() override {
+    return TestcaseStatus();
+  }
+
+  std::string contents;
+};
+
 folly::Future<ReadStatus> XrdClExecutor::get(size_t connectionId, const std::string &path) {
+  XrdClTarget target = connectionPool->resolve(connectionId, path);
+  if(!target.endpoint) return invalidURL<ReadStatus>(path, SSTR("xroot::get on '" << path << "'"));
+
   OpenHandler *openHandler = new OpenHandler(
-    makeURL(connectionId, path),
+    std::move(target.url),
     XrdCl::OpenFlags::Read,
     XrdCl::Access::None
   );
 
-  ReadHandler *readHandler = new ReadHandler();
-
+  std::shared_ptr<StringConsumer> consumer = std::make_shared<StringConsumer>();
+  StreamingReadHandler *readHandler = new StreamingReadHandler(consumer, StreamingOptions());
   CloseHandler<ReadOutcome, ReadStatus> *closeHandler = new CloseHandler<ReadOutcome, ReadStatus>();
 
   folly::Future<ReadStatus> fullOperation = openHandler->initialize()
-    .then(&ReadHandler::initialize, readHandler)
-    .then(&CloseHandler<ReadOutcome, ReadStatus>::initialize, closeHandler);
+    .then(&StreamingReadHandler::initialize, readHandler)
+    .then(&CloseHandler<ReadOutcome, ReadStatus>::initialize, closeHandler)
+    .thenValue([consumer](ReadStatus status) {
+      status.contents = std::move(consumer->contents);
+      return status;
+    });
+
+  return Sealing::seal(std::move(fullOperation), SSTR("xroot::get on '" << path << "'"), OpType::kGet);
+}
 
-  return Sealing::seal(std::move(fullOperation), SSTR("xroot::get on '" << path << "'"));
+folly::Future<TestcaseStatus> XrdClExecutor::getStream(size_t connectionId, const std::string &path, std::shared_ptr<ChunkConsumer> consumer, const StreamingOptions &opts) {
+  XrdClTarget target = connectionPool->resolve(connectionId, path);
+  if(!target.endpoint) return invalidURL<TestcaseStatus>(path, SSTR("xroot::getStream on '" << path << "'"));
+
+  OpenHandler *openHandler = new OpenHandler(
+    std::move(target.url),
+    XrdCl::OpenFlags::Read,
+    XrdCl::Access::None
+  );
+
+  StreamingReadHandler *readHandler = new StreamingReadHandler(std::move(consumer), opts);
+  CloseHandler<ReadOutcome, ReadStatus> *closeHandler = new CloseHandler<ReadOutcome, ReadStatus>();
+
+  folly::Future<TestcaseStatus> fullOperation = openHandler->initialize()
+    .then(&StreamingReadHandler::initialize, readHandler)
+    .then(&CloseHandler<ReadOutcome, ReadStatus>::initialize, closeHandler)
+    .thenValue([](ReadStatus status) {
+      return TestcaseStatus(std::move(status));
+    });
+
+  return Sealing::seal(std::move(fullOperation), SSTR("xroot::getStream on '" << path << "'"), OpType::kGetStream);
 }
 
 folly::Future<TestcaseStatus> XrdClExecutor::rm(size_t connectionId, const std::string &path) {
-  XrdCl::URL url = makeURL(connectionId, path);
-  RmHandler *rmHandler = new RmHandler(url);
-  return Sealing::seal(rmHandler->initialize(), SSTR("xroot::rm on '" << url.GetURL() << "'"));
+  XrdClTarget target = connectionPool->resolve(connectionId, path);
+  if(!target.endpoint) return invalidURL<TestcaseStatus>(path, SSTR("xroot::rm on '" << path << "'"));
+
+  std::string description = SSTR("xroot::rm on '" << target.url << "'");
+  RmHandler *rmHandler = new RmHandler(std::move(target));
+  return Sealing::seal(rmHandler->initialize(), description, OpType::kRm);
 }
 
 class DirListHandler : public HandlerHelper, XrdCl::ResponseHandler {
 public:
-  DirListHandler(const XrdCl::URL &ur) : url(ur), fs(url.GetURL()) {}
+  DirListHandler(XrdClTarget &&targ) : target(std::move(targ)) {}
 
   folly::Future<DirListStatus> initialize() {
     folly::Future<DirListStatus> fut = promise.getFuture();
 
-    XrdCl::XRootDStatus status = fs.DirList(
-      url.GetPath(),
+    XrdCl::XRootDStatus status = target.endpoint->fs.DirList(
+      target.path,
       XrdCl::DirListFlags::Stat,
       this
     );
@@ -412,30 +834,28 @@ public:
   }
 
 private:
-  XrdCl::URL url;
-  XrdCl::FileSystem fs;
+  XrdClTarget target;
   folly::Promise<DirListStatus> promise;
 };
 
 folly::Future<DirListStatus> XrdClExecutor::dirList(size_t connectionId, const std::string &path) {
-  XrdCl::URL url = makeURL(connectionId, path);
+  XrdClTarget target = connectionPool->resolve(connectionId, path);
+  if(!target.endpoint) return invalidURL<DirListStatus>(path, SSTR("xroot::DirList on '" << path << "'"));
 
-  DirListHandler *handler = new DirListHandler(url);
-  return Sealing::seal(handler->initialize(), SSTR("xroot::DirList on '" << url.GetURL() << "'"));
+  std::string description = SSTR("xroot::DirList on '" << target.url << "'");
+  DirListHandler *handler = new DirListHandler(std::move(target));
+  return Sealing::seal(handler->initialize(), description, OpType::kDirList);
 }
 
 class RmdirHandler : public HandlerHelper, XrdCl::ResponseHandler {
 public:
-  RmdirHandler(const std::string &path)
-  : url(path), fs(url.GetURL()) {
-
-  }
+  RmdirHandler(XrdClTarget &&targ) : target(std::move(targ)) {}
 
   folly::Future<TestcaseStatus> initialize() {
     folly::Future<TestcaseStatus> fut = promise.getFuture();
 
-    XrdCl::XRootDStatus status = fs.RmDir(
-      url.GetPath(),
+    XrdCl::XRootDStatus status = target.endpoint->fs.RmDir(
+      target.path,
       this
     );
 
@@ -451,12 +871,81 @@ public:
   }
 
 private:
-  XrdCl::URL url;
-  XrdCl::FileSystem fs;
+  XrdClTarget target;
   folly::Promise<TestcaseStatus> promise;
 };
 
 folly::Future<TestcaseStatus> XrdClExecutor::rmdir(size_t connectionId, const std::string &url) {
-  RmdirHandler *handler = new RmdirHandler(url);
-  return Sealing::seal(handler->initialize(), SSTR("xroot::rmdir on '" << url << "'"));
+  XrdClTarget target = connectionPool->resolve(connectionId, url);
+  if(!target.endpoint) return invalidURL<TestcaseStatus>(url, SSTR("xroot::rmdir on '" << url << "'"));
+
+  RmdirHandler *handler = new RmdirHandler(std::move(target));
+  return Sealing::seal(handler->initialize(), SSTR("xroot::rmdir on '" << url << "'"), OpType::kRmdir);
+}
+
+class ChecksumHandler : public HandlerHelper, XrdCl::ResponseHandler {
+public:
+  ChecksumHandler(XrdClTarget &&targ, const std::string &t) : target(std::move(targ)), type(t) {}
+
+  folly::Future<ChecksumStatus> initialize() {
+    folly::Future<ChecksumStatus> fut = promise.getFuture();
+
+    XrdCl::Buffer arg;
+    arg.FromString(SSTR(target.path << "?cks.type=" << type));
+
+    XrdCl::XRootDStatus status = target.endpoint->fs.Query(
+      XrdCl::QueryCode::Checksum,
+      arg,
+      this
+    );
+
+    if(!status.IsOK()) {
+      setValueAndDeleteThis(promise, ChecksumStatus(status.ToString()));
+    }
+
+    return fut;
+  }
+
+  virtual void HandleResponse(XrdCl::XRootDStatus *status, XrdCl::AnyObject *response) override {
+    if(!status->IsOK()) {
+      return finalize(promise, status, response, ChecksumStatus(status->ToString()));
+    }
+
+    // Response is "<type> <value>", possibly NUL-terminated
+    XrdCl::Buffer *buffer = nullptr;
+    response->Get(buffer);
+
+    std::string contents;
+    if(buffer) contents = std::string(buffer->GetBuffer(), buffer->GetSize());
+    contents = contents.substr(0, contents.find('\0'));
+
+    size_t space = contents.find(' ');
+    if(space == std::string::npos) {
+      return finalize(promise, status, response, ChecksumStatus(SSTR("Malformed checksum response for " << target.url << ": " << contents)));
+    }
+
+    ChecksumStatus retval;
+    retval.type = contents.substr(0, space);
+    retval.value = contents.substr(space + 1);
+
+    while(!retval.value.empty() && isspace(retval.value.back())) {
+      retval.value.pop_back();
+    }
+
+    return finalize(promise, status, response, std::move(retval));
+  }
+
+private:
+  XrdClTarget target;
+  std::string type;
+  folly::Promise<ChecksumStatus> promise;
+};
+
+folly::Future<ChecksumStatus> XrdClExecutor::checksum(size_t connectionId, const std::string &url, const std::string &type) {
+  XrdClTarget target = connectionPool->resolve(connectionId, url);
+  if(!target.endpoint) return invalidURL<ChecksumStatus>(url, SSTR("xroot::checksum on '" << url << "'"));
+
+  std::string description = SSTR("xroot::checksum on '" << target.url << "'");
+  ChecksumHandler *handler = new ChecksumHandler(std::move(target), type);
+  return Sealing::seal(handler->initialize(), description, OpType::kChecksum);
 }
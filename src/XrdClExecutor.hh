@@ -24,39 +24,33 @@
 #ifndef EOSTESTER_XRDCL_EXECUTOR_H
 #define EOSTESTER_XRDCL_EXECUTOR_H
 
-#include <future>
-#include <vector>
+#include <memory>
 #include <string>
-#include "utils/TestcaseStatus.hh"
-#include "utils/Sealing.hh"
-#include <folly/futures/Future.h>
-#include <XrdCl/XrdClFileSystem.hh>
+#include "Executor.hh"
 
 namespace eostest {
 
-class ReadOutcome;
+class XrdClConnectionPool;
 
-class ReadStatus : public TestcaseStatus {
+class XrdClExecutor : public Executor {
 public:
-  using TestcaseStatus::TestcaseStatus;
-  ReadStatus(ReadOutcome &&outcome);
-  std::string contents;
-};
-
-class DirListStatus : public TestcaseStatus {
-public:
-  using TestcaseStatus::TestcaseStatus;
-  std::unique_ptr<XrdCl::DirectoryList> contents;
-};
-
-class XrdClExecutor {
-public:
-  static folly::Future<TestcaseStatus> mkdir(size_t connectionId, const std::string &url);
-  static folly::Future<TestcaseStatus> put(size_t connectionId, const std::string &url, const std::string &contents);
-  static folly::Future<TestcaseStatus> rm(size_t connectionId, const std::string &url);
-  static folly::Future<ReadStatus> get(size_t connectionId, const std::string &path);
-  static folly::Future<DirListStatus> dirList(size_t connectionId, const std::string &url);
-  static folly::Future<TestcaseStatus> rmdir(size_t connectionId, const std::string &url);
+  XrdClExecutor();
+  virtual ~XrdClExecutor();
+
+  virtual folly::Future<TestcaseStatus> mkdir(size_t connectionId, const std::string &url) override;
+  virtual folly::Future<TestcaseStatus> mkdirs(size_t connectionId, const std::string &url) override;
+  virtual folly::Future<TestcaseStatus> put(size_t connectionId, const std::string &url, const ContentBuffer &contents) override;
+  virtual folly::Future<TestcaseStatus> putStream(size_t connectionId, const std::string &url, std::shared_ptr<ContentGenerator> generator, const StreamingOptions &opts) override;
+  virtual folly::Future<TestcaseStatus> rm(size_t connectionId, const std::string &url) override;
+  virtual folly::Future<TestcaseStatus> getStream(size_t connectionId, const std::string &url, std::shared_ptr<ChunkConsumer> consumer, const StreamingOptions &opts) override;
+  virtual folly::Future<ReadStatus> get(size_t connectionId, const std::string &path) override;
+  virtual folly::Future<DirListStatus> dirList(size_t connectionId, const std::string &url) override;
+  virtual folly::Future<TestcaseStatus> rmdir(size_t connectionId, const std::string &url) override;
+  virtual folly::Future<ChecksumStatus> checksum(size_t connectionId, const std::string &url, const std::string &type) override;
+
+private:
+  // FileSystem objects and URL prefixes, shared by all operations
+  std::unique_ptr<XrdClConnectionPool> connectionPool;
 };
 
 }
@@ -21,19 +21,56 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
  ************************************************************************/
 
+#include <cstdlib>
 #include <iostream>
 #include <sstream>
+#include <unistd.h>
 #include <rang.hpp>
 #include <CLI11.hpp>
 
 #include "utils/ProgressTracker.hh"
 #include "utils/ProgressTicker.hh"
+#include "utils/HandlerPool.hh"
+#include "utils/LatencyHistogram.hh"
+#include "utils/ShardCoordinator.hh"
 
 #include "testcases/TreeBuilder.hh"
+#include "testcases/TreeDestroyer.hh"
 #include "testcases/TreeValidator.hh"
+#include "testcases/LargeFileTester.hh"
+#include "CommandLine.hh"
+#include "XrdClExecutor.hh"
+#include "Utils.hh"
+#include "HashCalculator.hh"
 
 using namespace eostest;
 
+static void printStatistics(std::chrono::nanoseconds elapsed) {
+  std::cout << std::endl << LatencyRecorder::report(elapsed) << std::endl;
+
+  HandlerPool::Stats stats = HandlerPool::getStats();
+  std::cout << "Handler allocations: " << stats.allocations << ", of which " << stats.heapAllocations
+            << " from the system allocator" << std::endl;
+}
+
+static TestcaseStatus buildTree(Executor &executor, TreeBuilder::Options opts, bool showProgress) {
+  // One journal per shard, workers may well share a directory
+  if(opts.shards > 1 && !opts.journal.empty()) {
+    opts.journal += ".shard-" + std::to_string(opts.shard);
+  }
+
+  std::pair<uint64_t, uint64_t> range = TreeBuilder::shardRange(opts);
+  ProgressTracker tracker(range.second - range.first);
+  TreeBuilder builder(executor, opts, &tracker);
+
+  if(!showProgress) return builder.initialize().get();
+
+  ProgressTicker ticker(tracker);
+  TestcaseStatus accu = builder.initialize().get();
+  ticker.stop();
+  return accu;
+}
+
 int main(int argc, char **argv) {
   // Reset terminal colors on exit
   std::atexit([](){std::cout << rang::style::reset;});
@@ -41,64 +78,188 @@ int main(int argc, char **argv) {
   // Force colours.
   rang::setControlMode(rang::control::Force);
 
-  TreeBuilder::Options builderOpts;
-  std::string targetPath = "";
+  CommandLine cli;
 
-  CLI::App app{"This tool collects a number of functional and stress tests for the EOS storage system."};
+  try {
+    cli.app.parse(argc, argv);
+  } catch (const CLI::ParseError &e) {
+    return cli.app.exit(e);
+  }
 
-  auto treeSubcommand = app.add_subcommand("tree", "Build and verify namespace trees");
-  app.require_subcommand();
+  if(!cli.builderOpts.checksumType.empty() && !HashCalculator::isSupportedChecksum(cli.builderOpts.checksumType)) {
+    std::cerr << "Unknown --checksums: " << cli.builderOpts.checksumType << std::endl;
+    return 1;
+  }
 
-  auto buildOpt = treeSubcommand->add_option("--build", targetPath, "Build a namespace tree in the specified URL.");
-  auto seedOpt = treeSubcommand->add_option("--seed", builderOpts.seed, "Random seed to use when building a namespace tree.", true)
-    ->needs(buildOpt);
+  struct ShapeOption { const char *flag; const std::string &spec; Distribution &distribution; };
+  std::vector<ShapeOption> shapeOptions = {
+    {"--subdirs", cli.subdirsSpec, cli.builderOpts.shape.subdirs},
+    {"--files-per-dir", cli.filesSpec, cli.builderOpts.shape.files},
+    {"--file-size", cli.fileSizeSpec, cli.builderOpts.shape.fileSize},
+    {"--depth-distribution", cli.depthSpec, cli.builderOpts.shape.depth}
+  };
 
-  auto depthOpt = treeSubcommand->add_option("--depth", builderOpts.depth, "The depth of the namespace tree to be created.", true)
-    ->needs(buildOpt);
+  for(const ShapeOption &shapeOption : shapeOptions) {
+    std::string error;
+    if(!shapeOption.spec.empty() && !Distribution::parse(shapeOption.spec, shapeOption.distribution, error)) {
+      std::cerr << "Could not parse " << shapeOption.flag << ": " << error << std::endl;
+      return 1;
+    }
+  }
 
-  auto nfilesOpt = treeSubcommand->add_option("--nfiles", builderOpts.files, "The size in number of files for the namesapce tree to build")
-   ->needs(buildOpt);
+  std::string shapeError = cli.builderOpts.shape.check();
+  if(!shapeError.empty()) {
+    std::cerr << "Invalid tree shape: " << shapeError << std::endl;
+    return 1;
+  }
 
-  auto validateOpt = treeSubcommand->add_option("--validate", targetPath, "Verify a namespace tree present in the specified URL.")
-    ->excludes(buildOpt)
-    ->excludes(seedOpt)
-    ->excludes(depthOpt)
-    ->excludes(nfilesOpt);
+  if(!parsePlacementPolicy(cli.placement, cli.builderOpts.placement)) {
+    std::cerr << "Unknown --placement: " << cli.placement << std::endl;
+    return 1;
+  }
 
-  buildOpt->group("Operation");
-  validateOpt->group("Operation");
+  if(cli.builderOpts.shards == 0 || (cli.shard >= 0 && (size_t) cli.shard >= cli.builderOpts.shards)) {
+    std::cerr << "--shard must be between 0 and --shards minus one, and --shards positive" << std::endl;
+    return 1;
+  }
 
-  try {
-    app.parse(argc, argv);
-  } catch (const CLI::ParseError &e) {
-    return app.exit(e);
+  if(*cli.shardOpt && cli.spool.empty()) {
+    std::cerr << "--shard needs --spool, to publish its results into" << std::endl;
+    return 1;
+  }
+
+  if(*cli.largeFileSubcommand) {
+    if(!parseSize(cli.largeFileSize, cli.largeFileOpts.size)) {
+      std::cerr << "Could not parse --size: " << cli.largeFileSize << std::endl;
+      return 1;
+    }
+
+    uint64_t chunk;
+    if(!parseSize(cli.chunkSize, chunk) || chunk == 0 || chunk > UINT32_MAX) {
+      std::cerr << "Could not parse --chunk-size, or out of range: " << cli.chunkSize << std::endl;
+      return 1;
+    }
+
+    cli.largeFileOpts.streaming.chunkSize = chunk;
   }
 
   int retval = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  cli.builderOpts.baseUrl = cli.targetPath;
+  cli.builderOpts.targetP99 = std::chrono::milliseconds(cli.targetP99);
+
+  if(*cli.buildOpt && cli.builderOpts.shards > 1 && cli.shard < 0) {
+    // Coordinator: fork before XrdCl starts any threads of its own
+    bool temporarySpool = cli.spool.empty();
+    if(temporarySpool) {
+      char tmpl[] = "/tmp/eos-tester-spool-XXXXXX";
+      if(!mkdtemp(tmpl)) {
+        std::cerr << "Could not create a temporary spool directory" << std::endl;
+        return 1;
+      }
+
+      cli.spool = tmpl;
+    }
+
+    ShardCoordinator coordinator(cli.spool, cli.builderOpts.shards);
 
-  if(*buildOpt) {
-    ProgressTracker tracker(builderOpts.files);
-    builderOpts.baseUrl = targetPath;
-    TreeBuilder builder(builderOpts, &tracker);
+    std::string error;
+    if(!coordinator.claim(error)) {
+      std::cerr << error << std::endl;
+      if(temporarySpool) rmdir(cli.spool.c_str());
+      return 1;
+    }
+
+    if(cli.remoteWorkers) {
+      std::cout << "Waiting for the results of " << cli.builderOpts.shards << " workers in " << cli.spool << std::endl;
+    }
+    else {
+      bool launched = coordinator.launch([&](size_t workerShard) {
+        XrdClExecutor executor;
+        TreeBuilder::Options opts = cli.builderOpts;
+        opts.shard = workerShard;
+
+        TestcaseStatus accu = buildTree(executor, opts, false);
+        if(!coordinator.publish(workerShard, accu)) return 2;
+        return accu.ok() ? 0 : 1;
+      });
+
+      if(!launched) {
+        std::cerr << "Could not fork worker processes" << std::endl;
+        coordinator.release(temporarySpool);
+        return 1;
+      }
+    }
+
+    TestcaseStatus accu = coordinator.collect();
+    coordinator.release(temporarySpool);
+    std::cout << accu.prettyPrint();
+    if(!accu.ok()) retval = 1;
+
+    printStatistics(std::chrono::steady_clock::now() - start);
+    return retval;
+  }
+
+  XrdClExecutor executor;
+
+  if(*cli.buildOpt) {
+    if(cli.shard >= 0) cli.builderOpts.shard = cli.shard;
+    TestcaseStatus accu = buildTree(executor, cli.builderOpts, true);
+
+    if(cli.shard >= 0 && !ShardCoordinator(cli.spool, cli.builderOpts.shards).publish(cli.shard, accu)) {
+      std::cerr << "Could not publish results into " << cli.spool << std::endl;
+      retval = 1;
+    }
+
+    std::cout << accu.prettyPrint();
+    if(!accu.ok()) retval = 1;
+  }
+  else if(*cli.validateOpt) {
+    ProgressTracker tracker(-1);
+    cli.validatorOpts.url = cli.targetPath;
+    cli.validatorOpts.maxInflight = cli.builderOpts.maxInflight;
+    TreeValidator validator(executor, cli.validatorOpts, &tracker);
 
     ProgressTicker ticker(tracker);
-    TestcaseStatus accu = builder.initialize().get();
+    TestcaseStatus accu = validator.initialize().get();
     ticker.stop();
 
     std::cout << accu.prettyPrint();
     if(!accu.ok()) retval = 1;
   }
-  else if(*validateOpt) {
+  else if(*cli.destroyOpt) {
     ProgressTracker tracker(-1);
-    TreeValidator validator(targetPath, &tracker);
+    TreeDestroyer::Options destroyerOpts;
+    destroyerOpts.url = cli.targetPath;
+    destroyerOpts.maxInflight = cli.builderOpts.maxInflight;
+    destroyerOpts.targetP99 = cli.builderOpts.targetP99;
+    destroyerOpts.connections = cli.builderOpts.connections;
+    destroyerOpts.placement = cli.builderOpts.placement;
+    TreeDestroyer destroyer(executor, destroyerOpts, &tracker);
 
     ProgressTicker ticker(tracker);
-    TestcaseStatus accu = validator.initialize().get();
+    TestcaseStatus accu = destroyer.initialize().get();
     ticker.stop();
 
     std::cout << accu.prettyPrint();
     if(!accu.ok()) retval = 1;
   }
+  else if(*cli.writeOpt) {
+    LargeFileTester tester(executor, cli.largeFileOpts);
+    TestcaseStatus accu = tester.write().get();
+
+    std::cout << accu.prettyPrint();
+    if(!accu.ok()) retval = 1;
+  }
+  else if(*cli.readOpt) {
+    LargeFileTester tester(executor, cli.largeFileOpts);
+    TestcaseStatus accu = tester.read().get();
+
+    std::cout << accu.prettyPrint();
+    if(!accu.ok()) retval = 1;
+  }
 
+  printStatistics(std::chrono::steady_clock::now() - start);
   return retval;
 }
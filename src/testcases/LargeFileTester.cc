@@ -0,0 +1,73 @@
+// ----------------------------------------------------------------------
+// File: LargeFileTester.cc
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include <iomanip>
+#include <rang.hpp>
+#include "Macros.hh"
+#include "LargeFileTester.hh"
+#include "../Executor.hh"
+using namespace eostest;
+
+static std::string describeBandwidth(uint64_t bytes, std::chrono::nanoseconds duration) {
+  double seconds = std::chrono::duration<double>(duration).count();
+  double megabytes = bytes / (1024.0 * 1024.0);
+
+  std::ostringstream ss;
+  ss << std::fixed << std::setprecision(2) << megabytes << " MB in " << seconds << " sec";
+  if(seconds > 0) ss << ", " << megabytes / seconds << " MB/s";
+  return ss.str();
+}
+
+LargeFileTester::LargeFileTester(Executor &exec, const Options &opts)
+: executor(exec), options(opts) {}
+
+folly::Future<TestcaseStatus> LargeFileTester::write() {
+  std::shared_ptr<ContentGenerator> generator(new PatternGenerator(options.seed, options.size));
+  std::string description = SSTR(rang::style::bold << rang::fg::magenta << "Write large file" << rang::style::reset << " :: " << options.url);
+  uint64_t size = options.size;
+
+  return executor.putStream(1, options.url, generator, options.streaming)
+    .thenValue([description, size](TestcaseStatus status) {
+      if(status.ok()) {
+        status.seal(SSTR(description << " :: " << describeBandwidth(size, status.getDuration())), status.getDuration());
+      }
+
+      return status;
+    });
+}
+
+folly::Future<TestcaseStatus> LargeFileTester::read() {
+  std::shared_ptr<ContentGenerator> generator(new PatternGenerator(options.seed, options.size));
+  std::shared_ptr<ChunkConsumer> verifier(new GeneratorVerifier(generator));
+  std::string description = SSTR(rang::style::bold << rang::fg::magenta << "Read large file" << rang::style::reset << " :: " << options.url);
+  uint64_t size = options.size;
+
+  return executor.getStream(1, options.url, verifier, options.streaming)
+    .thenValue([description, size](TestcaseStatus status) {
+      if(status.ok()) {
+        status.seal(SSTR(description << " :: " << describeBandwidth(size, status.getDuration())), status.getDuration());
+      }
+
+      return status;
+    });
+}
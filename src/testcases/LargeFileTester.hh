@@ -0,0 +1,61 @@
+// ----------------------------------------------------------------------
+// File: LargeFileTester.hh
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef EOSTESTER_TESTCASE_LARGE_FILE_TESTER_H
+#define EOSTESTER_TESTCASE_LARGE_FILE_TESTER_H
+
+#include <string>
+#include <folly/futures/Future.h>
+#include "../utils/TestcaseStatus.hh"
+#include "../ContentGenerator.hh"
+
+namespace eostest {
+
+class Executor;
+
+//------------------------------------------------------------------------------
+// Measure the bandwidth of a single, arbitrarily large file. Contents are
+// streamed from a PatternGenerator, never held in memory whole - when reading
+// back, every byte is checked against the generator as it arrives.
+//------------------------------------------------------------------------------
+class LargeFileTester {
+public:
+  struct Options {
+    std::string url;
+    uint64_t seed = 42;
+    uint64_t size = 1024ull * 1024 * 1024;
+    StreamingOptions streaming;
+  };
+
+  LargeFileTester(Executor &executor, const Options &opts);
+  folly::Future<TestcaseStatus> write();
+  folly::Future<TestcaseStatus> read();
+
+private:
+  Executor &executor;
+  Options options;
+};
+
+}
+
+#endif
@@ -21,26 +21,64 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
  ************************************************************************/
 
-#include <queue>
 #include <iostream>
 #include <rang.hpp>
 #include <XrdCl/XrdClFile.hh>
 #include "Macros.hh"
+#include "Utils.hh"
 #include "TreeBuilder.hh"
-#include "../XrdClExecutor.hh"
+#include "../Executor.hh"
 #include "../HierarchyBuilder.hh"
+#include "utils/CheckpointJournal.hh"
+#include "utils/OperationPipeline.hh"
 #include "utils/ProgressTracker.hh"
 #include "utils/Sealing.hh"
 using namespace eostest;
 
-TreeBuilder::TreeBuilder(const Options &opts, ProgressTracker *track) {
+TreeBuilder::TreeBuilder(Executor &exec, const Options &opts, ProgressTracker *track)
+: executor(exec) {
   options = opts;
   tracker = track;
 }
 
+std::pair<uint64_t, uint64_t> TreeBuilder::shardRange(const Options &opts) {
+  return {
+    opts.files * opts.shard / opts.shards,
+    opts.files * (opts.shard + 1) / opts.shards
+  };
+}
+
+std::string TreeBuilder::journalIdentity() const {
+  return SSTR(options.baseUrl << " seed " << options.seed << " depth " << options.depth << " files " << options.files
+    << " templates " << options.contentTemplates << " checksums " << options.checksumType
+    << " shape " << options.shape.describe() << " manifest shards " << options.manifestShardSize
+    << " binary " << options.binaryManifests
+    << " shard " << options.shard << " of " << options.shards);
+}
+
 folly::Future<TestcaseStatus> TreeBuilder::initialize() {
   std::cout << std::endl;
   std::string description = SSTR(rang::style::bold << rang::fg::magenta << "Construct tree" << rang::style::reset << " :: Depth " << options.depth << " with " << options.files << " files");
+  if(options.shape.describe() != TreeShape().describe()) {
+    description = SSTR(description << ", " << options.shape.describe());
+  }
+
+  if(options.manifestShardSize != 0) {
+    description = SSTR(description << ", MANIFEST shards of " << options.manifestShardSize << " entries");
+  }
+
+  if(options.binaryManifests) {
+    description = SSTR(description << ", binary MANIFESTs");
+  }
+
+  if(options.connections > 1) {
+    description = SSTR(description << " over " << options.connections << " connections, " << placementPolicyToString(options.placement) << " placement");
+  }
+
+  if(options.shards > 1) {
+    std::pair<uint64_t, uint64_t> range = shardRange(options);
+    description = SSTR(description << ", shard " << options.shard << " of " << options.shards << " [" << range.first << ", " << range.second << ")");
+  }
 
   if(tracker) tracker->setDescription(description);
 
@@ -49,11 +87,71 @@ folly::Future<TestcaseStatus> TreeBuilder::initialize() {
   return Sealing::seal(std::move(fut), description);
 }
 
+//------------------------------------------------------------------------------
+// Issue the operation for the given entry once its parent directory exists.
+// Entries whose parent could not be created are skipped, not attempted.
+//
+// With existingDirs, directories are created as with mkdir -p. With
+// existingFiles, a file which fails to be written counts as done anyway, if
+// it turns out to be there with the expected contents - ie written by an
+// earlier run.
+//------------------------------------------------------------------------------
+folly::Future<TestcaseStatus> TreeBuilder::scheduleAfter(std::shared_ptr<folly::SharedPromise<bool>> parent, const HierarchyEntry &entry, const std::string &url, ConnectionBalancer &balancer, bool existingDirs, bool existingFiles) {
+  Executor &exec = executor;
+  ConnectionBalancer *bal = &balancer;
+  bool dir = entry.dir;
+  ContentBuffer contents = entry.contents;
+  std::string path = entry.fullPath;
+
+  // Pick the connection only once the operation is ready to go out, so
+  // that least-loaded placement sees the actual load.
+  auto issue = [&exec, bal, dir, existingDirs, existingFiles, contents, url, path]() {
+    size_t connectionId = bal->pick(chopPath(path));
+
+    folly::Future<TestcaseStatus> fut;
+    if(dir && existingDirs) fut = exec.mkdirs(connectionId, url);
+    else if(dir) fut = exec.mkdir(connectionId, url);
+    else fut = exec.put(connectionId, url, contents);
+
+    if(!dir && existingFiles) {
+      fut = std::move(fut).thenValue([&exec, connectionId, contents, url](TestcaseStatus status) {
+        if(status.ok()) return folly::makeFuture<TestcaseStatus>(std::move(status));
+
+        return exec.get(connectionId, url).thenValue([status, contents](ReadStatus read) {
+          if(read.ok() && read.contents == contents.toString()) return TestcaseStatus();
+          return status;
+        });
+      });
+    }
+
+    return std::move(fut).thenValue([bal, connectionId](TestcaseStatus status) {
+      bal->completed(connectionId, status.getDuration(), status.ok());
+      return status;
+    });
+  };
+
+  if(!parent) return issue();
+
+  return parent->getFuture().thenValue([issue, path](bool parentCreated) {
+    if(!parentCreated) {
+      TestcaseStatus skipped(SSTR("Skipped " << path << ", parent directory could not be created"));
+      skipped.seal(SSTR("Skipped " << path));
+      return folly::makeFuture<TestcaseStatus>(std::move(skipped));
+    }
+
+    return issue();
+  });
+}
+
 void TreeBuilder::main(ThreadAssistant &assistant) {
   TestcaseStatus accumulator;
 
-  const size_t pipelineLength = 5000;
-  std::queue<folly::Future<TestcaseStatus>> queue;
+  ConcurrencyController::Options controllerOpts;
+  controllerOpts.maxWindow = options.maxInflight;
+  controllerOpts.targetP99 = options.targetP99;
+  OperationPipeline pipeline(controllerOpts);
+  ConnectionBalancer balancer(options.connections, options.placement);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
   XrdCl::URL url(options.baseUrl);
 
@@ -62,45 +160,160 @@ void TreeBuilder::main(ThreadAssistant &assistant) {
   opts.seed = options.seed;
   opts.depth = options.depth;
   opts.files = options.files;
+  opts.contentTemplates = options.contentTemplates;
+  opts.checksumType = options.checksumType;
+  opts.shape = options.shape;
+  opts.manifestShardSize = options.manifestShardSize;
+  opts.binaryManifests = options.binaryManifests;
 
   HierarchyBuilder hierarchyBuilder(opts);
+  HierarchyEntry entry;
+
+  // Directories of the current DFS path, each with the outcome of its mkdir.
+  // The base directory isn't ours to create, and is assumed to exist.
+  std::vector<PendingDirectory> ancestors;
+
+  // A shard may begin deep inside the tree, below directories which belong
+  // to earlier shards, and whose mkdir may not have happened yet - or be
+  // racing with ours. Create the directory the shard starts in with mkdir -p,
+  // all directories for that matter, and hold back everything that's outside
+  // of the directories we create ourselves until it exists.
+  bool sharded = options.shards > 1;
+  std::shared_ptr<folly::SharedPromise<bool>> shardBase;
+
+  std::string base = opts.base;
+  while(!base.empty() && base.back() == '/') {
+    base.pop_back();
+  }
+
+  // Every entry is keyed by its index, which directories share with their
+  // MANIFEST. Entries in flight during the interruption may have been done
+  // without being recorded: tolerate running into them once more.
+  CheckpointJournal journal;
+  bool journaled = !options.journal.empty();
+  bool resuming = journaled && options.resume;
+  uint64_t resumed = 0;
 
-  while(true) {
+  if(journaled) {
+    TestcaseStatus opened = journal.open(options.journal, journalIdentity(), 2 * options.files, options.resume);
+    if(!opened.ok()) {
+      promise.setValue(std::move(opened));
+      return;
+    }
+  }
+
+  if(sharded) {
+    std::pair<uint64_t, uint64_t> range = shardRange(options);
+    hierarchyBuilder.setEnd(range.second);
+    if(!hierarchyBuilder.seek(range.first)) {
+      promise.setValue(std::move(accumulator));
+      return;
+    }
+  }
+
+  while(hierarchyBuilder.next(entry)) {
     if(assistant.terminationRequested()) {
       accumulator.addError("Early termination requested");
       break;
     }
 
-    // Pop any ready futures at the head of the queue
-    while(!queue.empty() && (queue.front().isReady() || queue.size() >= pipelineLength)) {
-      accumulator.absorbErrors(std::move(queue.front()).get());
-      queue.pop();
+    std::string parentPath = entry.fullPath.substr(0, entry.fullPath.find_last_of('/'));
+    while(!ancestors.empty() && ancestors.back().path != parentPath) {
+      ancestors.pop_back();
     }
 
-    // Push more futures
-    while(queue.size() <= pipelineLength) {
-      HierarchyEntry entry;
-      if(!hierarchyBuilder.next(entry)) {
-        while(!queue.empty()) {
-          accumulator.absorbErrors(std::move(queue.front()).get());
-          queue.pop();
-        }
-        goto out;
+    uint64_t journalKey = entry.index * 2 + (entry.dir ? 1 : 0);
+    if(resuming && journal.contains(journalKey)) {
+      resumed++;
+
+      if(entry.dir) {
+        std::shared_ptr<folly::SharedPromise<bool>> created = std::make_shared<folly::SharedPromise<bool>>();
+        created->setValue(true);
+        ancestors.emplace_back(PendingDirectory {entry.fullPath, created});
       }
+      else if(tracker) {
+        tracker->addInFlight();
+        tracker->addSuccessful();
+      }
+
+      continue;
+    }
 
-      url.SetPath(entry.fullPath);
+    if(sharded && !shardBase && parentPath != base) {
+      shardBase = std::make_shared<folly::SharedPromise<bool>>();
+      url.SetPath(parentPath);
 
-      if(entry.dir) {
-        queue.push(XrdClExecutor::mkdir(1, url.GetURL()));
+      std::shared_ptr<folly::SharedPromise<bool>> created = shardBase;
+      pipeline.submit([&]() {
+        size_t connectionId = balancer.pick(chopPath(parentPath));
+        ConnectionBalancer *bal = &balancer;
+
+        return executor.mkdirs(connectionId, url.GetURL())
+          .thenValue([created, bal, connectionId](TestcaseStatus status) {
+            bal->completed(connectionId, status.getDuration(), status.ok());
+            created->setValue(status.ok());
+            return status;
+          });
+      });
+    }
+
+    std::shared_ptr<folly::SharedPromise<bool>> parent = shardBase;
+    if(!ancestors.empty()) parent = ancestors.back().created;
+
+    std::shared_ptr<folly::SharedPromise<bool>> created;
+    if(entry.dir) {
+      created = std::make_shared<folly::SharedPromise<bool>>();
+      ancestors.emplace_back(PendingDirectory {entry.fullPath, created});
+    }
+
+    url.SetPath(entry.fullPath);
+
+    pipeline.submit([&]() {
+      folly::Future<TestcaseStatus> fut = scheduleAfter(parent, entry, url.GetURL(), balancer, sharded || resuming, resuming);
+
+      if(journaled) {
+        CheckpointJournal *j = &journal;
+        fut = std::move(fut).thenValue([j, journalKey](TestcaseStatus status) {
+          if(status.ok()) j->record(journalKey);
+          return status;
+        });
       }
-      else {
-        folly::Future<TestcaseStatus> fut = XrdClExecutor::put(1, url.GetURL(), entry.contents);
-        if(tracker) fut = tracker->filterFuture(std::move(fut));
-        queue.push(std::move(fut));
+
+      if(created) {
+        fut = std::move(fut).thenValue([created](TestcaseStatus status) {
+          created->setValue(status.ok());
+          return status;
+        });
       }
+
+      if(tracker && !entry.dir) fut = tracker->filterFuture(std::move(fut));
+      return fut;
+    });
+  }
+
+  accumulator.absorbErrors(pipeline.drain());
+
+  if(resuming) {
+    TestcaseStatus resumedStatus;
+    resumedStatus.seal(SSTR("Resumed from " << options.journal << ": skipped " << resumed << " entries completed by previous runs"));
+    accumulator.addChild(std::move(resumedStatus));
+  }
+
+  if(balancer.getConnections() > 1) {
+    std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+    for(const std::string &line : balancer.report(elapsed)) {
+      TestcaseStatus connection;
+      connection.seal(line);
+      accumulator.addChild(std::move(connection));
     }
   }
 
-out:
+  ConcurrencyController &controller = pipeline.getController();
+  if(controller.isAdaptive()) {
+    TestcaseStatus window;
+    window.seal(controller.describe());
+    accumulator.addChild(std::move(window));
+  }
+
   promise.setValue(std::move(accumulator));
 }
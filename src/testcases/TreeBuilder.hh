@@ -24,14 +24,21 @@
 #ifndef EOSTESTER_TESTCASE_TREE_BUILDER_H
 #define EOSTESTER_TESTCASE_TREE_BUILDER_H
 
+#include <chrono>
 #include <string>
+#include <utility>
 #include <folly/futures/Future.h>
+#include <folly/futures/SharedPromise.h>
 #include "../utils/AssistedThread.hh"
 #include "../utils/TestcaseStatus.hh"
+#include "../utils/ConnectionBalancer.hh"
+#include "../TreeShape.hh"
 
 namespace eostest {
 
 class ProgressTracker;
+class Executor;
+struct HierarchyEntry;
 
 class TreeBuilder {
 public:
@@ -40,13 +47,66 @@ public:
     int32_t seed = 42;
     size_t depth = 10;
     size_t files = 100; // total number of files, including manifests
+    bool contentTemplates = false;
+
+    // Fan-out, file count and size distributions. A depth distribution
+    // overrides depth.
+    TreeShape shape;
+
+    // Record file checksums of this type (adler32, crc32c) in each MANIFEST,
+    // for validation through server-side checksums. Empty means none.
+    std::string checksumType;
+
+    // Shard the MANIFEST of directories with more entries than this, see
+    // HierarchyConstructionOptions. 0 never shards.
+    size_t manifestShardSize = 0;
+
+    // Write MANIFESTs in the binary v2 format. Validation reads either.
+    bool binaryManifests = false;
+
+    // Upper bound on operations in flight. With a non-zero targetP99, the
+    // actual window adapts below this to keep p99 latency under target.
+    size_t maxInflight = 5000;
+    std::chrono::milliseconds targetP99 {0};
+
+    // Spread operations over this many physical connections.
+    size_t connections = 1;
+    PlacementPolicy placement = PlacementPolicy::kRoundRobin;
+
+    // Build only shard number "shard" out of "shards" equal slices of the
+    // walk - the others are left to other processes, possibly on other
+    // hosts, running concurrently.
+    size_t shard = 0;
+    size_t shards = 1;
+
+    // Record completed entries into this local journal. With resume, skip
+    // those recorded by a previous, interrupted run - without contacting
+    // the server about them at all.
+    std::string journal;
+    bool resume = false;
   };
 
-  TreeBuilder(const Options &opts, ProgressTracker *tracker = nullptr);
+  //----------------------------------------------------------------------------
+  // The file indices [first, second) making up the shard of the given
+  // options.
+  //----------------------------------------------------------------------------
+  static std::pair<uint64_t, uint64_t> shardRange(const Options &opts);
+
+  TreeBuilder(Executor &executor, const Options &opts, ProgressTracker *tracker = nullptr);
   folly::Future<TestcaseStatus> initialize();
   void main(ThreadAssistant &assistant);
 
 private:
+  struct PendingDirectory {
+    std::string path;
+    std::shared_ptr<folly::SharedPromise<bool>> created;
+  };
+
+  folly::Future<TestcaseStatus> scheduleAfter(std::shared_ptr<folly::SharedPromise<bool>> parent,
+    const HierarchyEntry &entry, const std::string &url, ConnectionBalancer &balancer, bool existingDirs, bool existingFiles);
+  std::string journalIdentity() const;
+
+  Executor &executor;
   Options options;
   folly::Promise<TestcaseStatus> promise;
   AssistedThread thread;
@@ -0,0 +1,377 @@
+// ----------------------------------------------------------------------
+// File: TreeDestroyer.cc
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include <algorithm>
+#include <iostream>
+#include <rang.hpp>
+#include "Macros.hh"
+#include "Utils.hh"
+#include "TreeDestroyer.hh"
+#include "../Executor.hh"
+#include "../Manifest.hh"
+#include "utils/OperationPipeline.hh"
+#include "utils/ProgressTracker.hh"
+#include "utils/Sealing.hh"
+using namespace eostest;
+
+TreeDestroyer::TreeDestroyer(Executor &exec, const Options &opts, ProgressTracker *track)
+: executor(exec), options(opts), tracker(track) {
+  while(!options.url.empty() && options.url.back() == '/') {
+    options.url.pop_back();
+  }
+}
+
+folly::Future<TestcaseStatus> TreeDestroyer::initialize() {
+  std::cout << std::endl;
+  std::string description = SSTR(rang::style::bold << rang::fg::magenta << "Destroy tree" << rang::style::reset << " :: " << options.url);
+  if(options.connections > 1) {
+    description = SSTR(description << " over " << options.connections << " connections, " << placementPolicyToString(options.placement) << " placement");
+  }
+
+  if(tracker) tracker->setDescription(description);
+
+  folly::Future<TestcaseStatus> fut = promise.getFuture();
+  thread.reset(&TreeDestroyer::main, this);
+  return Sealing::seal(std::move(fut), description);
+}
+
+//------------------------------------------------------------------------------
+// Names of the files and subdirectories of the given directory: from its
+// MANIFEST if possible, so a single small read covers it - or one per shard,
+// for huge directories - otherwise from the listing.
+//------------------------------------------------------------------------------
+folly::Future<TreeDestroyer::Contents> TreeDestroyer::listContents(size_t connectionId, const std::string &url) {
+  Executor &exec = executor;
+
+  folly::Future<Contents> fut = exec.get(connectionId, SSTR(url << "/MANIFEST"))
+    .thenValue([&exec, connectionId, url](ReadStatus read) {
+      Manifest manifest;
+      if(!read.ok() || !manifest.parse(read.contents)) {
+        return listDirectory(exec, connectionId, url);
+      }
+
+      if(!manifest.isSharded()) {
+        return folly::makeFuture<Contents>(contentsOfManifest(manifest));
+      }
+
+      std::vector<folly::Future<ReadStatus>> shards;
+      for(const std::string &shard : manifest.getShards()) {
+        shards.emplace_back(exec.get(connectionId, SSTR(url << "/" << shard)));
+      }
+
+      return folly::collect(shards).thenValue([&exec, connectionId, url, manifest](std::vector<ReadStatus> reads) mutable {
+        for(const ReadStatus &read : reads) {
+          Manifest shard;
+          if(!read.ok() || !shard.parse(read.contents) || !manifest.absorbShard(shard)) {
+            return listDirectory(exec, connectionId, url);
+          }
+        }
+
+        return folly::makeFuture<Contents>(contentsOfManifest(manifest));
+      });
+    });
+
+  return Sealing::seal(std::move(fut), SSTR("List contents of '" << url << "'"));
+}
+
+folly::Future<TreeDestroyer::Contents> TreeDestroyer::listDirectory(Executor &exec, size_t connectionId, const std::string &url) {
+  return exec.dirList(connectionId, url).thenValue([](DirListStatus list) {
+    Contents contents;
+    if(!contents.absorbErrors(list)) {
+      for(size_t i = 0; i < list.contents->GetSize(); i++) {
+        XrdCl::DirectoryList::ListEntry *entry = list.contents->At(i);
+
+        if(entry->GetStatInfo()->TestFlags(XrdCl::StatInfo::IsDir)) {
+          contents.subdirs.emplace_back(entry->GetName());
+        }
+        else {
+          contents.files.emplace_back(entry->GetName());
+        }
+      }
+    }
+
+    return contents;
+  });
+}
+
+TreeDestroyer::Contents TreeDestroyer::contentsOfManifest(Manifest &manifest) {
+  Contents contents;
+  contents.files.assign(manifest.getFiles().begin(), manifest.getFiles().end());
+  contents.subdirs.assign(manifest.getDirectories().begin(), manifest.getDirectories().end());
+
+  contents.files.emplace_back("MANIFEST");
+  contents.files.insert(contents.files.end(), manifest.getShards().begin(), manifest.getShards().end());
+  contents.fromManifest = true;
+  return contents;
+}
+
+//------------------------------------------------------------------------------
+// Put the directory on the stack, and have its contents requested right
+// away, so they are likely there by the time it's expanded.
+//------------------------------------------------------------------------------
+void TreeDestroyer::requestContents(std::shared_ptr<Directory> directory, OperationPipeline &pipeline, ConnectionBalancer &balancer) {
+  std::shared_ptr<folly::Promise<Contents>> listed = std::make_shared<folly::Promise<Contents>>();
+  stack.emplace_back(PendingExpansion {directory, listed->getFuture()});
+
+  ConnectionBalancer *bal = &balancer;
+  pipeline.submit([&]() {
+    size_t connectionId = bal->pick(directory->url);
+
+    return listContents(connectionId, directory->url).thenValue([directory, listed, bal, connectionId](Contents contents) {
+      bal->completed(connectionId, contents.getDuration(), contents.ok());
+
+      TestcaseStatus status = contents;
+      if(!status.ok() && directory->parent && directory->parent->fromManifest) {
+        // Maybe never created - up to the parent to find out
+        directory->listingError = status;
+        status = TestcaseStatus();
+        status.seal(contents.getDescription(), contents.getDuration());
+      }
+
+      listed->setValue(std::move(contents));
+      return status;
+    });
+  });
+}
+
+//------------------------------------------------------------------------------
+// One of the directory's entries is gone - or couldn't be removed, in which
+// case neither can the directory, nor any of its ancestors.
+//------------------------------------------------------------------------------
+void TreeDestroyer::childRemoved(std::shared_ptr<Directory> directory, bool ok) {
+  if(!ok) directory->failed = true;
+  if(--directory->remaining != 0) return;
+
+  std::lock_guard<std::mutex> lock(readyMtx);
+  ready.emplace_back(std::move(directory));
+  readyCv.notify_one();
+}
+
+//------------------------------------------------------------------------------
+// An entry of the directory is done with. If it couldn't be removed, but only
+// the MANIFEST says it exists, set the failure aside until a fresh listing
+// confirms it - returning what the pipeline should report right now.
+//------------------------------------------------------------------------------
+TestcaseStatus TreeDestroyer::entryDone(std::shared_ptr<Directory> directory, const std::string &name, TestcaseStatus status) {
+  if(!status.ok() && directory->fromManifest) {
+    TestcaseStatus provisional;
+    provisional.seal(status.getDescription(), status.getDuration());
+
+    {
+      std::lock_guard<std::mutex> lock(directory->unconfirmedMtx);
+      directory->unconfirmed.emplace_back(name, std::move(status));
+    }
+
+    childRemoved(directory, true);
+    return provisional;
+  }
+
+  childRemoved(directory, status.ok());
+  return status;
+}
+
+//------------------------------------------------------------------------------
+// Everything in the directory is done with, but some entries named by its
+// MANIFEST couldn't be removed: list it, and only those still there are
+// failures. The directory is then ready again, for rmdir or to fail its
+// parent.
+//------------------------------------------------------------------------------
+void TreeDestroyer::confirmFailures(std::shared_ptr<Directory> directory, OperationPipeline &pipeline, ConnectionBalancer &balancer) {
+  std::vector<std::pair<std::string, TestcaseStatus>> unconfirmed;
+  {
+    std::lock_guard<std::mutex> lock(directory->unconfirmedMtx);
+    unconfirmed.swap(directory->unconfirmed);
+  }
+
+  directory->fromManifest = false;
+  directory->remaining++;
+
+  ConnectionBalancer *bal = &balancer;
+  pipeline.submit([&]() {
+    size_t connectionId = bal->pick(directory->url);
+
+    folly::Future<Contents> listed = Sealing::seal(listDirectory(executor, connectionId, directory->url),
+      SSTR("List leftovers of '" << directory->url << "'"));
+
+    return std::move(listed).thenValue([this, directory, unconfirmed, bal, connectionId](Contents contents) {
+      bal->completed(connectionId, contents.getDuration(), contents.ok());
+
+      TestcaseStatus status;
+      if(!status.absorbErrors(contents)) {
+        std::vector<std::string> &names = contents.files;
+        names.insert(names.end(), contents.subdirs.begin(), contents.subdirs.end());
+        std::sort(names.begin(), names.end());
+
+        for(const auto &entry : unconfirmed) {
+          if(std::binary_search(names.begin(), names.end(), entry.first)) {
+            status.absorbErrors(entry.second);
+          }
+        }
+      }
+
+      status.seal(contents.getDescription(), contents.getDuration());
+      childRemoved(directory, status.ok());
+      return status;
+    });
+  });
+}
+
+void TreeDestroyer::main(ThreadAssistant &assistant) {
+  TestcaseStatus accumulator;
+
+  ConcurrencyController::Options controllerOpts;
+  controllerOpts.maxWindow = options.maxInflight;
+  controllerOpts.targetP99 = options.targetP99;
+  OperationPipeline pipeline(controllerOpts);
+  ConnectionBalancer balancer(options.connections, options.placement);
+  ConnectionBalancer *bal = &balancer;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  std::shared_ptr<Directory> root = std::make_shared<Directory>();
+  root->url = options.url;
+  requestContents(root, pipeline, balancer);
+
+  while(true) {
+    if(assistant.terminationRequested()) {
+      accumulator.addError("Early termination requested");
+      break;
+    }
+
+    // Emptied directories go first, so that finished subtrees don't linger
+    // in memory
+    std::shared_ptr<Directory> emptied;
+    {
+      std::unique_lock<std::mutex> lock(readyMtx);
+      if(stack.empty()) {
+        readyCv.wait_for(lock, std::chrono::milliseconds(100), [this]() { return !ready.empty(); });
+      }
+
+      if(!ready.empty()) {
+        emptied = std::move(ready.front());
+        ready.pop_front();
+      }
+    }
+
+    if(emptied) {
+      bool unconfirmed;
+      {
+        std::lock_guard<std::mutex> lock(emptied->unconfirmedMtx);
+        unconfirmed = !emptied->unconfirmed.empty();
+      }
+
+      if(unconfirmed) {
+        confirmFailures(emptied, pipeline, balancer);
+        continue;
+      }
+    }
+
+    if(emptied == root) break;
+
+    if(emptied && emptied->failed) {
+      TestcaseStatus status = emptied->listingError;
+      if(status.ok()) status.addError(SSTR("Could not remove everything in '" << emptied->url << "'"));
+      entryDone(emptied->parent, emptied->name, std::move(status));
+      continue;
+    }
+
+    if(emptied) {
+      pipeline.submit([&]() {
+        size_t connectionId = bal->pick(emptied->parent->url);
+
+        folly::Future<TestcaseStatus> fut = executor.rmdir(connectionId, emptied->url)
+          .thenValue([this, emptied, bal, connectionId](TestcaseStatus status) {
+            bal->completed(connectionId, status.getDuration(), status.ok());
+            if(status.ok()) directoriesRemoved++;
+            return entryDone(emptied->parent, emptied->name, std::move(status));
+          });
+
+        if(tracker) fut = tracker->filterFuture(std::move(fut));
+        return fut;
+      });
+
+      continue;
+    }
+
+    if(stack.empty()) continue;
+
+    // Expand the deepest directory
+    PendingExpansion expansion = std::move(stack.back());
+    stack.pop_back();
+
+    std::shared_ptr<Directory> directory = expansion.directory;
+    Contents contents = std::move(expansion.contents).get();
+    directory->remaining += contents.files.size() + contents.subdirs.size();
+    directory->fromManifest = contents.fromManifest;
+
+    for(const std::string &file : contents.files) {
+      std::string url = SSTR(directory->url << "/" << file);
+
+      pipeline.submit([&]() {
+        size_t connectionId = bal->pick(directory->url);
+
+        folly::Future<TestcaseStatus> fut = executor.rm(connectionId, url)
+          .thenValue([this, directory, file, bal, connectionId](TestcaseStatus status) {
+            bal->completed(connectionId, status.getDuration(), status.ok());
+            if(status.ok()) filesRemoved++;
+            return entryDone(directory, file, std::move(status));
+          });
+
+        if(tracker) fut = tracker->filterFuture(std::move(fut));
+        return fut;
+      });
+    }
+
+    for(const std::string &subdir : contents.subdirs) {
+      std::shared_ptr<Directory> child = std::make_shared<Directory>();
+      child->url = SSTR(directory->url << "/" << subdir);
+      child->name = subdir;
+      child->parent = directory;
+      requestContents(child, pipeline, balancer);
+    }
+
+    // Contents are known now. A failed listing is already reported by the
+    // pipeline, only keep the directory from being removed.
+    childRemoved(directory, contents.ok());
+  }
+
+  accumulator.absorbErrors(pipeline.drain());
+
+  TestcaseStatus summary;
+  summary.seal(SSTR("Removed " << filesRemoved << " files and " << directoriesRemoved << " directories"));
+  accumulator.addChild(std::move(summary));
+
+  if(balancer.getConnections() > 1) {
+    std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+    for(const std::string &line : balancer.report(elapsed)) {
+      TestcaseStatus connection;
+      connection.seal(line);
+      accumulator.addChild(std::move(connection));
+    }
+  }
+
+  // Callbacks hold on to their directories, and those to their parents
+  stack.clear();
+  ready.clear();
+
+  promise.setValue(std::move(accumulator));
+}
@@ -0,0 +1,141 @@
+// ----------------------------------------------------------------------
+// File: TreeDestroyer.hh
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef EOSTESTER_TESTCASE_TREE_DESTROYER_H
+#define EOSTESTER_TESTCASE_TREE_DESTROYER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <folly/futures/Future.h>
+#include "../utils/AssistedThread.hh"
+#include "../utils/TestcaseStatus.hh"
+#include "../utils/ConnectionBalancer.hh"
+
+namespace eostest {
+
+class ProgressTracker;
+class Executor;
+class OperationPipeline;
+class Manifest;
+
+//------------------------------------------------------------------------------
+// Removes everything below the given URL, bottom-up: every file is rm'ed,
+// and every directory rmdir'ed once all of its contents are gone. The base
+// directory itself is kept, as the builder doesn't create it either.
+//
+// The contents of a directory are taken from its MANIFEST and any shards of
+// it, or from a directory listing if they're missing. In a partially built
+// tree, a MANIFEST may also name entries which were never created: failing
+// to remove those is only provisional, and checked against a fresh listing
+// of the directory once everything else in it is done.
+//
+// Directories are expanded depth-first, with their contents requested as
+// soon as they are discovered. rm, rmdir and MANIFEST reads all share one
+// window of operations in flight.
+//------------------------------------------------------------------------------
+class TreeDestroyer {
+public:
+  struct Options {
+    std::string url;
+    size_t maxInflight = 5000;
+
+    // Same adaptive window as the builder: with a non-zero target, operations
+    // in flight are adjusted, up to maxInflight, to keep p99 latency below it.
+    std::chrono::milliseconds targetP99 {0};
+
+    size_t connections = 1;
+    PlacementPolicy placement = PlacementPolicy::kRoundRobin;
+  };
+
+  TreeDestroyer(Executor &executor, const Options &opts, ProgressTracker *tracker = nullptr);
+  folly::Future<TestcaseStatus> initialize();
+  void main(ThreadAssistant &assistant);
+
+private:
+  struct Directory {
+    std::string url;
+    std::string name;
+    std::shared_ptr<Directory> parent;
+
+    // Contents not removed yet, plus one until they're known
+    std::atomic<int64_t> remaining {1};
+    std::atomic<bool> failed {false};
+
+    // Contents came from the MANIFEST, which may name entries never created
+    bool fromManifest = false;
+
+    // Why listing the contents failed, if it did
+    TestcaseStatus listingError;
+
+    // Entries named by the MANIFEST which couldn't be removed, and why -
+    // failures only if a fresh listing still shows them.
+    std::mutex unconfirmedMtx;
+    std::vector<std::pair<std::string, TestcaseStatus>> unconfirmed;
+  };
+
+  struct Contents : public TestcaseStatus {
+    using TestcaseStatus::TestcaseStatus;
+    std::vector<std::string> files;
+    std::vector<std::string> subdirs;
+    bool fromManifest = false;
+  };
+
+  struct PendingExpansion {
+    std::shared_ptr<Directory> directory;
+    folly::Future<Contents> contents;
+  };
+
+  folly::Future<Contents> listContents(size_t connectionId, const std::string &url);
+  static folly::Future<Contents> listDirectory(Executor &exec, size_t connectionId, const std::string &url);
+  static Contents contentsOfManifest(Manifest &manifest);
+  void requestContents(std::shared_ptr<Directory> directory, OperationPipeline &pipeline, ConnectionBalancer &balancer);
+  void childRemoved(std::shared_ptr<Directory> directory, bool ok);
+  TestcaseStatus entryDone(std::shared_ptr<Directory> directory, const std::string &name, TestcaseStatus status);
+  void confirmFailures(std::shared_ptr<Directory> directory, OperationPipeline &pipeline, ConnectionBalancer &balancer);
+
+  Executor &executor;
+  Options options;
+  folly::Promise<TestcaseStatus> promise;
+  AssistedThread thread;
+  ProgressTracker *tracker = nullptr;
+
+  std::vector<PendingExpansion> stack;
+
+  // Directories whose contents are all gone, ready for rmdir
+  std::mutex readyMtx;
+  std::condition_variable readyCv;
+  std::deque<std::shared_ptr<Directory>> ready;
+
+  std::atomic<uint64_t> filesRemoved {0};
+  std::atomic<uint64_t> directoriesRemoved {0};
+};
+
+}
+
+#endif
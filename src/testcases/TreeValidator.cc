@@ -25,19 +25,32 @@
 #include "utils/ProgressTracker.hh"
 #include "utils/Sealing.hh"
 #include "../Manifest.hh"
-#include "../XrdClExecutor.hh"
+#include "../BinaryManifestView.hh"
+#include "../Executor.hh"
 #include "../SelfCheckedFile.hh"
+#include "../HashCalculator.hh"
 #include "Macros.hh"
 #include "Utils.hh"
 
 #include <rang.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <functional>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 
 using namespace eostest;
 
-TreeValidator::TreeValidator(const std::string &base, ProgressTracker *track) : url(base) {
+TreeValidator::TreeValidator(Executor &exec, const Options &opts, ProgressTracker *track)
+: executor(exec), url(opts.url), nworkers(std::max<size_t>(1, opts.workers)),
+  lookahead(std::max<size_t>(1, opts.lookahead)), fileBatch(std::max<size_t>(1, opts.maxInflight)),
+  metadataOnly(opts.metadataOnly),
+  serverChecksums(opts.serverChecksums),
+  sampleRate(std::max(0.0, std::min(1.0, opts.sampleRate))), sampleSeed(opts.sampleSeed),
+  sampleDirectories(opts.sampleDirectories),
+  budget(opts.maxInflight) {
   while(!url.empty() && url.back() == '/') {
     url.pop_back();
   }
@@ -45,8 +58,31 @@ TreeValidator::TreeValidator(const std::string &base, ProgressTracker *track) :
   tracker = track;
 }
 
+static TreeValidator::Options optionsFromUrl(const std::string &url) {
+  TreeValidator::Options opts;
+  opts.url = url;
+  return opts;
+}
+
+TreeValidator::TreeValidator(Executor &exec, const std::string &base, ProgressTracker *track)
+: TreeValidator(exec, optionsFromUrl(base), track) { }
+
 folly::Future<TestcaseStatus> TreeValidator::initialize() {
   std::string description = SSTR(rang::style::bold << rang::fg::magenta << "Validate tree" << rang::style::reset << " :: " << url);
+  if(metadataOnly) {
+    description = SSTR(description << " (metadata only)");
+  }
+  else if(serverChecksums) {
+    description = SSTR(description << " (server-side checksums)");
+  }
+
+  if(nworkers > 1) {
+    description = SSTR(description << " with " << nworkers << " workers");
+  }
+
+  if(sampleRate < 1.0) {
+    description = SSTR(description << ", sampling " << sampleRate * 100 << "% of " << (sampleDirectories ? "files and directories" : "files") << " with seed " << sampleSeed);
+  }
 
   if(tracker) tracker->setDescription(description);
 
@@ -64,7 +100,13 @@ ManifestHolder parseManifest(ReadStatus status, std::string path) {
   }
 
   if(!holder.manifest.parse(status.contents)) {
-    holder.addError(SSTR("Could not parse contents for " << path << ": " << status.contents));
+    if(BinaryManifestView::isBinary(status.contents)) {
+      holder.addError(SSTR("Could not parse contents for " << path << ": corrupt binary MANIFEST of " << status.contents.size() << " bytes"));
+    }
+    else {
+      holder.addError(SSTR("Could not parse contents for " << path << ": " << status.contents));
+    }
+
     return holder;
   }
 
@@ -90,30 +132,153 @@ TestcaseStatus parseFile(ReadStatus status, std::string path) {
   return accu;
 }
 
-folly::Future<ManifestHolder> fetchManifest(size_t connectionId, std::string path) {
-  folly::Future<ReadStatus> readStatus = XrdClExecutor::get(connectionId, path);
+folly::Future<ManifestHolder> fetchManifest(Executor &executor, AsyncBudget &budget, size_t connectionId, std::string path) {
+  folly::Future<ReadStatus> readStatus = budget.run([&executor, connectionId, path]() {
+    return executor.get(connectionId, path);
+  });
+
   return std::move(readStatus).thenValue(std::bind(parseManifest, std::placeholders::_1, XrdCl::URL(path).GetPath()));
 }
 
-ManifestHolder validateManifest(std::tuple<ManifestHolder, DirListStatus> tup) {
-  ManifestHolder manifestHolder = std::move(std::get<0>(tup));
-  DirListStatus dirList = std::move(std::get<1>(tup));
+ManifestHolder mergeShards(ManifestHolder index, std::vector<ManifestHolder> shards) {
+  for(size_t i = 0; i < shards.size(); i++) {
+    if(!shards[i].ok()) {
+      index.absorbErrors(shards[i]);
+      continue;
+    }
 
-  if(!manifestHolder.ok() || !dirList.ok()) return manifestHolder;
+    if(!index.manifest.absorbShard(shards[i].manifest)) {
+      index.addError(SSTR(shards[i].manifest.getFilename() << " lists an entry already present in another shard of " << index.manifest.getFilename()));
+    }
+  }
+
+  return index;
+}
+
+//------------------------------------------------------------------------------
+// A sharded MANIFEST is only an index: fetch all of its shards at once, and
+// merge them into the index - from then on, it looks just like an unsharded
+// MANIFEST of the same directory.
+//------------------------------------------------------------------------------
+folly::Future<ManifestHolder> TreeValidator::fetchShards(const std::string &path, ManifestHolder holder) {
+  if(!holder.ok() || !holder.manifest.isSharded()) {
+    return folly::makeFuture<ManifestHolder>(std::move(holder));
+  }
+
+  std::vector<folly::Future<ManifestHolder>> shards;
+  for(const std::string &shard : holder.manifest.getShards()) {
+    shards.emplace_back(fetchManifest(executor, budget, getConnectionId(), SSTR(path << "/" << shard)));
+  }
+
+  return folly::collect(shards)
+    .thenValue(std::bind(mergeShards, std::move(holder), std::placeholders::_1));
+}
+
+void crossCheckManifest(ManifestHolder &manifestHolder, const DirListStatus &dirList) {
+  if(!manifestHolder.ok() || !dirList.ok()) return;
 
   // Manifest is OK. Do manifest contents and dirList match?
   manifestHolder.absorbChildIfError(
     manifestHolder.manifest.crossCheckDirlist(*dirList.contents)
   );
+}
 
+ManifestHolder validateManifest(std::tuple<ManifestHolder, DirListStatus> tup) {
+  ManifestHolder manifestHolder = std::move(std::get<0>(tup));
+  crossCheckManifest(manifestHolder, std::get<1>(tup));
+  return manifestHolder;
+}
+
+//------------------------------------------------------------------------------
+// Metadata-only counterpart of validateContainedFiles: rather than reading
+// each file, compare the size in the dirlist against the one recorded in the
+// MANIFEST. MANIFESTs from before sizes were recorded only allow checking
+// that it's a size a self-checked file of that name could have.
+//------------------------------------------------------------------------------
+ManifestHolder TreeValidator::validateFileSizes(std::tuple<ManifestHolder, DirListStatus> tup) {
+  ManifestHolder manifestHolder = std::move(std::get<0>(tup));
+  const DirListStatus &dirList = std::get<1>(tup);
+
+  crossCheckManifest(manifestHolder, dirList);
+  if(!manifestHolder.ok() || !dirList.ok()) return manifestHolder;
+
+  std::string directory = chopPath(manifestHolder.manifest.getFilename());
+  TestcaseStatus sizes;
+
+  for(size_t i = 0; i < dirList.contents->GetSize(); i++) {
+    XrdCl::DirectoryList::ListEntry *entry = dirList.contents->At(i);
+    if(entry->GetStatInfo()->TestFlags(XrdCl::StatInfo::IsDir) || manifestHolder.manifest.isManifestFile(entry->GetName())) continue;
+
+    std::string path = SSTR(directory << "/" << entry->GetName());
+    filesSeen++;
+    if(!isSampled(path)) continue;
+    filesSampled++;
+
+    uint64_t size = entry->GetStatInfo()->GetSize();
+    uint64_t expected = 0;
+    bool correct = true;
+
+    if(manifestHolder.manifest.getSize(entry->GetName(), expected)) {
+      if(size != expected) {
+        correct = false;
+        sizes.addError(SSTR("Size of " << path << " is " << size << " bytes, MANIFEST records " << expected));
+      }
+    }
+    else if(!SelfCheckedFile::isPlausibleSize(path, size)) {
+      correct = false;
+      sizes.addError(SSTR("Size of " << path << " is " << size << " bytes, impossible for a self-checked-file"));
+    }
+
+    if(tracker) {
+      tracker->addInFlight();
+      correct ? tracker->addSuccessful() : tracker->addFailed();
+    }
+  }
+
+  sizes.seal(SSTR("Check file sizes in " << directory));
+  manifestHolder.absorbChildIfError(std::move(sizes));
   return manifestHolder;
 }
 
 folly::Future<TestcaseStatus> TreeValidator::validateSingleFile(size_t connectionId, const std::string &path) {
-  folly::Future<ReadStatus> readStatus = XrdClExecutor::get(connectionId, path);
+  Executor &exec = executor;
+  folly::Future<ReadStatus> readStatus = budget.run([&exec, connectionId, path]() {
+    return exec.get(connectionId, path);
+  });
+
   return std::move(readStatus).thenValue(std::bind(parseFile, std::placeholders::_1, path));
 }
 
+TestcaseStatus compareChecksum(ChecksumStatus status, std::string path, std::string expectedType, std::string expectedValue) {
+  if(!status.ok()) {
+    return status;
+  }
+
+  TestcaseStatus accu;
+  if(status.type != expectedType || status.value != expectedValue) {
+    accu.addError(SSTR("Checksum mismatch for " << path << ": expected " << expectedType << ":" << expectedValue
+      << " as recorded in MANIFEST, server reports " << status.type << ":" << status.value));
+  }
+
+  accu.seal(SSTR("Validate server-side checksum of " << path));
+  return accu;
+}
+
+folly::Future<TestcaseStatus> TreeValidator::validateChecksum(size_t connectionId, const std::string &path, const std::string &expected) {
+  size_t colon = expected.find(':');
+  if(colon == std::string::npos) {
+    return folly::makeFuture<TestcaseStatus>(TestcaseStatus(SSTR("Malformed checksum in MANIFEST for " << path << ": " << expected)));
+  }
+
+  std::string type = expected.substr(0, colon);
+  Executor &exec = executor;
+  folly::Future<ChecksumStatus> checksumStatus = budget.run([&exec, connectionId, path, type]() {
+    return exec.checksum(connectionId, path, type);
+  });
+
+  return std::move(checksumStatus).thenValue(std::bind(compareChecksum, std::placeholders::_1, path, type, expected.substr(colon + 1)));
+}
+
 ManifestHolder combineErrors(ManifestHolder &holder, std::vector<TestcaseStatus> errors) {
   for(size_t i = 0; i < errors.size(); i++) {
     holder.absorbChildIfError(std::move(errors[i]));
@@ -122,80 +287,316 @@ ManifestHolder combineErrors(ManifestHolder &holder, std::vector<TestcaseStatus>
   return holder;
 }
 
+//------------------------------------------------------------------------------
+// Validate the files of the MANIFEST a batch at a time: the next batch is only
+// issued once the previous one is done, so a directory never holds more than
+// fileBatch outstanding reads, however many files it has.
+//------------------------------------------------------------------------------
 folly::Future<ManifestHolder> TreeValidator::validateContainedFiles(size_t connectionId, ManifestHolder holder, std::string path) {
   std::vector<folly::Future<TestcaseStatus>> accus;
 
+  std::string directory = chopPath(holder.manifest.getFilename());
   std::string file;
-  while(holder.manifest.popFile(file)) {
-    folly::Future<TestcaseStatus> st = validateSingleFile(connectionId, SSTR(path << "/" << file));
+  std::string checksum;
+  while(accus.size() < fileBatch && holder.manifest.popFile(file)) {
+    filesSeen++;
+    if(!isSampled(SSTR(directory << "/" << file))) continue;
+    filesSampled++;
+
+    folly::Future<TestcaseStatus> st = (serverChecksums && holder.manifest.getChecksum(file, checksum)) ?
+      validateChecksum(connectionId, SSTR(path << "/" << file), checksum) :
+      validateSingleFile(connectionId, SSTR(path << "/" << file));
+
     if(tracker) st = tracker->filterFuture(std::move(st));
     accus.emplace_back(std::move(st));
   }
 
+  if(accus.empty()) {
+    return folly::makeFuture<ManifestHolder>(std::move(holder));
+  }
+
   return folly::collect(accus)
-    .thenValue(std::bind(combineErrors, std::move(holder), std::placeholders::_1));
+    .thenValue(std::bind(combineErrors, std::move(holder), std::placeholders::_1))
+    .thenValue(std::bind(&TreeValidator::validateContainedFiles, this, connectionId, std::placeholders::_1, path));
 }
 
 folly::Future<ManifestHolder> TreeValidator::validateSingleDirectory(size_t connectionId, const std::string &path) {
-  folly::Future<DirListStatus> dirList = XrdClExecutor::dirList(connectionId, path);
-  folly::Future<ManifestHolder> holder = fetchManifest(connectionId, SSTR(path << "/MANIFEST"));
+  Executor &exec = executor;
+  folly::Future<DirListStatus> dirList = budget.run([&exec, connectionId, path]() {
+    return exec.dirList(connectionId, path);
+  });
+
+  folly::Future<ManifestHolder> holder = fetchManifest(executor, budget, connectionId, SSTR(path << "/MANIFEST"))
+    .thenValue(std::bind(&TreeValidator::fetchShards, this, path, std::placeholders::_1));
+
+  if(metadataOnly) {
+    return folly::collect(holder, dirList)
+      .thenValue(std::bind(&TreeValidator::validateFileSizes, this, std::placeholders::_1));
+  }
 
   return folly::collect(holder, dirList)
     .thenValue(validateManifest)
     .thenValue(std::bind(&TreeValidator::validateContainedFiles, this, connectionId, std::placeholders::_1, path));
 }
 
+bool TreeValidator::isSampled(const std::string &path) const {
+  if(sampleRate >= 1.0) return true;
+
+  // Top 53 bits of the hash, as a uniform double in [0, 1)
+  double position = (HashCalculator::hash64(path, sampleSeed) >> 11) * (1.0 / (1ULL << 53));
+  return position < sampleRate;
+}
+
+//------------------------------------------------------------------------------
+// How much of the tree this run looked at, and how many runs with distinct
+// seeds it takes until every file has been validated at least once with 99%
+// probability.
+//------------------------------------------------------------------------------
+TestcaseStatus TreeValidator::coverageReport() {
+  auto percent = [](uint64_t part, uint64_t whole) {
+    return whole == 0 ? 100.0 : (100.0 * part) / whole;
+  };
+
+  std::ostringstream ss;
+  ss << std::fixed << std::setprecision(1);
+  ss << "Sampled " << filesSampled << " of " << filesSeen << " files (" << percent(filesSampled, filesSeen) << "%)";
+
+  if(sampleDirectories) {
+    ss << ", " << directoriesSampled << " of " << directoriesSeen << " directories (" << percent(directoriesSampled, directoriesSeen) << "%)";
+  }
+
+  if(sampleRate > 0) {
+    // 1 - (1 - rate)^runs >= 0.99; directory sampling compounds per level,
+    // so this is only exact for files.
+    size_t runs = (sampleRate >= 1.0) ? 1 : std::ceil(std::log(0.01) / std::log(1.0 - sampleRate));
+    ss << " - " << runs << " runs with distinct seeds cover 99% of files";
+    if(sampleDirectories) ss << " in sampled directories";
+  }
+
+  TestcaseStatus coverage;
+  coverage.seal(ss.str());
+  return coverage;
+}
+
 eostest::TreeLevel TreeValidator::insertLevel(ManifestHolder manifest) {
   TreeLevel level(std::move(manifest));
+  level.directory = chopPath(level.manifest.manifest.getFilename());
 
-  XrdCl::URL base(url);
+  size_t subdirs = level.manifest.manifest.subdirCount();
+  directoriesSeen += subdirs;
+  pendingDirectories += subdirs;
 
+  prefetch(level);
+  return level;
+}
+
+//------------------------------------------------------------------------------
+// Next subdirectory of this level to request, from the front or the back, as
+// a full URL. Those left out by sampling are skipped, and no longer pending.
+//------------------------------------------------------------------------------
+bool TreeValidator::takeChild(TreeLevel &level, bool back, std::string &out) {
   std::string subdir;
-  while(level.manifest.manifest.popSubdir(subdir)) {
-    base.SetPath(SSTR(chopPath(level.manifest.manifest.getFilename()) << "/" << subdir));
-    level.unexpandedChildren.push_back(validateSingleDirectory(getConnectionId(), base.GetURL()));
+  Manifest &manifest = level.manifest.manifest;
+
+  while(back ? manifest.popLastSubdir(subdir) : manifest.popSubdir(subdir)) {
+    std::string path = SSTR(level.directory << "/" << subdir);
+
+    if(sampleDirectories && !isSampled(path)) {
+      if(--pendingDirectories == 0) {
+        std::lock_guard<std::mutex> lock(idleMtx);
+        idleCv.notify_all();
+      }
+
+      continue;
+    }
+
+    directoriesSampled++;
+    XrdCl::URL base(url);
+    base.SetPath(path);
+    out = base.GetURL();
+    return true;
   }
 
-  return level;
+  return false;
+}
+
+//------------------------------------------------------------------------------
+// Request subdirectories of this level until lookahead of them are in flight.
+// Only for a level not pushed onto a stack yet, which needs no lock.
+//------------------------------------------------------------------------------
+void TreeValidator::prefetch(TreeLevel &level) {
+  std::string child;
+  while(level.prefetchedChildren.size() < lookahead && takeChild(level, false, child)) {
+    level.prefetchedChildren.push_back(validateSingleDirectory(getConnectionId(), child));
+  }
 }
 
 void TreeValidator::main(ThreadAssistant &assistant) {
+  stacks.clear();
+  for(size_t i = 0; i < nworkers; i++) {
+    stacks.emplace_back(new WorkerStack());
+  }
+
+  std::vector<TestcaseStatus> accs(nworkers);
+  pendingDirectories = 1;
+  expand(0, validateSingleDirectory(getConnectionId(), url), accs[0]);
+
+  std::vector<AssistedThread> workers;
+  workers.reserve(nworkers);
+
+  for(size_t i = 0; i < nworkers; i++) {
+    workers.emplace_back(&TreeValidator::worker, this, i, std::ref(accs[i]));
+    assistant.propagateTerminationSignal(workers.back());
+  }
+
   TestcaseStatus acc;
+  for(size_t i = 0; i < nworkers; i++) {
+    workers[i].blockUntilThreadJoins();
+    acc.absorbErrors(accs[i]);
+  }
 
-  AssistedThread worker1(&TreeValidator::worker, this, url, std::ref(acc));
-  assistant.propagateTerminationSignal(worker1);
-  worker1.blockUntilThreadJoins();
+  // The workers are about to go away, don't forward termination to them.
+  assistant.dropCallbacks();
+
+  if(sampleRate < 1.0) {
+    acc.addChild(coverageReport());
+  }
 
   promise.setValue(std::move(acc));
 }
 
-void TreeValidator::worker(std::string url, TestcaseStatus &acc, ThreadAssistant &assistant) {
-  std::deque<TreeLevel> stack;
-  stack.emplace_back(insertLevel(validateSingleDirectory(getConnectionId(), url).get()));
-  acc.absorbErrors(stack.back().manifest);
-  XrdCl::URL base(url);
+//------------------------------------------------------------------------------
+// Wait for the given directory, and push it as the new deepest level of this
+// worker's stack.
+//------------------------------------------------------------------------------
+void TreeValidator::expand(size_t id, folly::Future<ManifestHolder> fut, TestcaseStatus &acc) {
+  TreeLevel level = insertLevel(std::move(fut).get());
+  acc.absorbErrors(level.manifest);
+  bool newWork = !level.exhausted();
+
+  WorkerStack &stack = *stacks[id];
+  {
+    std::lock_guard<std::mutex> lock(stack.mtx);
+    stack.levels.push_back(std::move(level));
+  }
+
+  // Children were counted by insertLevel, so the total only reaches zero
+  // once the very last directory has been expanded.
+  if(--pendingDirectories == 0 || newWork) {
+    std::lock_guard<std::mutex> lock(idleMtx);
+    idleCv.notify_all();
+  }
+}
+
+//------------------------------------------------------------------------------
+// Take the next child from the deepest level of our own stack, popping
+// levels which are completely done. Subdirectories to prefetch are picked
+// under the lock, but only requested once it's dropped: neither the requests
+// nor whatever completes inline should run while holding it.
+//------------------------------------------------------------------------------
+bool TreeValidator::takeOwn(size_t id, folly::Future<ManifestHolder> &out) {
+  WorkerStack &stack = *stacks[id];
+
+  while(true) {
+    std::vector<std::string> children;
+
+    {
+      std::lock_guard<std::mutex> lock(stack.mtx);
+
+      while(!stack.levels.empty()) {
+        TreeLevel &level = stack.levels.back();
+
+        // Enough for lookahead to remain in flight once we've taken one.
+        // Sampling may turn out there's nothing left.
+        std::string child;
+        while(level.prefetchedChildren.size() + children.size() <= lookahead && takeChild(level, false, child)) {
+          children.push_back(child);
+        }
+
+        if(!level.prefetchedChildren.empty() || !children.empty()) break;
+        stack.levels.pop_back();
+      }
+
+      if(stack.levels.empty()) return false;
+    }
+
+    std::vector<folly::Future<ManifestHolder>> requested;
+    for(auto it = children.begin(); it != children.end(); it++) {
+      requested.push_back(validateSingleDirectory(getConnectionId(), *it));
+    }
+
+    // Only we push and pop levels, so the deepest one is still the one the
+    // children came from - but thieves may have emptied it in the meantime.
+    std::lock_guard<std::mutex> lock(stack.mtx);
+    TreeLevel &level = stack.levels.back();
+
+    for(auto it = requested.begin(); it != requested.end(); it++) {
+      level.prefetchedChildren.push_back(std::move(*it));
+    }
+
+    if(!level.prefetchedChildren.empty()) {
+      out = std::move(level.prefetchedChildren.front());
+      level.prefetchedChildren.pop_front();
+      return true;
+    }
+  }
+}
 
+//------------------------------------------------------------------------------
+// Take a child from the shallowest non-exhausted level of some other worker.
+// The owner consumes its levels front-first, so take from the back,
+// preferring subdirectories which haven't been requested yet.
+//------------------------------------------------------------------------------
+bool TreeValidator::steal(size_t id, folly::Future<ManifestHolder> &out) {
+  for(size_t i = 1; i < nworkers; i++) {
+    WorkerStack &victim = *stacks[(id + i) % nworkers];
+    std::string child;
+
+    {
+      std::lock_guard<std::mutex> lock(victim.mtx);
+
+      for(TreeLevel &level : victim.levels) {
+        if(takeChild(level, true, child)) break;
+
+        if(!level.prefetchedChildren.empty()) {
+          out = std::move(level.prefetchedChildren.back());
+          level.prefetchedChildren.pop_back();
+          return true;
+        }
+      }
+    }
+
+    // Requested with the victim's lock dropped, as in takeOwn
+    if(!child.empty()) {
+      out = validateSingleDirectory(getConnectionId(), child);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void TreeValidator::worker(size_t id, TestcaseStatus &acc, ThreadAssistant &assistant) {
   while(true) {
     // Early termination requested?
     if(assistant.terminationRequested()) {
       break;
     }
 
-    if(stack.empty()) {
-      // We've exhausted our designated search space, return to caller.
-      break;
+    folly::Future<ManifestHolder> next = folly::makeFuture<ManifestHolder>(ManifestHolder());
+    if(takeOwn(id, next) || steal(id, next)) {
+      expand(id, std::move(next), acc);
+      continue;
     }
-    auto& unexpandedChildren = stack.back().unexpandedChildren;
 
-    if(!unexpandedChildren.empty()) {
-      // Case 3: Expand a directory
-      stack.push_back(insertLevel(std::move(unexpandedChildren.front()).get()));
-      acc.absorbErrors(stack.back().manifest);
-      unexpandedChildren.pop_front();
-    }
-    else {
-      // Case 4: We're completely done with this level, pop.
-      stack.pop_back();
+    if(pendingDirectories == 0) {
+      // Every directory in the tree has been expanded.
+      break;
     }
+
+    // Nothing to take right now, but other workers are still expanding
+    // directories which may turn up more work.
+    std::unique_lock<std::mutex> lock(idleMtx);
+    idleCv.wait_for(lock, std::chrono::milliseconds(10));
   }
 }
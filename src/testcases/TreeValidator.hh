@@ -21,8 +21,12 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
  ************************************************************************/
 
+#ifndef EOSTESTER_TESTCASE_TREE_VALIDATOR_H
+#define EOSTESTER_TESTCASE_TREE_VALIDATOR_H
+
 #include "utils/TestcaseStatus.hh"
 #include "utils/AssistedThread.hh"
+#include "utils/AsyncBudget.hh"
 #include "Manifest.hh"
 
 #include <XrdCl/XrdClURL.hh>
@@ -30,7 +34,11 @@
 #include <folly/futures/Future.h>
 #include <folly/executors/Async.h>
 
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 namespace eostest {
 
@@ -41,30 +49,127 @@ struct ManifestHolder : public TestcaseStatus {
 struct TreeLevel {
   TreeLevel(ManifestHolder &&holder) : manifest(std::move(holder)) {}
 
+  // Subdirectories not requested yet are those still in the MANIFEST. Their
+  // URLs are only built once requested - the owner takes from the front,
+  // thieves from the back.
   ManifestHolder manifest;
-  std::deque<folly::Future<ManifestHolder>> unexpandedChildren;
+  std::string directory;
+
+  // Subdirectories whose listing and manifest are already on their way, in
+  // MANIFEST order.
+  std::deque<folly::Future<ManifestHolder>> prefetchedChildren;
+
+  bool hasUnexpanded() const {
+    return manifest.manifest.subdirCount() != 0;
+  }
+
+  bool exhausted() const {
+    return !hasUnexpanded() && prefetchedChildren.empty();
+  }
 };
 
 class ProgressTracker;
+class DirListStatus;
+class Executor;
 
 class TreeValidator {
 public:
-  TreeValidator(const std::string &url, ProgressTracker *track);
+  struct Options {
+    std::string url;
+
+    // Number of threads expanding directories. Each owns a stack of levels,
+    // and steals unexpanded subtrees from the others once it runs dry.
+    size_t workers = 1;
+
+    // Maximum number of requests in flight, across all workers. A directory
+    // issues the reads of its files in batches of at most this many.
+    size_t maxInflight = 5000;
+
+    // Number of subdirectories per level requested ahead of expansion. Apart
+    // from the MANIFESTs of the levels on the stack, memory use is
+    // proportional to depth times lookahead times maxInflight, no matter how
+    // wide the tree is.
+    size_t lookahead = 4;
+
+    // Only cross-check each MANIFEST against the directory listing, and
+    // file sizes against those the MANIFEST records - read no data.
+    bool metadataOnly = false;
+
+    // For files whose MANIFEST records a checksum, ask the server for its
+    // checksum instead of reading the contents. Files without one are still
+    // read in full.
+    bool serverChecksums = false;
+
+    // Validate only the files whose path hashes, under sampleSeed, below
+    // sampleRate. Which files are picked depends only on path and seed, so a
+    // run can be repeated exactly, and runs with different seeds together
+    // approach full coverage. With sampleDirectories, unpicked directories
+    // are skipped along with their entire subtree.
+    double sampleRate = 1.0;
+    uint64_t sampleSeed = 0;
+    bool sampleDirectories = false;
+  };
+
+  TreeValidator(Executor &executor, const Options &opts, ProgressTracker *track);
+  TreeValidator(Executor &executor, const std::string &url, ProgressTracker *track);
   folly::Future<TestcaseStatus> initialize();
   void main(ThreadAssistant &assistant);
 
 private:
+  //----------------------------------------------------------------------------
+  // Per-worker depth-first stack. The owner expands from the deepest level,
+  // thieves take from the shallowest one, where the largest subtrees are.
+  //----------------------------------------------------------------------------
+  struct WorkerStack {
+    std::mutex mtx;
+    std::deque<TreeLevel> levels;
+  };
+
+  Executor &executor;
   std::string url;
+  size_t nworkers;
+  size_t lookahead;
+  size_t fileBatch;
+  bool metadataOnly;
+  bool serverChecksums;
+  double sampleRate;
+  uint64_t sampleSeed;
+  bool sampleDirectories;
+  AsyncBudget budget;
   folly::Promise<TestcaseStatus> promise;
   AssistedThread thread;
   ProgressTracker* tracker = nullptr;
 
   TreeLevel insertLevel(ManifestHolder manifest);
   folly::Future<ManifestHolder> validateSingleDirectory(size_t connectionId, const std::string &path);
+  folly::Future<ManifestHolder> fetchShards(const std::string &path, ManifestHolder holder);
+  ManifestHolder validateFileSizes(std::tuple<ManifestHolder, DirListStatus> tup);
   folly::Future<ManifestHolder> validateContainedFiles(size_t connectionId, ManifestHolder holder, std::string path);
   folly::Future<TestcaseStatus> validateSingleFile(size_t connectionId, const std::string &path);
-
-  void worker(std::string url, TestcaseStatus &acc, ThreadAssistant &assistant);
+  folly::Future<TestcaseStatus> validateChecksum(size_t connectionId, const std::string &path, const std::string &expected);
+
+  void worker(size_t id, TestcaseStatus &acc, ThreadAssistant &assistant);
+  bool takeOwn(size_t id, folly::Future<ManifestHolder> &out);
+  bool steal(size_t id, folly::Future<ManifestHolder> &out);
+  bool isSampled(const std::string &path) const;
+  TestcaseStatus coverageReport();
+  bool takeChild(TreeLevel &level, bool back, std::string &out);
+  void prefetch(TreeLevel &level);
+  void expand(size_t id, folly::Future<ManifestHolder> fut, TestcaseStatus &acc);
+
+  std::vector<std::unique_ptr<WorkerStack>> stacks;
+
+  // Directories discovered but not yet expanded, across all workers. Zero
+  // means the whole tree has been visited.
+  std::atomic<int64_t> pendingDirectories {0};
+  // Sampling coverage
+  std::atomic<uint64_t> filesSeen {0};
+  std::atomic<uint64_t> filesSampled {0};
+  std::atomic<uint64_t> directoriesSeen {0};
+  std::atomic<uint64_t> directoriesSampled {0};
+
+  std::mutex idleMtx;
+  std::condition_variable idleCv;
 
   size_t getConnectionId() {
     return (currentConnectionId++) % 32;
@@ -74,3 +179,5 @@ private:
 };
 
 }
+
+#endif
@@ -0,0 +1,90 @@
+// ----------------------------------------------------------------------
+// File: AsyncBudget.cc
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include <algorithm>
+#include "AsyncBudget.hh"
+using namespace eostest;
+
+namespace {
+
+//------------------------------------------------------------------------------
+// Slots handed over on this thread, whose waiters have yet to be woken up.
+// A waiter's continuation issues its request, and if that completes inline,
+// releases again: rather than recursing once per queued waiter, the outermost
+// release() on the stack wakes them up one after the other.
+//------------------------------------------------------------------------------
+thread_local bool handingOver = false;
+thread_local std::deque<folly::Promise<folly::Unit>> handedOver;
+
+}
+
+AsyncBudget::AsyncBudget(size_t sl) : slots(std::max<size_t>(1, sl)) {}
+
+folly::Future<folly::Unit> AsyncBudget::acquire() {
+  std::lock_guard<std::mutex> lock(mtx);
+
+  if(inUse < slots) {
+    inUse++;
+    return folly::makeFuture();
+  }
+
+  waiting.emplace_back();
+  return waiting.back().getFuture();
+}
+
+void AsyncBudget::release() {
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    if(waiting.empty()) {
+      inUse--;
+      return;
+    }
+
+    // Hand the slot over directly, inUse stays the same
+    handedOver.push_back(std::move(waiting.front()));
+    waiting.pop_front();
+  }
+
+  if(handingOver) return;
+
+  // Outside the lock - this runs the waiters' continuations
+  handingOver = true;
+  while(!handedOver.empty()) {
+    folly::Promise<folly::Unit> next = std::move(handedOver.front());
+    handedOver.pop_front();
+    next.setValue(folly::Unit());
+  }
+
+  handingOver = false;
+}
+
+size_t AsyncBudget::getInUse() {
+  std::lock_guard<std::mutex> lock(mtx);
+  return inUse;
+}
+
+size_t AsyncBudget::getWaiting() {
+  std::lock_guard<std::mutex> lock(mtx);
+  return waiting.size();
+}
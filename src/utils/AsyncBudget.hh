@@ -0,0 +1,77 @@
+// ----------------------------------------------------------------------
+// File: AsyncBudget.hh
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef EOSTESTER_ASYNC_BUDGET_H
+#define EOSTESTER_ASYNC_BUDGET_H
+
+#include <deque>
+#include <mutex>
+#include <folly/futures/Future.h>
+
+namespace eostest {
+
+//------------------------------------------------------------------------------
+// A counting semaphore which never blocks: acquire() hands out a future,
+// fulfilled once a slot is free. Suitable for capping the number of requests
+// in flight from inside future continuations, where blocking could deadlock
+// the thread delivering completions.
+//------------------------------------------------------------------------------
+class AsyncBudget {
+public:
+  AsyncBudget(size_t slots);
+
+  folly::Future<folly::Unit> acquire();
+  void release();
+
+  //----------------------------------------------------------------------------
+  // Acquire a slot, call the given function to issue a request, and give the
+  // slot back once the returned future completes - whether with a value, with
+  // an exception, or because issuing threw.
+  //----------------------------------------------------------------------------
+  template<typename F>
+  auto run(F issue) -> decltype(issue()) {
+    return acquire().thenValue([issue](folly::Unit) {
+      return issue();
+    }).ensure([this]() {
+      release();
+    });
+  }
+
+  size_t getSlots() const {
+    return slots;
+  }
+
+  size_t getInUse();
+  size_t getWaiting();
+
+private:
+  size_t slots;
+
+  std::mutex mtx;
+  size_t inUse = 0;
+  std::deque<folly::Promise<folly::Unit>> waiting;
+};
+
+}
+
+#endif
@@ -0,0 +1,163 @@
+// ----------------------------------------------------------------------
+// File: CheckpointJournal.cc
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "../Macros.hh"
+#include "../HashCalculator.hh"
+#include "CheckpointJournal.hh"
+using namespace eostest;
+
+namespace {
+
+//------------------------------------------------------------------------------
+// On-disk layout: the header, followed by "capacity" slots of 8 bytes. A
+// slot holds key + 1, so that zero means never written - slots are filled
+// out of order, and a crash may leave holes.
+//------------------------------------------------------------------------------
+struct JournalHeader {
+  char magic[8];
+  uint64_t identity;
+  uint64_t capacity;
+  uint64_t reserved[5];
+};
+
+static_assert(sizeof(JournalHeader) == 64, "journal header must stay 64 bytes");
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t), "slots must be plain 64-bit words");
+
+const char kMagic[8] = { 'E', 'O', 'S', 'T', 'J', 'R', 'N', '1' };
+
+}
+
+CheckpointJournal::CheckpointJournal() {}
+
+CheckpointJournal::~CheckpointJournal() {
+  close();
+}
+
+void CheckpointJournal::close() {
+  if(mapping) {
+    msync(mapping, mappingSize, MS_SYNC);
+    munmap(mapping, mappingSize);
+    mapping = nullptr;
+    records = nullptr;
+  }
+
+  if(fd >= 0) {
+    ::close(fd);
+    fd = -1;
+  }
+}
+
+TestcaseStatus CheckpointJournal::open(const std::string &path, const std::string &identity, uint64_t cap, bool resume) {
+  close();
+
+  fd = ::open(path.c_str(), O_RDWR | O_CREAT | (resume ? 0 : O_TRUNC), 0644);
+  if(fd < 0) {
+    return TestcaseStatus(SSTR("Could not open journal " << path << ": " << strerror(errno)));
+  }
+
+  JournalHeader expected;
+  memset(&expected, 0, sizeof(expected));
+  memcpy(expected.magic, kMagic, sizeof(kMagic));
+  expected.identity = HashCalculator::hash64(identity, 0);
+  expected.capacity = cap;
+
+  off_t existing = lseek(fd, 0, SEEK_END);
+  if(resume && existing > 0) {
+    JournalHeader header;
+    if(pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+       memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+      return TestcaseStatus(SSTR("Not a journal, or corrupted: " << path));
+    }
+
+    if(header.identity != expected.identity || header.capacity != cap) {
+      return TestcaseStatus(SSTR("Journal " << path << " was written by a different run, refusing to resume from it"));
+    }
+  }
+  else if(pwrite(fd, &expected, sizeof(expected), 0) != sizeof(expected)) {
+    return TestcaseStatus(SSTR("Could not write journal header into " << path << ": " << strerror(errno)));
+  }
+
+  mappingSize = sizeof(JournalHeader) + cap * sizeof(uint64_t);
+  if(ftruncate(fd, mappingSize) != 0) {
+    return TestcaseStatus(SSTR("Could not resize journal " << path << ": " << strerror(errno)));
+  }
+
+  mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if(mapping == MAP_FAILED) {
+    mapping = nullptr;
+    return TestcaseStatus(SSTR("Could not map journal " << path << ": " << strerror(errno)));
+  }
+
+  capacity = cap;
+  records = reinterpret_cast<std::atomic<uint64_t>*>((char*) mapping + sizeof(JournalHeader));
+
+  // Replay: keys into the in-memory set, and append after the last slot
+  // in use
+  completed.assign(capacity, false);
+  recovered = 0;
+  uint64_t end = 0;
+
+  for(uint64_t slot = 0; slot < capacity; slot++) {
+    uint64_t value = records[slot].load(std::memory_order_relaxed);
+    if(value == 0 || value > capacity) continue;
+
+    if(!completed[value - 1]) {
+      completed[value - 1] = true;
+      recovered++;
+    }
+
+    end = slot + 1;
+  }
+
+  nextSlot = end;
+  return TestcaseStatus();
+}
+
+bool CheckpointJournal::contains(uint64_t key) const {
+  return key < completed.size() && completed[key];
+}
+
+void CheckpointJournal::record(uint64_t key) {
+  if(!records || key >= capacity) return;
+
+  // Holes left by a previous run aren't reused, so slots might run out
+  // if resumed over and over. Not worth failing the run for: the worst
+  // case is redoing some work next time.
+  uint64_t slot = nextSlot.fetch_add(1);
+  if(slot >= capacity) return;
+
+  records[slot].store(key + 1, std::memory_order_release);
+}
+
+void CheckpointJournal::sync() {
+  if(mapping) msync(mapping, mappingSize, MS_SYNC);
+}
+
+uint64_t CheckpointJournal::getRecovered() const {
+  return recovered;
+}
@@ -0,0 +1,89 @@
+// ----------------------------------------------------------------------
+// File: CheckpointJournal.hh
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef EOSTESTER_CHECKPOINT_JOURNAL_H
+#define EOSTESTER_CHECKPOINT_JOURNAL_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "TestcaseStatus.hh"
+
+namespace eostest {
+
+//------------------------------------------------------------------------------
+// Append-only, memory-mapped local journal of completed operations, each
+// identified by a key below a fixed capacity - so that an interrupted run
+// can resume, skipping what's already done.
+//
+// record() is lock-free and may be called from any thread: it reserves a
+// slot and stores into the mapping, which the kernel owns - so everything
+// recorded survives a crash of the process, just not one of the machine,
+// unless sync()'ed. The file is preallocated sparse for the worst case, so
+// it never needs remapping.
+//
+// The identity string describes the run: resuming a journal written for a
+// different one is refused.
+//------------------------------------------------------------------------------
+class CheckpointJournal {
+public:
+  CheckpointJournal();
+  ~CheckpointJournal();
+
+  CheckpointJournal(const CheckpointJournal&) = delete;
+  CheckpointJournal& operator=(const CheckpointJournal&) = delete;
+
+  //----------------------------------------------------------------------------
+  // Open the journal at the given path. With resume, replay what an
+  // existing one holds - otherwise, start afresh.
+  //----------------------------------------------------------------------------
+  TestcaseStatus open(const std::string &path, const std::string &identity, uint64_t capacity, bool resume);
+
+  bool contains(uint64_t key) const;
+  void record(uint64_t key);
+  void sync();
+
+  //----------------------------------------------------------------------------
+  // Number of keys found in the journal when it was opened.
+  //----------------------------------------------------------------------------
+  uint64_t getRecovered() const;
+
+private:
+  void close();
+
+  int fd = -1;
+  void *mapping = nullptr;
+  size_t mappingSize = 0;
+
+  uint64_t capacity = 0;
+  std::atomic<uint64_t> *records = nullptr;
+  std::atomic<uint64_t> nextSlot {0};
+
+  std::vector<bool> completed;
+  uint64_t recovered = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,120 @@
+// ----------------------------------------------------------------------
+// File: ConcurrencyController.cc
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include "ConcurrencyController.hh"
+#include "Macros.hh"
+using namespace eostest;
+
+ConcurrencyController::ConcurrencyController(const Options &opts) : options(opts) {
+  options.maxWindow = std::max<size_t>(1, options.maxWindow);
+  options.minWindow = std::max<size_t>(1, std::min(options.minWindow, options.maxWindow));
+
+  if(isAdaptive()) {
+    window = std::max(options.minWindow, std::min(options.initialWindow, options.maxWindow));
+  }
+  else {
+    window = options.maxWindow;
+  }
+
+  smoothedWindow = window;
+  smallestWindow = window;
+  largestWindow = window;
+}
+
+bool ConcurrencyController::isAdaptive() const {
+  return options.targetP99.count() > 0;
+}
+
+void ConcurrencyController::acquire() {
+  std::unique_lock<std::mutex> lock(mtx);
+  cv.wait(lock, [this]() { return inFlight < window; });
+  inFlight++;
+}
+
+void ConcurrencyController::release(std::chrono::nanoseconds latency) {
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    eost_assert(inFlight > 0);
+    inFlight--;
+
+    if(isAdaptive()) {
+      epoch.record(latency);
+      if(epoch.count() >= std::max(options.minEpochSamples, window)) {
+        endEpoch();
+      }
+    }
+  }
+
+  cv.notify_all();
+}
+
+void ConcurrencyController::endEpoch() {
+  std::chrono::nanoseconds p99 = epoch.percentile(0.99);
+  epoch = LatencyHistogram();
+  epochs++;
+
+  if(p99 > options.targetP99) {
+    slowStart = false;
+    decreases++;
+    window = std::max<size_t>(options.minWindow, window * options.decreaseFactor);
+  }
+  else if(slowStart) {
+    window = std::min(options.maxWindow, window * 2);
+  }
+  else {
+    window = std::min(options.maxWindow, window + std::max<size_t>(1, window / 16));
+  }
+
+  smoothedWindow = 0.8 * smoothedWindow + 0.2 * window;
+  smallestWindow = std::min(smallestWindow, window);
+  largestWindow = std::max(largestWindow, window);
+}
+
+size_t ConcurrencyController::getWindow() {
+  std::lock_guard<std::mutex> lock(mtx);
+  return window;
+}
+
+size_t ConcurrencyController::getInFlight() {
+  std::lock_guard<std::mutex> lock(mtx);
+  return inFlight;
+}
+
+size_t ConcurrencyController::getSettledWindow() {
+  std::lock_guard<std::mutex> lock(mtx);
+  return std::lround(smoothedWindow);
+}
+
+std::string ConcurrencyController::describe() {
+  std::lock_guard<std::mutex> lock(mtx);
+
+  if(!isAdaptive()) {
+    return SSTR("Fixed in-flight window of " << window);
+  }
+
+  return SSTR("In-flight window settled at " << std::lround(smoothedWindow) << " for p99 target of "
+    << std::chrono::duration_cast<std::chrono::milliseconds>(options.targetP99).count() << " ms (range "
+    << smallestWindow << "-" << largestWindow << " over " << epochs << " epochs, " << decreases << " decreases)");
+}
@@ -0,0 +1,108 @@
+// ----------------------------------------------------------------------
+// File: ConcurrencyController.hh
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef EOSTESTER_CONCURRENCY_CONTROLLER_H
+#define EOSTESTER_CONCURRENCY_CONTROLLER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include "utils/LatencyHistogram.hh"
+
+namespace eostest {
+
+//------------------------------------------------------------------------------
+// Decides how many operations a testcase keeps in flight.
+//
+// Without a latency target the window is simply fixed at maxWindow. With one,
+// the window adapts AIMD-style: completions are grouped into epochs of about
+// one window's worth of operations, and at the end of each epoch the p99 of
+// that epoch is compared against the target. Starting from initialWindow,
+// the window doubles every epoch until the target is first exceeded
+// (slow start), then grows by a small fraction of itself per epoch, and is
+// cut multiplicatively whenever p99 goes over the target.
+//------------------------------------------------------------------------------
+class ConcurrencyController {
+public:
+  struct Options {
+    size_t minWindow = 1;
+    size_t maxWindow = 5000;
+    size_t initialWindow = 32;
+
+    // Zero means no target - fixed window of maxWindow.
+    std::chrono::nanoseconds targetP99 {0};
+
+    // An epoch lasts at least this many completions, so that p99 means
+    // something even while the window is small.
+    size_t minEpochSamples = 200;
+    double decreaseFactor = 0.7;
+  };
+
+  ConcurrencyController(const Options &opts);
+
+  //----------------------------------------------------------------------------
+  // Block until the number of operations in flight is below the window, then
+  // take a slot.
+  //----------------------------------------------------------------------------
+  void acquire();
+
+  //----------------------------------------------------------------------------
+  // Give back a slot, reporting how long the operation took.
+  //----------------------------------------------------------------------------
+  void release(std::chrono::nanoseconds latency);
+
+  size_t getWindow();
+  size_t getInFlight();
+  bool isAdaptive() const;
+
+  //----------------------------------------------------------------------------
+  // The window the controller has been hovering around, as a smoothed
+  // average over the most recent epochs.
+  //----------------------------------------------------------------------------
+  size_t getSettledWindow();
+  std::string describe();
+
+private:
+  void endEpoch();
+
+  Options options;
+
+  std::mutex mtx;
+  std::condition_variable cv;
+
+  size_t window;
+  size_t inFlight = 0;
+
+  LatencyHistogram epoch;
+  bool slowStart = true;
+  double smoothedWindow;
+  size_t smallestWindow;
+  size_t largestWindow;
+  size_t decreases = 0;
+  size_t epochs = 0;
+};
+
+}
+
+#endif
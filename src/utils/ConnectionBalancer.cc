@@ -0,0 +1,141 @@
+// ----------------------------------------------------------------------
+// File: ConnectionBalancer.cc
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include "ConnectionBalancer.hh"
+#include "Macros.hh"
+using namespace eostest;
+
+bool eostest::parsePlacementPolicy(const std::string &str, PlacementPolicy &policy) {
+  if(str == "round-robin") {
+    policy = PlacementPolicy::kRoundRobin;
+    return true;
+  }
+
+  if(str == "subtree") {
+    policy = PlacementPolicy::kSubtree;
+    return true;
+  }
+
+  if(str == "least-loaded") {
+    policy = PlacementPolicy::kLeastLoaded;
+    return true;
+  }
+
+  return false;
+}
+
+std::string eostest::placementPolicyToString(PlacementPolicy policy) {
+  switch(policy) {
+    case PlacementPolicy::kRoundRobin: return "round-robin";
+    case PlacementPolicy::kSubtree: return "subtree";
+    case PlacementPolicy::kLeastLoaded: return "least-loaded";
+  }
+
+  return "unknown";
+}
+
+ConnectionBalancer::ConnectionBalancer(size_t connections, PlacementPolicy pol)
+: policy(pol) {
+  connections = std::max<size_t>(1, connections);
+
+  for(size_t i = 0; i < connections; i++) {
+    stats.emplace_back(new Stats());
+  }
+}
+
+size_t ConnectionBalancer::pick(const std::string &directory) {
+  size_t index = 0;
+
+  switch(policy) {
+    case PlacementPolicy::kRoundRobin: {
+      index = nextConnection++ % stats.size();
+      break;
+    }
+    case PlacementPolicy::kSubtree: {
+      index = std::hash<std::string>()(directory) % stats.size();
+      break;
+    }
+    case PlacementPolicy::kLeastLoaded: {
+      // Start scanning from a rotating position, so that ties don't all
+      // land on the first connection.
+      size_t start = nextConnection++ % stats.size();
+      index = start;
+
+      for(size_t i = 1; i < stats.size(); i++) {
+        size_t candidate = (start + i) % stats.size();
+        if(stats[candidate]->inFlight < stats[index]->inFlight) {
+          index = candidate;
+        }
+      }
+
+      break;
+    }
+  }
+
+  stats[index]->inFlight++;
+  return index + 1;
+}
+
+void ConnectionBalancer::completed(size_t connectionId, std::chrono::nanoseconds latency, bool ok) {
+  eost_assert(connectionId >= 1 && connectionId <= stats.size());
+  Stats &st = *stats[connectionId - 1];
+
+  st.inFlight--;
+  st.completed++;
+  st.totalLatency += latency.count();
+  if(!ok) st.failed++;
+}
+
+size_t ConnectionBalancer::getInFlight(size_t connectionId) const {
+  return stats[connectionId - 1]->inFlight;
+}
+
+uint64_t ConnectionBalancer::getCompleted(size_t connectionId) const {
+  return stats[connectionId - 1]->completed;
+}
+
+std::vector<std::string> ConnectionBalancer::report(std::chrono::nanoseconds elapsed) const {
+  double seconds = std::chrono::duration<double>(elapsed).count();
+  std::vector<std::string> lines;
+
+  for(size_t i = 0; i < stats.size(); i++) {
+    uint64_t completed = stats[i]->completed;
+    uint64_t failed = stats[i]->failed;
+    double meanLatency = completed == 0 ? 0 : (stats[i]->totalLatency / (double) completed) / 1e6;
+
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(1);
+    ss << "Connection " << i + 1 << " :: " << completed << " ops";
+    if(seconds > 0) ss << ", " << completed / seconds << " ops/s";
+    ss << std::setprecision(2) << ", mean latency " << meanLatency << " ms";
+    if(failed != 0) ss << ", " << failed << " failed";
+
+    lines.emplace_back(ss.str());
+  }
+
+  return lines;
+}
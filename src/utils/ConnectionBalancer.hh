@@ -0,0 +1,94 @@
+// ----------------------------------------------------------------------
+// File: ConnectionBalancer.hh
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef EOSTESTER_CONNECTION_BALANCER_H
+#define EOSTESTER_CONNECTION_BALANCER_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace eostest {
+
+enum class PlacementPolicy {
+  kRoundRobin,
+  kSubtree,
+  kLeastLoaded
+};
+
+bool parsePlacementPolicy(const std::string &str, PlacementPolicy &policy);
+std::string placementPolicyToString(PlacementPolicy policy);
+
+//------------------------------------------------------------------------------
+// Spreads operations over connection IDs 1..N, and keeps per-connection
+// statistics.
+//
+// - kRoundRobin: each operation goes to the next connection.
+// - kSubtree: all entries of the same directory share a connection, chosen by
+//   hashing the directory path - requests for neighbouring files stay on one
+//   connection, while different directories fan out.
+// - kLeastLoaded: the connection with the fewest operations in flight.
+//------------------------------------------------------------------------------
+class ConnectionBalancer {
+public:
+  ConnectionBalancer(size_t connections, PlacementPolicy policy);
+
+  //----------------------------------------------------------------------------
+  // Choose a connection for an operation on an entry of the given directory,
+  // and count it as in flight. Every pick() must be paired with a
+  // completed() on the same connection.
+  //----------------------------------------------------------------------------
+  size_t pick(const std::string &directory);
+  void completed(size_t connectionId, std::chrono::nanoseconds latency, bool ok);
+
+  size_t getConnections() const {
+    return stats.size();
+  }
+
+  size_t getInFlight(size_t connectionId) const;
+  uint64_t getCompleted(size_t connectionId) const;
+
+  //----------------------------------------------------------------------------
+  // One line per connection: operations, rate over the given wall-clock
+  // time, mean latency and failures.
+  //----------------------------------------------------------------------------
+  std::vector<std::string> report(std::chrono::nanoseconds elapsed) const;
+
+private:
+  struct Stats {
+    std::atomic<size_t> inFlight {0};
+    std::atomic<uint64_t> completed {0};
+    std::atomic<uint64_t> failed {0};
+    std::atomic<uint64_t> totalLatency {0};
+  };
+
+  PlacementPolicy policy;
+  std::vector<std::unique_ptr<Stats>> stats;
+  std::atomic<size_t> nextConnection {0};
+};
+
+}
+
+#endif
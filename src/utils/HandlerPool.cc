@@ -0,0 +1,157 @@
+// ----------------------------------------------------------------------
+// File: HandlerPool.cc
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+#include "HandlerPool.hh"
+using namespace eostest;
+
+namespace {
+
+std::atomic<uint64_t> allocations {0};
+std::atomic<uint64_t> deallocations {0};
+std::atomic<uint64_t> heapAllocations {0};
+
+struct SharedPool {
+  std::mutex mtx;
+  std::vector<void*> freeLists[HandlerPool::kSizeClasses];
+};
+
+// Intentionally leaked: handlers may still be freed by threads which outlive
+// static destruction.
+SharedPool &sharedPool() {
+  static SharedPool *pool = new SharedPool();
+  return *pool;
+}
+
+thread_local bool threadCacheDestroyed = false;
+
+struct ThreadCache {
+  std::vector<void*> freeLists[HandlerPool::kSizeClasses];
+
+  ~ThreadCache() {
+    SharedPool &pool = sharedPool();
+    std::lock_guard<std::mutex> lock(pool.mtx);
+
+    for(size_t i = 0; i < HandlerPool::kSizeClasses; i++) {
+      pool.freeLists[i].insert(pool.freeLists[i].end(), freeLists[i].begin(), freeLists[i].end());
+    }
+
+    threadCacheDestroyed = true;
+  }
+};
+
+thread_local ThreadCache threadCache;
+
+ThreadCache* getThreadCache() {
+  if(threadCacheDestroyed) return nullptr;
+  return &threadCache;
+}
+
+size_t sizeClass(size_t size) {
+  return (size + HandlerPool::kGranularity - 1) / HandlerPool::kGranularity - 1;
+}
+
+size_t classSize(size_t cls) {
+  return (cls + 1) * HandlerPool::kGranularity;
+}
+
+// Move up to 'count' blocks from the back of 'src' to 'dst'.
+void transfer(std::vector<void*> &src, std::vector<void*> &dst, size_t count) {
+  count = std::min(count, src.size());
+  dst.insert(dst.end(), src.end() - count, src.end());
+  src.resize(src.size() - count);
+}
+
+}
+
+void* HandlerPool::allocate(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+
+  if(size == 0 || size > kMaxPooledSize) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    return ::operator new(size);
+  }
+
+  size_t cls = sizeClass(size);
+  ThreadCache *cache = getThreadCache();
+
+  if(cache) {
+    std::vector<void*> &local = cache->freeLists[cls];
+
+    if(local.empty()) {
+      SharedPool &pool = sharedPool();
+      std::lock_guard<std::mutex> lock(pool.mtx);
+      transfer(pool.freeLists[cls], local, kThreadCacheLimit / 2);
+    }
+
+    if(!local.empty()) {
+      void *ptr = local.back();
+      local.pop_back();
+      return ptr;
+    }
+  }
+
+  heapAllocations.fetch_add(1, std::memory_order_relaxed);
+  return ::operator new(classSize(cls));
+}
+
+void HandlerPool::deallocate(void *ptr, size_t size) {
+  if(!ptr) return;
+  deallocations.fetch_add(1, std::memory_order_relaxed);
+
+  if(size == 0 || size > kMaxPooledSize) {
+    ::operator delete(ptr);
+    return;
+  }
+
+  size_t cls = sizeClass(size);
+  ThreadCache *cache = getThreadCache();
+
+  if(!cache) {
+    SharedPool &pool = sharedPool();
+    std::lock_guard<std::mutex> lock(pool.mtx);
+    pool.freeLists[cls].push_back(ptr);
+    return;
+  }
+
+  std::vector<void*> &local = cache->freeLists[cls];
+  local.push_back(ptr);
+
+  if(local.size() > kThreadCacheLimit) {
+    SharedPool &pool = sharedPool();
+    std::lock_guard<std::mutex> lock(pool.mtx);
+    transfer(local, pool.freeLists[cls], kThreadCacheLimit / 2);
+  }
+}
+
+HandlerPool::Stats HandlerPool::getStats() {
+  Stats stats;
+  stats.allocations = allocations.load(std::memory_order_relaxed);
+  stats.deallocations = deallocations.load(std::memory_order_relaxed);
+  stats.heapAllocations = heapAllocations.load(std::memory_order_relaxed);
+  return stats;
+}
@@ -0,0 +1,81 @@
+// ----------------------------------------------------------------------
+// File: HandlerPool.hh
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef EOSTESTER_HANDLER_POOL_H
+#define EOSTESTER_HANDLER_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace eostest {
+
+//------------------------------------------------------------------------------
+// Recycling allocator for the short-lived objects of the XrdCl callback
+// chain. Every operation allocates a few handlers on the submitting thread,
+// which are then deleted on an XrdCl callback thread - plain new / delete
+// turns that into heavy allocator traffic in small-file storms.
+//
+// Blocks are grouped into size classes. Each thread keeps a small free list
+// per class; whatever overflows goes to a shared pool in batches, where the
+// allocating threads pick it up again. Memory is never given back to the
+// system, the pool only ever grows up to the peak number of live handlers.
+//------------------------------------------------------------------------------
+class HandlerPool {
+public:
+  struct Stats {
+    uint64_t allocations = 0;
+    uint64_t deallocations = 0;
+
+    // Allocations which had to go to the system allocator, either because
+    // no recycled block was available, or the object was too large to pool.
+    uint64_t heapAllocations = 0;
+  };
+
+  static void* allocate(size_t size);
+  static void deallocate(void *ptr, size_t size);
+  static Stats getStats();
+
+  static constexpr size_t kGranularity = 64;
+  static constexpr size_t kMaxPooledSize = 1024;
+  static constexpr size_t kSizeClasses = kMaxPooledSize / kGranularity;
+  static constexpr size_t kThreadCacheLimit = 512;
+};
+
+//------------------------------------------------------------------------------
+// Inherit from this to have instances allocated through HandlerPool. Relies
+// on sized deallocation, so polymorphic classes need a virtual destructor.
+//------------------------------------------------------------------------------
+class PooledAllocation {
+public:
+  static void* operator new(size_t size) {
+    return HandlerPool::allocate(size);
+  }
+
+  static void operator delete(void *ptr, size_t size) {
+    HandlerPool::deallocate(ptr, size);
+  }
+};
+
+}
+
+#endif
@@ -0,0 +1,315 @@
+// ----------------------------------------------------------------------
+// File: LatencyHistogram.cc
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iomanip>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include "LatencyHistogram.hh"
+using namespace eostest;
+
+std::string eostest::opTypeToString(OpType op) {
+  switch(op) {
+    case OpType::kMkdir: return "mkdir";
+    case OpType::kPut: return "put";
+    case OpType::kPutStream: return "putStream";
+    case OpType::kGet: return "get";
+    case OpType::kGetStream: return "getStream";
+    case OpType::kDirList: return "dirList";
+    case OpType::kRm: return "rm";
+    case OpType::kRmdir: return "rmdir";
+    case OpType::kChecksum: return "checksum";
+    case OpType::kCount: break;
+  }
+
+  return "unknown";
+}
+
+bool eostest::parseOpType(const std::string &str, OpType &op) {
+  for(size_t i = 0; i < (size_t) OpType::kCount; i++) {
+    if(opTypeToString((OpType) i) == str) {
+      op = (OpType) i;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+size_t LatencyHistogram::bucketIndex(uint64_t value) {
+  if(value < kSubBuckets) return value;
+
+  size_t msb = 63 - __builtin_clzll(value);
+  if(msb >= kMaxBits) return kBuckets - 1;
+
+  size_t shift = msb - kSubBucketBits;
+  return (shift + 1) * kSubBuckets + ((value >> shift) - kSubBuckets);
+}
+
+uint64_t LatencyHistogram::bucketLowerBound(size_t index) {
+  if(index < kSubBuckets) return index;
+
+  size_t shift = index / kSubBuckets - 1;
+  return (kSubBuckets + index % kSubBuckets) << shift;
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t index) {
+  if(index < kSubBuckets) return index;
+
+  size_t shift = index / kSubBuckets - 1;
+  return ((kSubBuckets + index % kSubBuckets + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(std::chrono::nanoseconds latency) {
+  uint64_t value = std::max<int64_t>(0, latency.count());
+  recordBucket(bucketIndex(value), 1);
+  recordMax(value);
+}
+
+void LatencyHistogram::recordBucket(size_t index, uint64_t count) {
+  buckets[index] += count;
+  total += count;
+}
+
+void LatencyHistogram::recordMax(uint64_t value) {
+  maximum = std::max(maximum, value);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other) {
+  for(size_t i = 0; i < kBuckets; i++) {
+    buckets[i] += other.buckets[i];
+  }
+
+  total += other.total;
+  maximum = std::max(maximum, other.maximum);
+}
+
+std::chrono::nanoseconds LatencyHistogram::percentile(double fraction) const {
+  if(total == 0) return std::chrono::nanoseconds(0);
+
+  uint64_t rank = std::max<uint64_t>(1, (uint64_t) std::ceil(fraction * total));
+  uint64_t seen = 0;
+
+  for(size_t i = 0; i < kBuckets; i++) {
+    seen += buckets[i];
+    if(seen >= rank) {
+      // Never report more than the largest sample we actually saw
+      return std::chrono::nanoseconds(std::min(bucketUpperBound(i), maximum));
+    }
+  }
+
+  return std::chrono::nanoseconds(maximum);
+}
+
+std::string LatencyHistogram::serialize() const {
+  std::ostringstream ss;
+  ss << maximum;
+
+  for(size_t i = 0; i < kBuckets; i++) {
+    if(buckets[i] != 0) ss << " " << i << ":" << buckets[i];
+  }
+
+  return ss.str();
+}
+
+bool LatencyHistogram::deserialize(const std::string &str, LatencyHistogram &out) {
+  std::istringstream ss(str);
+  LatencyHistogram histogram;
+
+  uint64_t max;
+  if(!(ss >> max)) return false;
+  histogram.recordMax(max);
+
+  size_t index;
+  while(ss >> index) {
+    uint64_t count;
+    if(index >= kBuckets || ss.get() != ':' || !(ss >> count)) return false;
+    histogram.recordBucket(index, count);
+  }
+
+  if(!ss.eof()) return false;
+
+  out = histogram;
+  return true;
+}
+
+namespace {
+
+//------------------------------------------------------------------------------
+// Counters owned by a single thread. Only the owner increments them, but
+// snapshots read them concurrently, hence the relaxed atomics.
+//------------------------------------------------------------------------------
+struct ThreadCounters {
+  std::atomic<uint64_t> buckets[(size_t) OpType::kCount][LatencyHistogram::kBuckets];
+  std::atomic<uint64_t> maximum[(size_t) OpType::kCount];
+
+  ThreadCounters() {
+    clear();
+  }
+
+  void clear() {
+    for(size_t op = 0; op < (size_t) OpType::kCount; op++) {
+      for(size_t i = 0; i < LatencyHistogram::kBuckets; i++) {
+        buckets[op][i].store(0, std::memory_order_relaxed);
+      }
+
+      maximum[op].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  void addTo(OpType op, LatencyHistogram &histogram) const {
+    for(size_t i = 0; i < LatencyHistogram::kBuckets; i++) {
+      uint64_t count = buckets[(size_t) op][i].load(std::memory_order_relaxed);
+      if(count != 0) histogram.recordBucket(i, count);
+    }
+
+    histogram.recordMax(maximum[(size_t) op].load(std::memory_order_relaxed));
+  }
+};
+
+struct Registry {
+  std::mutex mtx;
+  std::set<ThreadCounters*> live;
+  LatencyHistogram retired[(size_t) OpType::kCount];
+};
+
+// Intentionally leaked, threads may record during static destruction.
+Registry& registry() {
+  static Registry *reg = new Registry();
+  return *reg;
+}
+
+struct ThreadRegistration {
+  ThreadCounters *counters;
+
+  ThreadRegistration() : counters(new ThreadCounters()) {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mtx);
+    reg.live.insert(counters);
+  }
+
+  ~ThreadRegistration() {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mtx);
+
+    for(size_t op = 0; op < (size_t) OpType::kCount; op++) {
+      counters->addTo((OpType) op, reg.retired[op]);
+    }
+
+    reg.live.erase(counters);
+    delete counters;
+  }
+};
+
+thread_local ThreadRegistration registration;
+
+std::string formatLatency(std::chrono::nanoseconds latency) {
+  std::ostringstream ss;
+  ss << std::fixed << std::setprecision(2);
+
+  double ns = latency.count();
+  if(ns < 1e3) ss << ns << "ns";
+  else if(ns < 1e6) ss << ns / 1e3 << "us";
+  else if(ns < 1e9) ss << ns / 1e6 << "ms";
+  else ss << ns / 1e9 << "s";
+
+  return ss.str();
+}
+
+}
+
+void LatencyRecorder::record(OpType op, std::chrono::nanoseconds latency) {
+  uint64_t value = std::max<int64_t>(0, latency.count());
+  ThreadCounters *counters = registration.counters;
+
+  counters->buckets[(size_t) op][LatencyHistogram::bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+
+  std::atomic<uint64_t> &maximum = counters->maximum[(size_t) op];
+  if(maximum.load(std::memory_order_relaxed) < value) {
+    maximum.store(value, std::memory_order_relaxed);
+  }
+}
+
+LatencyHistogram LatencyRecorder::snapshot(OpType op) {
+  Registry &reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mtx);
+
+  LatencyHistogram histogram = reg.retired[(size_t) op];
+  for(ThreadCounters *counters : reg.live) {
+    counters->addTo(op, histogram);
+  }
+
+  return histogram;
+}
+
+void LatencyRecorder::reset() {
+  Registry &reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mtx);
+
+  for(size_t op = 0; op < (size_t) OpType::kCount; op++) {
+    reg.retired[op] = LatencyHistogram();
+  }
+
+  for(ThreadCounters *counters : reg.live) {
+    counters->clear();
+  }
+}
+
+void LatencyRecorder::merge(OpType op, const LatencyHistogram &histogram) {
+  Registry &reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mtx);
+  reg.retired[(size_t) op].merge(histogram);
+}
+
+std::string LatencyRecorder::report(std::chrono::nanoseconds elapsed) {
+  double seconds = std::chrono::duration<double>(elapsed).count();
+
+  std::ostringstream ss;
+  ss << std::left << std::setw(12) << "Operation" << std::right
+     << std::setw(12) << "count" << std::setw(12) << "ops/s"
+     << std::setw(11) << "p50" << std::setw(11) << "p90" << std::setw(11) << "p99"
+     << std::setw(11) << "p999" << std::setw(11) << "max" << std::endl;
+
+  for(size_t op = 0; op < (size_t) OpType::kCount; op++) {
+    LatencyHistogram histogram = snapshot((OpType) op);
+    if(histogram.count() == 0) continue;
+
+    std::ostringstream rate;
+    rate << std::fixed << std::setprecision(1);
+    if(seconds > 0) rate << histogram.count() / seconds;
+    else rate << "-";
+
+    ss << std::left << std::setw(12) << opTypeToString((OpType) op) << std::right
+       << std::setw(12) << histogram.count() << std::setw(12) << rate.str()
+       << std::setw(11) << formatLatency(histogram.percentile(0.50))
+       << std::setw(11) << formatLatency(histogram.percentile(0.90))
+       << std::setw(11) << formatLatency(histogram.percentile(0.99))
+       << std::setw(11) << formatLatency(histogram.percentile(0.999))
+       << std::setw(11) << formatLatency(histogram.max()) << std::endl;
+  }
+
+  return ss.str();
+}
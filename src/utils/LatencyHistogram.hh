@@ -0,0 +1,123 @@
+// ----------------------------------------------------------------------
+// File: LatencyHistogram.hh
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef EOSTESTER_LATENCY_HISTOGRAM_H
+#define EOSTESTER_LATENCY_HISTOGRAM_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace eostest {
+
+enum class OpType {
+  kMkdir = 0,
+  kPut,
+  kPutStream,
+  kGet,
+  kGetStream,
+  kDirList,
+  kRm,
+  kRmdir,
+  kChecksum,
+  kCount
+};
+
+std::string opTypeToString(OpType op);
+bool parseOpType(const std::string &str, OpType &op);
+
+//------------------------------------------------------------------------------
+// Log-linear latency histogram, in the spirit of HdrHistogram: every power of
+// two is split into 32 linear sub-buckets, which bounds the relative error of
+// any reported value to ~3%, from single nanoseconds up to ~18 minutes.
+// Larger values are clamped into the last bucket, but max() stays exact.
+//------------------------------------------------------------------------------
+class LatencyHistogram {
+public:
+  static constexpr size_t kSubBucketBits = 5;
+  static constexpr size_t kSubBuckets = 1 << kSubBucketBits;
+  static constexpr size_t kMaxBits = 40;
+  static constexpr size_t kBuckets = (kMaxBits - kSubBucketBits + 1) * kSubBuckets;
+
+  static size_t bucketIndex(uint64_t value);
+  static uint64_t bucketLowerBound(size_t index);
+  static uint64_t bucketUpperBound(size_t index);
+
+  void record(std::chrono::nanoseconds latency);
+  void recordBucket(size_t index, uint64_t count);
+  void recordMax(uint64_t value);
+  void merge(const LatencyHistogram &other);
+
+  uint64_t count() const {
+    return total;
+  }
+
+  std::chrono::nanoseconds max() const {
+    return std::chrono::nanoseconds(maximum);
+  }
+
+  //----------------------------------------------------------------------------
+  // Value below which the given fraction of samples falls, ie 0.99 for p99.
+  //----------------------------------------------------------------------------
+  std::chrono::nanoseconds percentile(double fraction) const;
+
+  //----------------------------------------------------------------------------
+  // Compact text form, listing only non-empty buckets, for passing
+  // histograms between processes.
+  //----------------------------------------------------------------------------
+  std::string serialize() const;
+  static bool deserialize(const std::string &str, LatencyHistogram &out);
+
+private:
+  std::array<uint64_t, kBuckets> buckets {};
+  uint64_t total = 0;
+  uint64_t maximum = 0;
+};
+
+//------------------------------------------------------------------------------
+// Process-wide latency collection, one histogram per operation type. Each
+// thread records into its own set of counters without locking; snapshot()
+// merges all of them, including those of threads which have since exited.
+//------------------------------------------------------------------------------
+class LatencyRecorder {
+public:
+  static void record(OpType op, std::chrono::nanoseconds latency);
+  static LatencyHistogram snapshot(OpType op);
+  static void reset();
+
+  //----------------------------------------------------------------------------
+  // Fold in latencies recorded elsewhere, ie by another process.
+  //----------------------------------------------------------------------------
+  static void merge(OpType op, const LatencyHistogram &histogram);
+
+  //----------------------------------------------------------------------------
+  // One line per operation type seen so far: count, rate over the given
+  // wall-clock time, p50 / p90 / p99 / p999 and max.
+  //----------------------------------------------------------------------------
+  static std::string report(std::chrono::nanoseconds elapsed);
+};
+
+}
+
+#endif
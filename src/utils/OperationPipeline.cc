@@ -0,0 +1,46 @@
+// ----------------------------------------------------------------------
+// File: OperationPipeline.cc
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include "OperationPipeline.hh"
+using namespace eostest;
+
+OperationPipeline::OperationPipeline(const ConcurrencyController::Options &opts)
+: state(std::make_shared<State>(opts)) {}
+
+void OperationPipeline::State::complete(TestcaseStatus &&status) {
+  controller.release(status.getDuration());
+
+  std::lock_guard<std::mutex> lock(mtx);
+  accumulator.absorbErrors(status);
+  outstanding--;
+  cv.notify_all();
+}
+
+TestcaseStatus OperationPipeline::drain() {
+  std::unique_lock<std::mutex> lock(state->mtx);
+  state->cv.wait(lock, [this]() { return state->outstanding == 0; });
+
+  TestcaseStatus retval = std::move(state->accumulator);
+  state->accumulator = TestcaseStatus();
+  return retval;
+}
@@ -0,0 +1,98 @@
+// ----------------------------------------------------------------------
+// File: OperationPipeline.hh
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef EOSTESTER_OPERATION_PIPELINE_H
+#define EOSTESTER_OPERATION_PIPELINE_H
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <folly/futures/Future.h>
+#include "utils/ConcurrencyController.hh"
+#include "utils/TestcaseStatus.hh"
+
+namespace eostest {
+
+//------------------------------------------------------------------------------
+// Keeps a window of operations in flight, and collects their results in
+// completion order: a slot frees up the moment any operation finishes, no
+// matter how many slower ones were submitted before it.
+//
+// Completion callbacks only hold a reference to the shared state, so it's
+// safe for the pipeline to go away while callbacks are still unwinding.
+//------------------------------------------------------------------------------
+class OperationPipeline {
+public:
+  OperationPipeline(const ConcurrencyController::Options &opts);
+
+  //----------------------------------------------------------------------------
+  // Block until the window has room, then call issue() to start the
+  // operation, which must return folly::Future<TestcaseStatus>.
+  //----------------------------------------------------------------------------
+  template<typename F>
+  void submit(F &&issue) {
+    state->controller.acquire();
+
+    {
+      std::lock_guard<std::mutex> lock(state->mtx);
+      state->outstanding++;
+    }
+
+    std::shared_ptr<State> st = state;
+    folly::Future<TestcaseStatus> fut = issue();
+
+    // Nobody needs the result of the continuation, the state is all we want.
+    (void) std::move(fut).thenValue([st](TestcaseStatus status) {
+      st->complete(std::move(status));
+    });
+  }
+
+  //----------------------------------------------------------------------------
+  // Wait for every submitted operation to finish, and return the errors of
+  // all of them.
+  //----------------------------------------------------------------------------
+  TestcaseStatus drain();
+
+  ConcurrencyController& getController() {
+    return state->controller;
+  }
+
+private:
+  struct State {
+    State(const ConcurrencyController::Options &opts) : controller(opts) {}
+    void complete(TestcaseStatus &&status);
+
+    ConcurrencyController controller;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    size_t outstanding = 0;
+    TestcaseStatus accumulator;
+  };
+
+  std::shared_ptr<State> state;
+};
+
+}
+
+#endif
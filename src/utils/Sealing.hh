@@ -28,6 +28,7 @@
 #include <string>
 #include <folly/futures/Future.h>
 #include "utils/TestcaseStatus.hh"
+#include "utils/LatencyHistogram.hh"
 
 namespace eostest {
 
@@ -49,10 +50,30 @@ public:
     return std::move(fut).thenValue(std::bind(Sealing::callback<T>, pendingSeal, std::placeholders::_1));
   }
 
+  //----------------------------------------------------------------------------
+  // Same as above, but also record the duration into the latency histogram
+  // of the given operation type.
+  //----------------------------------------------------------------------------
+  template<typename T>
+  static folly::Future<T> seal(folly::Future<T> &&fut, const std::string &description, OpType op) {
+    PendingSeal pendingSeal;
+    pendingSeal.description = description;
+    pendingSeal.startTime = std::chrono::steady_clock::now();
+    return std::move(fut).thenValue(std::bind(Sealing::recordingCallback<T>, pendingSeal, op, std::placeholders::_1));
+  }
+
   template<typename T>
   static T callback(PendingSeal seal, T st) {
     st.seal(seal.description, std::chrono::steady_clock::now() - seal.startTime);
-    return std::move(st);
+    return st;
+  }
+
+  template<typename T>
+  static T recordingCallback(PendingSeal seal, OpType op, T st) {
+    std::chrono::nanoseconds duration = std::chrono::steady_clock::now() - seal.startTime;
+    LatencyRecorder::record(op, duration);
+    st.seal(seal.description, duration);
+    return st;
   }
 };
 
@@ -0,0 +1,354 @@
+// ----------------------------------------------------------------------
+// File: ShardCoordinator.cc
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "../Macros.hh"
+#include "LatencyHistogram.hh"
+#include "ShardCoordinator.hh"
+using namespace eostest;
+
+static const std::string kResultHeader = "eos-tester shard result v2";
+
+ShardCoordinator::ShardCoordinator(const std::string &sp, size_t sh)
+: spool(sp), shards(sh) {
+  while(spool.size() > 1 && spool.back() == '/') {
+    spool.pop_back();
+  }
+}
+
+std::string ShardCoordinator::resultPath(size_t shard) const {
+  return SSTR(spool << "/shard-" << shard << ".result");
+}
+
+std::string ShardCoordinator::runPath() const {
+  return SSTR(spool << "/run");
+}
+
+//------------------------------------------------------------------------------
+// The run file holds the token of the coordinator waiting on the spool. It's
+// written aside and hard-linked into place: it never appears partial, and of
+// two racing coordinators, only one gets it.
+//------------------------------------------------------------------------------
+bool ShardCoordinator::claim(std::string &error) {
+  std::random_device rd;
+  token = SSTR(std::hex << ((uint64_t(rd()) << 32) | rd()) << "-" << std::dec << getpid());
+
+  std::string tmpPath = SSTR(runPath() << ".tmp." << getpid());
+  {
+    std::ofstream out(tmpPath, std::ios::trunc);
+    out << token << "\n";
+    out.close();
+
+    if(!out) {
+      std::remove(tmpPath.c_str());
+      error = SSTR("Could not write into spool " << spool);
+      token.clear();
+      return false;
+    }
+  }
+
+  int rc = link(tmpPath.c_str(), runPath().c_str());
+  int err = errno;
+  std::remove(tmpPath.c_str());
+
+  if(rc != 0) {
+    token.clear();
+
+    if(err == EEXIST) {
+      error = SSTR("Spool " << spool << " is claimed by another coordinator, or by one which never finished - remove " << runPath() << " if it's stale");
+    }
+    else {
+      error = SSTR("Could not claim spool " << spool << ": " << strerror(err));
+    }
+
+    return false;
+  }
+
+  return true;
+}
+
+void ShardCoordinator::release(bool removeSpool) {
+  std::string current;
+  if(readToken(current) && current == token) {
+    std::remove(runPath().c_str());
+  }
+
+  token.clear();
+  if(!removeSpool) return;
+
+  for(size_t shard = 0; shard < shards; shard++) {
+    std::remove(resultPath(shard).c_str());
+  }
+
+  rmdir(spool.c_str());
+}
+
+bool ShardCoordinator::readToken(std::string &out) const {
+  std::ifstream in(runPath());
+  return in && std::getline(in, out) && !out.empty();
+}
+
+//------------------------------------------------------------------------------
+// Result file format, one item per line:
+//
+//   eos-tester shard result v2
+//   run <token of the coordinator>
+//   latency <operation> <serialized LatencyHistogram>
+//   ...
+//   status <serialized TestcaseStatus, until the end of the file>
+//------------------------------------------------------------------------------
+bool ShardCoordinator::publish(size_t shard, const TestcaseStatus &status) const {
+  // Forked workers know the token already, those started by hand may well
+  // finish before their coordinator is up
+  std::string runToken = token;
+  bool announced = false;
+
+  while(runToken.empty() && !readToken(runToken)) {
+    if(!announced) {
+      std::cerr << "Waiting for a coordinator to claim " << spool << std::endl;
+      announced = true;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  }
+
+  std::string path = resultPath(shard);
+  std::string tmpPath = SSTR(path << ".tmp." << getpid());
+
+  {
+    std::ofstream out(tmpPath, std::ios::trunc);
+    out << kResultHeader << "\n";
+    out << "run " << runToken << "\n";
+
+    for(size_t op = 0; op < (size_t) OpType::kCount; op++) {
+      LatencyHistogram histogram = LatencyRecorder::snapshot((OpType) op);
+      if(histogram.count() == 0) continue;
+      out << "latency " << opTypeToString((OpType) op) << " " << histogram.serialize() << "\n";
+    }
+
+    out << "status " << status.serialize();
+    out.close();
+
+    if(!out) {
+      std::remove(tmpPath.c_str());
+      return false;
+    }
+  }
+
+  return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+bool ShardCoordinator::launch(const std::function<int(size_t shard)> &worker) {
+  eost_assert(!token.empty());
+
+  for(size_t shard = 0; shard < shards; shard++) {
+    std::remove(resultPath(shard).c_str());
+  }
+
+  std::cout << std::flush;
+  std::cerr << std::flush;
+
+  for(size_t shard = 0; shard < shards; shard++) {
+    pid_t pid = fork();
+
+    if(pid < 0) {
+      for(auto it = workers.begin(); it != workers.end(); it++) {
+        kill(*it, SIGKILL);
+        waitpid(*it, nullptr, 0);
+      }
+
+      workers.clear();
+      return false;
+    }
+
+    if(pid == 0) {
+      LatencyRecorder::reset();
+      int retval = worker(shard);
+
+      // Don't run the parent's atexit handlers and static destructors twice
+      std::cout << std::flush;
+      std::cerr << std::flush;
+      _exit(retval);
+    }
+
+    workers.push_back(pid);
+  }
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Parse the result file of the given shard, if it's there yet - and from this
+// run, not left over from an earlier one.
+//------------------------------------------------------------------------------
+bool ShardCoordinator::absorb(size_t shard, TestcaseStatus &status) const {
+  std::ifstream in(resultPath(shard));
+  if(!in) return false;
+
+  std::stringstream buffer;
+  buffer << in.rdbuf();
+  std::string contents = buffer.str();
+
+  std::array<LatencyHistogram, (size_t) OpType::kCount> latencies;
+  TestcaseStatus published;
+  bool fromThisRun = false;
+  bool valid = false;
+
+  size_t pos = 0;
+  while(pos < contents.size()) {
+    size_t eol = contents.find('\n', pos);
+    if(eol == std::string::npos) eol = contents.size();
+    std::string line = contents.substr(pos, eol - pos);
+
+    if(pos == 0) {
+      if(line != kResultHeader) return false;
+    }
+    else if(!fromThisRun) {
+      if(line != SSTR("run " << token)) return false;
+      fromThisRun = true;
+    }
+    else if(line.compare(0, 8, "latency ") == 0) {
+      size_t space = line.find(' ', 8);
+      OpType op;
+      LatencyHistogram histogram;
+
+      if(space == std::string::npos || !parseOpType(line.substr(8, space - 8), op) ||
+         !LatencyHistogram::deserialize(line.substr(space + 1), histogram)) {
+        break;
+      }
+
+      latencies[(size_t) op].merge(histogram);
+    }
+    else if(contents.compare(pos, 7, "status ") == 0) {
+      valid = TestcaseStatus::deserialize(contents.substr(pos + 7), published);
+      break;
+    }
+    else {
+      break;
+    }
+
+    pos = eol + 1;
+  }
+
+  if(!valid) {
+    status = TestcaseStatus(SSTR("Malformed result file for shard " << shard << ": " << resultPath(shard)));
+    status.seal(SSTR("Shard " << shard));
+    return true;
+  }
+
+  for(size_t op = 0; op < (size_t) OpType::kCount; op++) {
+    if(latencies[op].count() != 0) LatencyRecorder::merge((OpType) op, latencies[op]);
+  }
+
+  status = std::move(published);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Has the local worker of the given shard exited? A worker which published
+// its results exits right after, so check for the file once more.
+//------------------------------------------------------------------------------
+bool ShardCoordinator::reaped(size_t shard, TestcaseStatus &status) {
+  if(shard >= workers.size() || workers[shard] <= 0) return false;
+
+  int wstatus;
+  if(waitpid(workers[shard], &wstatus, WNOHANG) != workers[shard]) return false;
+  workers[shard] = 0;
+
+  if(absorb(shard, status)) return true;
+
+  if(WIFEXITED(wstatus)) {
+    status = TestcaseStatus(SSTR("Worker exited with code " << WEXITSTATUS(wstatus) << " without publishing results"));
+  }
+  else {
+    status = TestcaseStatus(SSTR("Worker killed by signal " << WTERMSIG(wstatus) << " without publishing results"));
+  }
+
+  status.seal(SSTR("Shard " << shard));
+  return true;
+}
+
+TestcaseStatus ShardCoordinator::collect(std::chrono::milliseconds timeout) {
+  eost_assert(!token.empty());
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::vector<TestcaseStatus> results(shards);
+  std::vector<bool> done(shards, false);
+  size_t remaining = shards;
+
+  while(remaining > 0) {
+    for(size_t shard = 0; shard < shards; shard++) {
+      if(done[shard]) continue;
+
+      // Local workers are waited for until they exit, so that none is left
+      // behind as a zombie
+      bool local = shard < workers.size() && workers[shard] > 0;
+      bool finished = local ? reaped(shard, results[shard]) : absorb(shard, results[shard]);
+
+      if(finished) {
+        done[shard] = true;
+        remaining--;
+      }
+    }
+
+    if(remaining == 0) break;
+
+    if(timeout.count() != 0 && std::chrono::steady_clock::now() - start >= timeout) {
+      for(size_t shard = 0; shard < shards; shard++) {
+        if(done[shard]) continue;
+
+        if(shard < workers.size() && workers[shard] > 0) {
+          kill(workers[shard], SIGKILL);
+          waitpid(workers[shard], nullptr, 0);
+          workers[shard] = 0;
+        }
+
+        results[shard] = TestcaseStatus(SSTR("Timed out waiting for results in " << resultPath(shard)));
+        results[shard].seal(SSTR("Shard " << shard));
+      }
+
+      break;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+
+  TestcaseStatus merged;
+  for(size_t shard = 0; shard < shards; shard++) {
+    merged.addChild(std::move(results[shard]));
+  }
+
+  merged.seal(SSTR("Collect results of " << shards << " shards from " << spool), std::chrono::steady_clock::now() - start);
+  return merged;
+}
@@ -0,0 +1,111 @@
+// ----------------------------------------------------------------------
+// File: ShardCoordinator.hh
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#ifndef EOSTESTER_SHARD_COORDINATOR_H
+#define EOSTESTER_SHARD_COORDINATOR_H
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include "TestcaseStatus.hh"
+
+namespace eostest {
+
+//------------------------------------------------------------------------------
+// Splits a run across several worker processes, one per shard, and merges
+// their outcomes into a single report.
+//
+// Workers publish their TestcaseStatus tree, along with every latency
+// histogram they recorded, as one file per shard in a spool directory.
+// Workers may be forked locally through launch(), or started by hand on
+// other hosts, as long as they all see the same spool directory - ie on a
+// shared filesystem. collect() waits for every shard to report in.
+//
+// Each run of the coordinator claims the spool under a fresh token, which
+// workers echo in their results. Results left over by any earlier run are
+// thus never taken for this one's.
+//------------------------------------------------------------------------------
+class ShardCoordinator {
+public:
+  ShardCoordinator(const std::string &spool, size_t shards);
+
+  std::string resultPath(size_t shard) const;
+  std::string runPath() const;
+
+  //----------------------------------------------------------------------------
+  // Coordinator side: claim the spool for a new run, before launch() or
+  // collect(). Fails if another coordinator holds it, or one which never
+  // finished left its claim behind.
+  //----------------------------------------------------------------------------
+  bool claim(std::string &error);
+
+  //----------------------------------------------------------------------------
+  // Give up the claim once done. With removeSpool, for a spool directory the
+  // caller created just for this run, delete the results and the directory
+  // as well.
+  //----------------------------------------------------------------------------
+  void release(bool removeSpool);
+
+  //----------------------------------------------------------------------------
+  // Worker side: publish the outcome of the given shard, along with the
+  // contents of LatencyRecorder. The file appears atomically, so collect()
+  // never sees a partial one. Waits until a coordinator has claimed the
+  // spool, if none has yet.
+  //----------------------------------------------------------------------------
+  bool publish(size_t shard, const TestcaseStatus &status) const;
+
+  //----------------------------------------------------------------------------
+  // Fork one local worker process per shard, with clean latency counters.
+  // Its exit code is whatever the given function returns. Results of any
+  // previous run in the spool directory are removed first. If a fork fails,
+  // the workers forked so far are killed and reaped.
+  //
+  // Fork before starting any threads: only the calling thread lives on in
+  // the children.
+  //----------------------------------------------------------------------------
+  bool launch(const std::function<int(size_t shard)> &worker);
+
+  //----------------------------------------------------------------------------
+  // Wait for the results of all shards, and merge them: one child per shard
+  // in the returned status, and all latencies into LatencyRecorder. Shards
+  // whose local worker died without publishing are reported as failed, as
+  // are those still missing after timeout, if non-zero.
+  //----------------------------------------------------------------------------
+  TestcaseStatus collect(std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
+
+private:
+  bool readToken(std::string &token) const;
+  bool absorb(size_t shard, TestcaseStatus &status) const;
+  bool reaped(size_t shard, TestcaseStatus &status);
+
+  std::string spool;
+  size_t shards;
+  std::string token;
+  std::vector<pid_t> workers;
+};
+
+}
+
+#endif
@@ -132,3 +132,78 @@ std::string TestcaseStatus::prettyPrint(size_t level) const {
 
   return ss.str();
 }
+
+//------------------------------------------------------------------------------
+// Strings are length-prefixed, so they may contain anything, newlines
+// included: "<length>:<bytes>".
+//------------------------------------------------------------------------------
+static void writeString(std::ostringstream &ss, const std::string &str) {
+  ss << str.size() << ":" << str;
+}
+
+static bool readString(std::istringstream &ss, std::string &str) {
+  size_t length;
+  if(!(ss >> length) || ss.get() != ':') return false;
+
+  str.resize(length);
+  return (bool) ss.read(&str[0], length);
+}
+
+void TestcaseStatus::serialize(std::ostringstream &ss) const {
+  writeString(ss, description);
+  ss << " " << duration.count() << " " << errors.size();
+
+  for(size_t i = 0; i < errors.size(); i++) {
+    ss << " ";
+    writeString(ss, errors[i]);
+  }
+
+  ss << " " << children.size();
+  for(size_t i = 0; i < children.size(); i++) {
+    ss << " ";
+    children[i].serialize(ss);
+  }
+}
+
+std::string TestcaseStatus::serialize() const {
+  std::ostringstream ss;
+  serialize(ss);
+  return ss.str();
+}
+
+bool TestcaseStatus::deserialize(std::istringstream &ss, TestcaseStatus &out, size_t nesting) {
+  // Garbage could otherwise have us recurse until the stack runs out
+  if(nesting > 1000) return false;
+
+  out = TestcaseStatus();
+  if(!readString(ss, out.description)) return false;
+
+  int64_t dur;
+  size_t count;
+  if(!(ss >> dur >> count)) return false;
+  out.duration = std::chrono::nanoseconds(dur);
+
+  for(size_t i = 0; i < count; i++) {
+    std::string err;
+    if(ss.get() != ' ' || !readString(ss, err)) return false;
+    out.errors.emplace_back(std::move(err));
+  }
+
+  if(!(ss >> count)) return false;
+
+  for(size_t i = 0; i < count; i++) {
+    TestcaseStatus child;
+    if(ss.get() != ' ' || !deserialize(ss, child, nesting + 1)) return false;
+    out.children.emplace_back(std::move(child));
+  }
+
+  return true;
+}
+
+bool TestcaseStatus::deserialize(const std::string &str, TestcaseStatus &out) {
+  std::istringstream ss(str);
+  if(!deserialize(ss, out, 0)) return false;
+
+  // Nothing may follow
+  return ss.peek() == std::istringstream::traits_type::eof();
+}
@@ -28,6 +28,7 @@
 #include <string>
 #include <chrono>
 #include <memory>
+#include <sstream>
 
 namespace eostest {
 
@@ -48,9 +49,19 @@ public:
   std::string& getDescription();
   std::string prettyPrint(size_t level = 1) const;
 
+  //----------------------------------------------------------------------------
+  // Lossless text form of the whole tree, for passing results between
+  // processes. deserialize() returns false on malformed input.
+  //----------------------------------------------------------------------------
+  std::string serialize() const;
+  static bool deserialize(const std::string &str, TestcaseStatus &out);
+
 private:
+  void serialize(std::ostringstream &ss) const;
+  static bool deserialize(std::istringstream &ss, TestcaseStatus &out, size_t nesting);
+
   std::string description;
-  std::chrono::nanoseconds duration;
+  std::chrono::nanoseconds duration {0};
 
   std::vector<std::string> errors;
   std::vector<TestcaseStatus> children;
@@ -22,10 +22,29 @@
  ************************************************************************/
 
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <unistd.h>
+#include <thread>
 #include "HashCalculator.hh"
 #include "Utils.hh"
+#include "utils/AsyncBudget.hh"
+#include "utils/CheckpointJournal.hh"
+#include "utils/ConcurrencyController.hh"
+#include "utils/ConnectionBalancer.hh"
+#include "utils/HandlerPool.hh"
+#include "utils/OperationPipeline.hh"
+#include "utils/LatencyHistogram.hh"
 #include "utils/ProgressTracker.hh"
 #include "utils/Sealing.hh"
+#include "utils/ShardCoordinator.hh"
+#include "utils/TestcaseStatus.hh"
+#include "XrdClConnectionPool.hh"
+#include "CommandLine.hh"
+#include "ContentBuffer.hh"
+#include "ContentGenerator.hh"
 #include "Macros.hh"
 #include <rang.hpp>
 using namespace eostest;
@@ -35,6 +54,22 @@ TEST(HashCalculator, BasicSanity) {
   ASSERT_EQ(hash, "1ab094d49f13d198d8e5a80d44e697bd82756ad63403ab75ffb7b5d6c8fcdac6");
 }
 
+TEST(HashCalculator, Checksums) {
+  ASSERT_EQ(HashCalculator::checksum("adler32", ContentBuffer("")), "00000001");
+  ASSERT_EQ(HashCalculator::checksum("adler32", ContentBuffer("Wikipedia")), "11e60398");
+  ASSERT_EQ(HashCalculator::checksum("crc32c", ContentBuffer("123456789")), "e3069283");
+  ASSERT_EQ(HashCalculator::checksum("md5", ContentBuffer("123456789")), "");
+
+  // Segment boundaries make no difference, and large inputs don't overflow
+  std::string large(100000, '\xff');
+  ContentBuffer split(large.substr(0, 7777));
+  split.append(large.substr(7777));
+
+  for(std::string type : {"adler32", "crc32c"}) {
+    ASSERT_EQ(HashCalculator::checksum(type, split), HashCalculator::checksum(type, ContentBuffer(large)));
+  }
+}
+
 TEST(Utils, chopPath) {
   ASSERT_EQ("/eos/some/path", chopPath("/eos/some/path/abc"));
 }
@@ -56,6 +91,587 @@ TEST(Utils, extractLineWithPrefix) {
   ASSERT_FALSE(extractLineWithPrefix(contents, 4, "FILENAME: ", extracted));
 }
 
+TEST(Utils, consumeLine) {
+  std::string_view contents = "abc\nFILENAME: adgfas\n\nasdfa";
+  std::string_view extracted;
+  size_t index = 0;
+
+  ASSERT_FALSE(consumeLine(contents, index, "FILENAME: ", extracted));
+  ASSERT_TRUE(consumeString(contents, index, "abc\n"));
+  ASSERT_TRUE(consumeLine(contents, index, "FILENAME: ", extracted));
+  ASSERT_EQ(extracted, "adgfas");
+  ASSERT_EQ(index, 21u);
+
+  // Empty lines don't count, and neither does one without newline
+  ASSERT_FALSE(consumeLine(contents, index, "", extracted));
+  index++;
+  ASSERT_FALSE(consumeLine(contents, index, "", extracted));
+  ASSERT_EQ(index, 22u);
+
+  ASSERT_FALSE(consumeString(contents, index, "asdfab"));
+  ASSERT_TRUE(consumeString(contents, index, "asdfa"));
+  ASSERT_FALSE(consumeString(contents, index, "\n"));
+}
+
+TEST(Utils, Varint) {
+  std::string encoded;
+  std::vector<uint64_t> values = {0, 1, 127, 128, 300, 16383, 16384, UINT32_MAX, UINT64_MAX};
+  for(uint64_t value : values) {
+    appendVarint(encoded, value);
+  }
+
+  ASSERT_EQ(encoded.substr(0, 5), std::string("\x00\x01\x7f\x80\x01", 5));
+
+  size_t index = 0;
+  for(uint64_t value : values) {
+    uint64_t decoded;
+    ASSERT_TRUE(consumeVarint(encoded, index, decoded));
+    ASSERT_EQ(decoded, value);
+  }
+
+  ASSERT_EQ(index, encoded.size());
+
+  uint64_t decoded;
+  ASSERT_FALSE(consumeVarint(encoded, index, decoded));
+  index = 0;
+  ASSERT_FALSE(consumeVarint("\x80\x80", index, decoded));
+  ASSERT_EQ(index, 0u);
+
+  std::string fixed;
+  appendFixed32(fixed, 0x01020304);
+  ASSERT_EQ(fixed, "\x04\x03\x02\x01");
+  ASSERT_EQ(decodeFixed32(fixed.data()), 0x01020304u);
+}
+
+TEST(Utils, parseCanonicalDecimal) {
+  uint64_t value;
+  ASSERT_TRUE(parseCanonicalDecimal("0", value));
+  ASSERT_EQ(value, 0u);
+  ASSERT_TRUE(parseCanonicalDecimal("1234567890123456789", value));
+  ASSERT_EQ(value, 1234567890123456789u);
+
+  ASSERT_FALSE(parseCanonicalDecimal("", value));
+  ASSERT_FALSE(parseCanonicalDecimal("012", value));
+  ASSERT_FALSE(parseCanonicalDecimal("+12", value));
+  ASSERT_FALSE(parseCanonicalDecimal(" 12", value));
+  ASSERT_FALSE(parseCanonicalDecimal("12a", value));
+  ASSERT_FALSE(parseCanonicalDecimal("12345678901234567890", value));
+}
+
+TEST(Utils, parseSize) {
+  uint64_t size;
+  ASSERT_TRUE(parseSize("4096", size));
+  ASSERT_EQ(size, 4096u);
+
+  ASSERT_TRUE(parseSize("4K", size));
+  ASSERT_EQ(size, 4096u);
+
+  ASSERT_TRUE(parseSize("3G", size));
+  ASSERT_EQ(size, 3ull * 1024 * 1024 * 1024);
+
+  ASSERT_FALSE(parseSize("", size));
+  ASSERT_FALSE(parseSize("G", size));
+  ASSERT_FALSE(parseSize("-1M", size));
+  ASSERT_FALSE(parseSize("12X", size));
+}
+
+TEST(Utils, splitURL) {
+  std::string host, path;
+  ASSERT_TRUE(splitURL("root://eospps.cern.ch//eos/some/path", host, path));
+  ASSERT_EQ(host, "root://eospps.cern.ch");
+  ASSERT_EQ(path, "/eos/some/path");
+
+  ASSERT_TRUE(splitURL("root://someuser@eospps.cern.ch:1095//eos/some/path?eos.ruid=0", host, path));
+  ASSERT_EQ(host, "root://eospps.cern.ch:1095");
+  ASSERT_EQ(path, "/eos/some/path?eos.ruid=0");
+
+  ASSERT_FALSE(splitURL("/eos/some/path", host, path));
+  ASSERT_FALSE(splitURL("root://eospps.cern.ch", host, path));
+  ASSERT_FALSE(splitURL("root:///eos/some/path", host, path));
+}
+
+TEST(XrdClConnectionPool, resolve) {
+  XrdClConnectionPool pool;
+
+  XrdClTarget target = pool.resolve(3, "root://eospps.cern.ch//eos/some/path?eos.ruid=0");
+  ASSERT_NE(target.endpoint, nullptr);
+  ASSERT_EQ(target.endpoint->prefix, "root://t3@eospps.cern.ch/");
+  ASSERT_EQ(target.url, "root://t3@eospps.cern.ch//eos/some/path?eos.ruid=0");
+  ASSERT_EQ(target.path, "/eos/some/path");
+
+  XrdClTarget target2 = pool.resolve(3, "root://eospps.cern.ch//eos/some/other/path");
+  ASSERT_EQ(target.endpoint, target2.endpoint);
+
+  XrdClTarget target3 = pool.resolve(4, "root://eospps.cern.ch//eos/some/other/path");
+  ASSERT_NE(target.endpoint, target3.endpoint);
+  ASSERT_EQ(pool.size(), 2u);
+
+  ASSERT_EQ(pool.resolve(3, "not-a-url").endpoint, nullptr);
+}
+
+TEST(PatternGenerator, RandomAccess) {
+  PatternGenerator generator(42, 1000);
+  ASSERT_EQ(generator.size(), 1000u);
+
+  std::string whole(1000, '\0');
+  generator.fill(0, &whole[0], whole.size());
+
+  // Unaligned chunks must agree with a single fill of the whole range
+  std::string pieces(1000, '\0');
+  for(size_t offset = 0; offset < 1000; offset += 37) {
+    size_t length = std::min<size_t>(37, 1000 - offset);
+    generator.fill(offset, &pieces[offset], length);
+  }
+
+  ASSERT_EQ(whole, pieces);
+
+  std::string other(1000, '\0');
+  PatternGenerator(43, 1000).fill(0, &other[0], other.size());
+  ASSERT_NE(whole, other);
+}
+
+TEST(ContentBuffer, Segments) {
+  ContentBuffer empty;
+  ASSERT_TRUE(empty.empty());
+  ASSERT_EQ(empty.toString(), "");
+
+  ContentBuffer buffer("abc");
+  ContentBuffer::Segment shared = std::make_shared<const std::string>("defg");
+  buffer.append(shared);
+  buffer.append(std::string());
+
+  ASSERT_EQ(buffer.size(), 7u);
+  ASSERT_EQ(buffer.getSegments().size(), 2u);
+  ASSERT_EQ(buffer.toString(), "abcdefg");
+
+  // Copies share the underlying segments
+  ContentBuffer copy = buffer;
+  ASSERT_EQ(copy.getSegments()[1].get(), shared.get());
+  ASSERT_EQ(HashCalculator::sha256("abc", "defg"), HashCalculator::sha256("abcdefg"));
+}
+
+TEST(GeneratorVerifier, Mismatch) {
+  std::shared_ptr<ContentGenerator> generator(new PatternGenerator(7, 100));
+  std::string contents(100, '\0');
+  generator->fill(0, &contents[0], contents.size());
+
+  GeneratorVerifier good(generator);
+  good.consume(contents.c_str(), 30);
+  good.consume(contents.c_str() + 30, 70);
+  ASSERT_TRUE(good.finish().ok());
+
+  GeneratorVerifier truncated(generator);
+  truncated.consume(contents.c_str(), 99);
+  ASSERT_FALSE(truncated.finish().ok());
+
+  GeneratorVerifier tooLong(generator);
+  tooLong.consume(contents.c_str(), 100);
+  tooLong.consume(contents.c_str(), 1);
+  ASSERT_FALSE(tooLong.finish().ok());
+
+  contents[57]++;
+  GeneratorVerifier corrupted(generator);
+  corrupted.consume(contents.c_str(), 100);
+  TestcaseStatus status = corrupted.finish();
+  ASSERT_FALSE(status.ok());
+  ASSERT_NE(status.toString().find("offset 57"), std::string::npos);
+}
+
+namespace {
+  struct PooledObject : public PooledAllocation {
+    char payload[100];
+  };
+
+  struct LargePooledObject : public PooledAllocation {
+    char payload[HandlerPool::kMaxPooledSize + 1];
+  };
+}
+
+TEST(HandlerPool, Recycling) {
+  HandlerPool::Stats before = HandlerPool::getStats();
+
+  PooledObject *first = new PooledObject();
+  delete first;
+
+  // Same thread, same size class: the block comes straight back
+  PooledObject *second = new PooledObject();
+  ASSERT_EQ(first, second);
+  delete second;
+
+  LargePooledObject *large = new LargePooledObject();
+  delete large;
+
+  HandlerPool::Stats after = HandlerPool::getStats();
+  ASSERT_EQ(after.allocations - before.allocations, 3u);
+  ASSERT_EQ(after.deallocations - before.deallocations, 3u);
+  ASSERT_LE(after.heapAllocations - before.heapAllocations, 2u);
+}
+
+TEST(HandlerPool, CrossThread) {
+  std::vector<PooledObject*> objects;
+  for(size_t i = 0; i < 3 * HandlerPool::kThreadCacheLimit; i++) {
+    objects.push_back(new PooledObject());
+  }
+
+  // Freed on a different thread - the blocks must find their way back
+  std::thread([&objects]() {
+    for(PooledObject *obj : objects) delete obj;
+  }).join();
+
+  HandlerPool::Stats before = HandlerPool::getStats();
+  for(size_t i = 0; i < objects.size(); i++) {
+    objects[i] = new PooledObject();
+  }
+
+  HandlerPool::Stats after = HandlerPool::getStats();
+  ASSERT_EQ(after.heapAllocations, before.heapAllocations);
+
+  for(PooledObject *obj : objects) delete obj;
+}
+
+TEST(LatencyHistogram, Buckets) {
+  for(uint64_t value : {0ull, 1ull, 31ull, 32ull, 33ull, 63ull, 64ull, 1000ull, 123456789ull, (1ull << 40) - 1}) {
+    size_t index = LatencyHistogram::bucketIndex(value);
+    ASSERT_LT(index, LatencyHistogram::kBuckets);
+    ASSERT_LE(LatencyHistogram::bucketLowerBound(index), value);
+    ASSERT_GE(LatencyHistogram::bucketUpperBound(index), value);
+  }
+
+  // Relative error stays within one sub-bucket
+  size_t index = LatencyHistogram::bucketIndex(123456789);
+  double width = LatencyHistogram::bucketUpperBound(index) - LatencyHistogram::bucketLowerBound(index);
+  ASSERT_LT(width / 123456789, 1.0 / LatencyHistogram::kSubBuckets);
+
+  ASSERT_EQ(LatencyHistogram::bucketIndex(1ull << 50), LatencyHistogram::kBuckets - 1);
+}
+
+TEST(LatencyHistogram, Percentiles) {
+  LatencyHistogram histogram;
+  ASSERT_EQ(histogram.percentile(0.5), std::chrono::nanoseconds(0));
+
+  for(int i = 1; i <= 1000; i++) {
+    histogram.record(std::chrono::microseconds(i));
+  }
+
+  ASSERT_EQ(histogram.count(), 1000u);
+  ASSERT_EQ(histogram.max(), std::chrono::microseconds(1000));
+
+  ASSERT_NEAR(histogram.percentile(0.50).count(), 500000, 500000 / 32);
+  ASSERT_NEAR(histogram.percentile(0.99).count(), 990000, 990000 / 32);
+  ASSERT_EQ(histogram.percentile(1.0), std::chrono::microseconds(1000));
+
+  LatencyHistogram other;
+  other.record(std::chrono::seconds(2));
+  histogram.merge(other);
+
+  ASSERT_EQ(histogram.count(), 1001u);
+  ASSERT_EQ(histogram.max(), std::chrono::seconds(2));
+  ASSERT_NEAR(histogram.percentile(0.50).count(), 500000, 500000 / 32);
+}
+
+TEST(LatencyRecorder, MultipleThreads) {
+  LatencyRecorder::reset();
+
+  std::vector<std::thread> threads;
+  for(size_t i = 0; i < 4; i++) {
+    threads.emplace_back([]() {
+      for(size_t j = 0; j < 1000; j++) {
+        LatencyRecorder::record(OpType::kRmdir, std::chrono::milliseconds(1));
+      }
+    });
+  }
+
+  LatencyRecorder::record(OpType::kRmdir, std::chrono::milliseconds(5));
+  for(std::thread &thread : threads) thread.join();
+
+  // Exited threads still count
+  LatencyHistogram histogram = LatencyRecorder::snapshot(OpType::kRmdir);
+  ASSERT_EQ(histogram.count(), 4001u);
+  ASSERT_EQ(histogram.max(), std::chrono::milliseconds(5));
+  ASSERT_EQ(LatencyRecorder::snapshot(OpType::kMkdir).count(), 0u);
+
+  std::string report = LatencyRecorder::report(std::chrono::seconds(1));
+  ASSERT_NE(report.find("rmdir"), std::string::npos);
+  ASSERT_EQ(report.find("mkdir"), std::string::npos);
+
+  LatencyRecorder::reset();
+  ASSERT_EQ(LatencyRecorder::snapshot(OpType::kRmdir).count(), 0u);
+}
+
+TEST(LatencyHistogram, Serialization) {
+  LatencyHistogram histogram;
+  histogram.record(std::chrono::nanoseconds(7));
+  histogram.record(std::chrono::microseconds(300));
+  histogram.record(std::chrono::microseconds(300));
+  histogram.record(std::chrono::seconds(2));
+
+  LatencyHistogram parsed;
+  ASSERT_TRUE(LatencyHistogram::deserialize(histogram.serialize(), parsed));
+  ASSERT_EQ(parsed.count(), 4u);
+  ASSERT_EQ(parsed.max(), std::chrono::seconds(2));
+  ASSERT_EQ(parsed.percentile(0.5), histogram.percentile(0.5));
+  ASSERT_EQ(parsed.serialize(), histogram.serialize());
+
+  ASSERT_TRUE(LatencyHistogram::deserialize("0", parsed));
+  ASSERT_EQ(parsed.count(), 0u);
+
+  ASSERT_FALSE(LatencyHistogram::deserialize("", parsed));
+  ASSERT_FALSE(LatencyHistogram::deserialize("5 3", parsed));
+  ASSERT_FALSE(LatencyHistogram::deserialize("5 999999:1", parsed));
+}
+
+TEST(ConcurrencyController, FixedWindow) {
+  ConcurrencyController::Options opts;
+  opts.maxWindow = 3;
+  ConcurrencyController controller(opts);
+
+  ASSERT_FALSE(controller.isAdaptive());
+  ASSERT_EQ(controller.getWindow(), 3u);
+
+  for(size_t i = 0; i < 3; i++) controller.acquire();
+  ASSERT_EQ(controller.getInFlight(), 3u);
+
+  // The fourth acquire has to wait for a release
+  std::atomic<bool> acquired {false};
+  std::thread waiter([&]() {
+    controller.acquire();
+    acquired = true;
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  ASSERT_FALSE(acquired);
+
+  controller.release(std::chrono::seconds(100));
+  waiter.join();
+  ASSERT_TRUE(acquired);
+  ASSERT_EQ(controller.getWindow(), 3u);
+}
+
+TEST(ConcurrencyController, Adaptive) {
+  ConcurrencyController::Options opts;
+  opts.maxWindow = 1000;
+  opts.initialWindow = 4;
+  opts.minEpochSamples = 10;
+  opts.targetP99 = std::chrono::milliseconds(10);
+  ConcurrencyController controller(opts);
+  ASSERT_TRUE(controller.isAdaptive());
+
+  auto runOps = [&](size_t count, std::chrono::nanoseconds latency) {
+    for(size_t i = 0; i < count; i++) {
+      controller.acquire();
+      controller.release(latency);
+    }
+  };
+
+  // Fast responses: slow start all the way up to the limit
+  runOps(5000, std::chrono::milliseconds(1));
+  ASSERT_EQ(controller.getWindow(), 1000u);
+
+  // Slow responses: back off
+  runOps(5000, std::chrono::milliseconds(50));
+  ASSERT_LT(controller.getWindow(), 100u);
+
+  // Fast again: additive increase instead of doubling. The first epoch may
+  // still contain slow samples from before.
+  size_t before = controller.getWindow();
+  runOps(2 * std::max<size_t>(opts.minEpochSamples, before), std::chrono::milliseconds(1));
+  ASSERT_GT(controller.getWindow(), before);
+  ASSERT_LE(controller.getWindow(), before + 2 * std::max<size_t>(1, before / 16));
+
+  ASSERT_NE(controller.describe().find("settled at"), std::string::npos);
+}
+
+TEST(OperationPipeline, CompletionOrder) {
+  ConcurrencyController::Options opts;
+  opts.maxWindow = 2;
+  OperationPipeline pipeline(opts);
+
+  folly::Promise<TestcaseStatus> slow, fast, third;
+  pipeline.submit([&]() { return slow.getFuture(); });
+  pipeline.submit([&]() { return fast.getFuture(); });
+
+  // The window is full - completing the second operation must free up a
+  // slot, even though the first one is still pending.
+  fast.setValue(TestcaseStatus("fast failed"));
+  pipeline.submit([&]() { return third.getFuture(); });
+  ASSERT_EQ(pipeline.getController().getInFlight(), 2u);
+
+  std::thread completer([&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    third.setValue(TestcaseStatus());
+    slow.setValue(TestcaseStatus("slow failed"));
+  });
+
+  TestcaseStatus status = pipeline.drain();
+  completer.join();
+
+  ASSERT_FALSE(status.ok());
+  ASSERT_NE(status.toString().find("fast failed"), std::string::npos);
+  ASSERT_NE(status.toString().find("slow failed"), std::string::npos);
+  ASSERT_EQ(pipeline.getController().getInFlight(), 0u);
+}
+
+TEST(AsyncBudget, HandsOverSlots) {
+  AsyncBudget budget(2);
+
+  folly::Future<folly::Unit> first = budget.acquire();
+  folly::Future<folly::Unit> second = budget.acquire();
+  folly::Future<folly::Unit> third = budget.acquire();
+  ASSERT_TRUE(first.isReady());
+  ASSERT_TRUE(second.isReady());
+  ASSERT_FALSE(third.isReady());
+  ASSERT_EQ(budget.getWaiting(), 1u);
+
+  budget.release();
+  ASSERT_TRUE(third.isReady());
+  ASSERT_EQ(budget.getInUse(), 2u);
+  ASSERT_EQ(budget.getWaiting(), 0u);
+
+  budget.release();
+  budget.release();
+  ASSERT_EQ(budget.getInUse(), 0u);
+
+  folly::Promise<int> promise;
+  folly::Future<int> result = budget.run([&promise]() { return promise.getFuture(); });
+  ASSERT_EQ(budget.getInUse(), 1u);
+  promise.setValue(5);
+  ASSERT_EQ(std::move(result).get(), 5);
+  ASSERT_EQ(budget.getInUse(), 0u);
+}
+
+TEST(AsyncBudget, ReleasesOnFailure) {
+  AsyncBudget budget(1);
+
+  folly::Promise<int> promise;
+  folly::Future<int> failed = budget.run([&promise]() { return promise.getFuture(); });
+  promise.setException(std::runtime_error("request failed"));
+  ASSERT_THROW(std::move(failed).get(), std::runtime_error);
+  ASSERT_EQ(budget.getInUse(), 0u);
+
+  folly::Future<int> thrown = budget.run([]() -> folly::Future<int> {
+    throw std::runtime_error("could not issue");
+  });
+
+  ASSERT_THROW(std::move(thrown).get(), std::runtime_error);
+  ASSERT_EQ(budget.getInUse(), 0u);
+
+  // The single slot is still there
+  ASSERT_EQ(budget.run([]() { return folly::makeFuture<int>(3); }).get(), 3);
+}
+
+TEST(AsyncBudget, InlineCompletionsDontRecurse) {
+  AsyncBudget budget(1);
+
+  folly::Promise<int> first;
+  folly::Future<int> head = budget.run([&first]() { return first.getFuture(); });
+
+  // Each of these completes inline as soon as it's issued, releasing its
+  // slot from within the continuation of the previous one
+  std::vector<folly::Future<int>> queued;
+  for(int i = 0; i < 200000; i++) {
+    queued.emplace_back(budget.run([i]() { return folly::makeFuture(i); }));
+  }
+
+  ASSERT_EQ(budget.getWaiting(), 200000u);
+  first.setValue(-1);
+  ASSERT_EQ(std::move(head).get(), -1);
+
+  for(int i = 0; i < 200000; i++) {
+    ASSERT_EQ(std::move(queued[i]).get(), i);
+  }
+
+  ASSERT_EQ(budget.getInUse(), 0u);
+  ASSERT_EQ(budget.getWaiting(), 0u);
+}
+
+TEST(CheckpointJournal, Replay) {
+  char tmpl[] = "/tmp/eos-tester-journal-XXXXXX";
+  int fd = mkstemp(tmpl);
+  ASSERT_GE(fd, 0);
+  close(fd);
+  std::string path = tmpl;
+
+  {
+    CheckpointJournal journal;
+    ASSERT_TRUE(journal.open(path, "run 1", 100, false).ok());
+    ASSERT_EQ(journal.getRecovered(), 0u);
+
+    std::vector<std::thread> threads;
+    for(size_t t = 0; t < 4; t++) {
+      threads.emplace_back([&journal, t]() {
+        for(uint64_t key = t; key < 100; key += 8) {
+          journal.record(key);
+        }
+      });
+    }
+
+    for(std::thread &thread : threads) {
+      thread.join();
+    }
+
+    ASSERT_FALSE(journal.contains(0));
+  }
+
+  {
+    CheckpointJournal journal;
+    ASSERT_TRUE(journal.open(path, "run 1", 100, true).ok());
+    ASSERT_EQ(journal.getRecovered(), 52u);
+
+    for(uint64_t key = 0; key < 100; key++) {
+      ASSERT_EQ(journal.contains(key), key % 8 < 4) << key;
+    }
+
+    ASSERT_FALSE(journal.contains(100));
+    journal.record(4);
+  }
+
+  CheckpointJournal journal;
+  ASSERT_FALSE(journal.open(path, "run 2", 100, true).ok());
+  ASSERT_FALSE(journal.open(path, "run 1", 200, true).ok());
+
+  ASSERT_TRUE(journal.open(path, "run 1", 100, true).ok());
+  ASSERT_EQ(journal.getRecovered(), 53u);
+  ASSERT_TRUE(journal.contains(4));
+
+  // Not resuming starts afresh
+  ASSERT_TRUE(journal.open(path, "run 2", 100, false).ok());
+  ASSERT_EQ(journal.getRecovered(), 0u);
+  ASSERT_FALSE(journal.contains(4));
+
+  ASSERT_EQ(std::remove(path.c_str()), 0);
+}
+
+TEST(ConnectionBalancer, Policies) {
+  PlacementPolicy policy;
+  ASSERT_TRUE(parsePlacementPolicy("least-loaded", policy));
+  ASSERT_EQ(policy, PlacementPolicy::kLeastLoaded);
+  ASSERT_FALSE(parsePlacementPolicy("random", policy));
+
+  ConnectionBalancer roundRobin(4, PlacementPolicy::kRoundRobin);
+  std::set<size_t> seen;
+  for(size_t i = 0; i < 4; i++) seen.insert(roundRobin.pick("/eos/a"));
+  ASSERT_EQ(seen, std::set<size_t>({1, 2, 3, 4}));
+
+  ConnectionBalancer subtree(8, PlacementPolicy::kSubtree);
+  size_t id = subtree.pick("/eos/a/b");
+  for(size_t i = 0; i < 10; i++) ASSERT_EQ(subtree.pick("/eos/a/b"), id);
+
+  // Connection 1 is busy, 2 is idle: the next few go to 2
+  ConnectionBalancer leastLoaded(2, PlacementPolicy::kLeastLoaded);
+  ASSERT_EQ(leastLoaded.pick(""), 1u);
+  ASSERT_EQ(leastLoaded.pick(""), 2u);
+  leastLoaded.completed(2, std::chrono::milliseconds(1), true);
+  ASSERT_EQ(leastLoaded.pick(""), 2u);
+  leastLoaded.completed(2, std::chrono::milliseconds(3), false);
+  ASSERT_EQ(leastLoaded.getInFlight(1), 1u);
+  ASSERT_EQ(leastLoaded.getInFlight(2), 0u);
+  ASSERT_EQ(leastLoaded.pick(""), 2u);
+
+  std::vector<std::string> report = leastLoaded.report(std::chrono::seconds(1));
+  ASSERT_EQ(report.size(), 2u);
+  ASSERT_EQ(report[1], "Connection 2 :: 2 ops, 2.0 ops/s, mean latency 2.00 ms, 1 failed");
+}
+
 TEST(Utils, ProgressTracker) {
   ProgressTracker tracker(100);
 
@@ -139,6 +755,102 @@ TEST(Utils, Sealing) {
   ASSERT_TRUE(st.getDuration() > std::chrono::microseconds(500));
 }
 
+TEST(Utils, TestcaseStatusSerialization) {
+  TestcaseStatus child("error: with\nnewline");
+  child.addError("");
+  child.seal("child 1:2", std::chrono::milliseconds(3));
+
+  TestcaseStatus grandchild;
+  grandchild.seal("grandchild");
+  child.addChild(std::move(grandchild));
+
+  TestcaseStatus root;
+  root.addChild(std::move(child));
+  root.seal("root", std::chrono::seconds(1));
+
+  TestcaseStatus parsed;
+  ASSERT_TRUE(TestcaseStatus::deserialize(root.serialize(), parsed));
+  ASSERT_FALSE(parsed.ok());
+  ASSERT_EQ(parsed.getDescription(), "root");
+  ASSERT_EQ(parsed.getDuration(), std::chrono::seconds(1));
+  ASSERT_EQ(parsed.prettyPrint(), root.prettyPrint());
+  ASSERT_EQ(parsed.serialize(), root.serialize());
+
+  std::string serialized = root.serialize();
+  ASSERT_FALSE(TestcaseStatus::deserialize(serialized.substr(0, serialized.size() - 1), parsed));
+  ASSERT_FALSE(TestcaseStatus::deserialize(serialized + " ", parsed));
+  ASSERT_FALSE(TestcaseStatus::deserialize("10:short", parsed));
+}
+
+TEST(ShardCoordinator, ForkAndCollect) {
+  char tmpl[] = "/tmp/eos-tester-test-XXXXXX";
+  ASSERT_NE(mkdtemp(tmpl), nullptr);
+  std::string spool = tmpl;
+
+  LatencyRecorder::reset();
+
+  ShardCoordinator coordinator(spool, 4);
+  std::string error;
+  ASSERT_TRUE(coordinator.claim(error)) << error;
+
+  // Only one coordinator at a time
+  ShardCoordinator other(spool, 4);
+  ASSERT_FALSE(other.claim(error));
+  ASSERT_NE(error.find("is claimed by another coordinator"), std::string::npos) << error;
+
+  ASSERT_TRUE(coordinator.launch([&](size_t shard) {
+    // Shard 3 dies without publishing
+    if(shard == 3) return 7;
+
+    LatencyRecorder::record(OpType::kRm, std::chrono::milliseconds(shard + 1));
+
+    TestcaseStatus status;
+    if(shard == 1) status.addError("shard 1 failed");
+    status.seal(SSTR("Shard " << shard << " work"));
+
+    return coordinator.publish(shard, status) ? 0 : 1;
+  }));
+
+  TestcaseStatus merged = coordinator.collect();
+  ASSERT_FALSE(merged.ok());
+
+  std::string report = merged.prettyPrint();
+  ASSERT_NE(report.find("Shard 0 work"), std::string::npos);
+  ASSERT_NE(report.find("shard 1 failed"), std::string::npos);
+  ASSERT_NE(report.find("Shard 2 work"), std::string::npos);
+  ASSERT_NE(report.find("Worker exited with code 7 without publishing results"), std::string::npos);
+
+  LatencyHistogram histogram = LatencyRecorder::snapshot(OpType::kRm);
+  ASSERT_EQ(histogram.count(), 3u);
+  ASSERT_EQ(histogram.max(), std::chrono::milliseconds(3));
+
+  coordinator.release(false);
+
+  // The results are still there, but a coordinator for remote workers
+  // doesn't take them for those of its own run
+  LatencyRecorder::reset();
+  ShardCoordinator remote(spool, 3);
+  ASSERT_TRUE(remote.claim(error)) << error;
+  merged = remote.collect(std::chrono::milliseconds(200));
+  ASSERT_NE(merged.prettyPrint().find("Timed out waiting for results"), std::string::npos);
+  ASSERT_EQ(LatencyRecorder::snapshot(OpType::kRm).count(), 0u);
+
+  // Those published by a worker of this run are
+  TestcaseStatus status;
+  status.seal("Remote shard 1 work");
+  ShardCoordinator worker(spool, 3);
+  ASSERT_TRUE(worker.publish(1, status));
+
+  merged = remote.collect(std::chrono::milliseconds(200));
+  ASSERT_NE(merged.prettyPrint().find("Remote shard 1 work"), std::string::npos);
+  ASSERT_EQ(merged.prettyPrint().find("Shard 0 work"), std::string::npos);
+
+  // Removes the directory along with the results
+  remote.release(true);
+  ASSERT_NE(access(spool.c_str(), F_OK), 0);
+  LatencyRecorder::reset();
+}
+
 TEST(Utils, VisualTestSuccess) {
   rang::setControlMode(rang::control::Force);
 
@@ -167,3 +879,28 @@ TEST(Utils, VisualTestFailure) {
 
   std::cout << status.prettyPrint() << std::endl;
 }
+
+//------------------------------------------------------------------------------
+// Parse the given arguments as eos-tester would, minus the program name.
+//------------------------------------------------------------------------------
+static void parseCommandLine(CommandLine &cli, std::vector<std::string> args) {
+  // CLI11 takes them in reverse
+  std::reverse(args.begin(), args.end());
+  cli.app.parse(args);
+}
+
+TEST(CommandLine, TargetP99) {
+  CommandLine build;
+  parseCommandLine(build, {"tree", "--build", "root://localhost//eos", "--target-p99", "20"});
+  ASSERT_TRUE(*build.buildOpt);
+  ASSERT_EQ(build.targetP99, 20);
+
+  CommandLine destroy;
+  parseCommandLine(destroy, {"tree", "--destroy", "root://localhost//eos", "--target-p99", "50"});
+  ASSERT_TRUE(*destroy.destroyOpt);
+  ASSERT_EQ(destroy.targetP99, 50);
+
+  // Validation has no concurrency to adapt
+  CommandLine validate;
+  ASSERT_THROW(parseCommandLine(validate, {"tree", "--validate", "root://localhost//eos", "--target-p99", "50"}), CLI::ExcludesError);
+}
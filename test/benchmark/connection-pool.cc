@@ -0,0 +1,73 @@
+// ----------------------------------------------------------------------
+// File: connection-pool.cc
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <iostream>
+#include "XrdClConnectionPool.hh"
+#include "Macros.hh"
+using namespace eostest;
+
+namespace {
+  const size_t kIterations = 200000;
+
+  std::string pathForIteration(size_t i) {
+    return SSTR("root://eos.example.cern.ch//eos/test/tree/abcde/fghij/f" << i);
+  }
+
+  void report(const std::string &name, std::chrono::nanoseconds elapsed) {
+    std::cout << name << ": " << elapsed.count() / kIterations << " ns/op" << std::endl;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Per-op client setup, as done by XrdClExecutor before the introduction of
+// XrdClConnectionPool: parse the URL twice, construct a fresh FileSystem.
+//------------------------------------------------------------------------------
+TEST(ConnectionPoolBenchmark, PerOpSetup) {
+  auto start = std::chrono::steady_clock::now();
+
+  for(size_t i = 0; i < kIterations; i++) {
+    XrdCl::URL url(pathForIteration(i));
+    url.SetUserName(SSTR("t" << (i % 32)));
+
+    XrdCl::URL ur(url.GetURL());
+    XrdCl::FileSystem fs(ur.GetURL());
+    ASSERT_FALSE(ur.GetPath().empty());
+  }
+
+  report("Per-op FileSystem and URL parsing", std::chrono::steady_clock::now() - start);
+}
+
+TEST(ConnectionPoolBenchmark, PooledSetup) {
+  XrdClConnectionPool pool;
+  auto start = std::chrono::steady_clock::now();
+
+  for(size_t i = 0; i < kIterations; i++) {
+    XrdClTarget target = pool.resolve(i % 32, pathForIteration(i));
+    ASSERT_FALSE(target.path.empty());
+  }
+
+  report("Pooled FileSystem and URL prefix", std::chrono::steady_clock::now() - start);
+  ASSERT_EQ(pool.size(), 32u);
+}
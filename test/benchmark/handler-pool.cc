@@ -0,0 +1,110 @@
+// ----------------------------------------------------------------------
+// File: handler-pool.cc
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "utils/HandlerPool.hh"
+using namespace eostest;
+
+namespace {
+  const size_t kIterations = 1000000;
+  const size_t kBatch = 1000;
+
+  // Roughly the size of an OpenHandler
+  struct PlainHandler {
+    virtual ~PlainHandler() {}
+    char payload[120];
+  };
+
+  struct PooledHandler : public PooledAllocation {
+    virtual ~PooledHandler() {}
+    char payload[120];
+  };
+
+  //----------------------------------------------------------------------------
+  // Mimic the XrdCl callback chain: one thread allocates handlers, another
+  // deletes them once the "response" arrives.
+  //----------------------------------------------------------------------------
+  template<typename T>
+  std::chrono::nanoseconds allocateHereFreeThere() {
+    std::mutex mtx;
+    std::vector<std::vector<T*>> batches;
+    bool done = false;
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::thread freer([&]() {
+      while(true) {
+        std::vector<std::vector<T*>> mine;
+
+        {
+          std::lock_guard<std::mutex> lock(mtx);
+          mine.swap(batches);
+          if(mine.empty() && done) return;
+        }
+
+        for(auto &batch : mine) {
+          for(T *obj : batch) delete obj;
+        }
+      }
+    });
+
+    for(size_t i = 0; i < kIterations; i += kBatch) {
+      std::vector<T*> batch;
+      batch.reserve(kBatch);
+      for(size_t j = 0; j < kBatch; j++) batch.push_back(new T());
+
+      std::lock_guard<std::mutex> lock(mtx);
+      batches.emplace_back(std::move(batch));
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      done = true;
+    }
+
+    freer.join();
+    return std::chrono::steady_clock::now() - start;
+  }
+
+  void report(const std::string &name, std::chrono::nanoseconds elapsed) {
+    std::cout << name << ": " << elapsed.count() / kIterations << " ns/op" << std::endl;
+  }
+}
+
+TEST(HandlerPoolBenchmark, SystemAllocator) {
+  report("new / delete across threads", allocateHereFreeThere<PlainHandler>());
+}
+
+TEST(HandlerPoolBenchmark, Pooled) {
+  HandlerPool::Stats before = HandlerPool::getStats();
+  report("HandlerPool across threads", allocateHereFreeThere<PooledHandler>());
+
+  HandlerPool::Stats after = HandlerPool::getStats();
+  std::cout << "Allocations from the system allocator: " << after.heapAllocations - before.heapAllocations
+            << " out of " << kIterations << std::endl;
+}
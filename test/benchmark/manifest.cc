@@ -0,0 +1,144 @@
+// ----------------------------------------------------------------------
+// File: manifest.cc
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <set>
+#include <XrdCl/XrdClXRootDResponses.hh>
+#include "BinaryManifestView.hh"
+#include "Manifest.hh"
+#include "Utils.hh"
+using namespace eostest;
+
+namespace {
+  const size_t kEntries = 100000;
+
+  std::vector<std::string> randomNames(size_t count) {
+    std::mt19937 generator(42);
+    std::vector<std::string> names;
+    for(size_t i = 0; i < count; i++) {
+      names.emplace_back(getRandomAlphanumericBytes(5, generator));
+    }
+
+    return names;
+  }
+
+  template<typename F>
+  std::chrono::nanoseconds measure(F func) {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    return std::chrono::steady_clock::now() - start;
+  }
+
+  void report(const std::string &name, std::chrono::nanoseconds elapsed) {
+    std::cout << name << ": " << elapsed.count() / kEntries << " ns/entry" << std::endl;
+  }
+}
+
+TEST(ManifestBenchmark, Build) {
+  std::vector<std::string> names = randomNames(kEntries);
+
+  std::set<std::string> baseline;
+  report("std::set, one at a time", measure([&]() {
+    for(const std::string &name : names) baseline.insert(name);
+  }));
+
+  Manifest manifest;
+  report("Manifest, in bulk", measure([&]() {
+    manifest.tryAddFiles(names);
+  }));
+
+  ASSERT_EQ(manifest.fileCount(), baseline.size());
+  std::cout << "Manifest: " << manifest.getFiles().memoryUsage() / manifest.fileCount() << " bytes/entry, a std::set node alone is "
+            << sizeof(std::string) + 4 * sizeof(void*) << std::endl;
+}
+
+TEST(ManifestBenchmark, SerializeAndParse) {
+  Manifest manifest("/eos/benchmark/MANIFEST");
+  manifest.tryAddFiles(randomNames(kEntries));
+
+  std::string contents;
+  report("Serialize", measure([&]() {
+    contents = manifest.toString();
+  }));
+
+  Manifest parsed;
+  report("Parse and verify", measure([&]() {
+    ASSERT_TRUE(parsed.parse(contents));
+  }));
+
+  ASSERT_EQ(parsed.fileCount(), manifest.fileCount());
+}
+
+TEST(ManifestBenchmark, BinaryFormat) {
+  Manifest manifest("/eos/benchmark/MANIFEST");
+  manifest.tryAddFiles(randomNames(kEntries));
+
+  std::string contents;
+  report("Serialize, binary", measure([&]() {
+    contents = manifest.toBinary();
+  }));
+
+  std::cout << "Binary: " << contents.size() << " bytes, text: " << manifest.toString().size() << " bytes" << std::endl;
+
+  Manifest parsed;
+  report("Parse and verify, binary", measure([&]() {
+    ASSERT_TRUE(parsed.parse(contents));
+  }));
+
+  ASSERT_EQ(parsed.fileCount(), manifest.fileCount());
+
+  // Lookups straight from the buffer, without materializing anything
+  BinaryManifestView view;
+  ASSERT_TRUE(view.open(contents));
+
+  size_t found = 0;
+  std::string_view checksum;
+  report("Lookup in place, binary", measure([&]() {
+    for(std::string_view name : manifest.getFiles()) {
+      found += view.findFile(name, checksum);
+    }
+  }));
+
+  ASSERT_EQ(found, manifest.fileCount());
+}
+
+TEST(ManifestBenchmark, CrossCheckDirlist) {
+  Manifest manifest("/eos/benchmark/MANIFEST");
+  manifest.tryAddFiles(randomNames(kEntries));
+
+  // Listings come back in no particular order
+  std::vector<std::string> names(manifest.getFiles().begin(), manifest.getFiles().end());
+  std::shuffle(names.begin(), names.end(), std::mt19937(7));
+
+  XrdCl::DirectoryList dirlist;
+  for(const std::string &name : names) {
+    dirlist.Add(new XrdCl::DirectoryList::ListEntry("", name, new XrdCl::StatInfo("0", 0, 0, 0)));
+  }
+
+  report("Cross-check against dirlist", measure([&]() {
+    ASSERT_TRUE(manifest.crossCheckDirlist(dirlist).ok());
+  }));
+}
@@ -0,0 +1,66 @@
+// ----------------------------------------------------------------------
+// File: pipeline.cc
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <iostream>
+#include "InMemoryExecutor.hh"
+#include "testcases/TreeBuilder.hh"
+#include "testcases/TreeValidator.hh"
+#include "utils/ProgressTracker.hh"
+using namespace eostest;
+
+//------------------------------------------------------------------------------
+// Pipeline ceiling: build and validate a tree against a zero-cost server.
+// Whatever rate we get here is the best the tester can ever do.
+//------------------------------------------------------------------------------
+TEST(PipelineBenchmark, ZeroCostServer) {
+  InMemoryExecutor executor;
+  ASSERT_TRUE(executor.mkdir(1, "root://localhost//eos").get().ok());
+
+  TreeBuilder::Options opts;
+  opts.baseUrl = "root://localhost//eos";
+  opts.seed = 42;
+  opts.depth = 10;
+  opts.files = 200000;
+
+  ProgressTracker buildTracker(opts.files);
+  TreeBuilder builder(executor, opts, &buildTracker);
+
+  auto start = std::chrono::steady_clock::now();
+  TestcaseStatus acc = builder.initialize().get();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  ASSERT_TRUE(acc.ok());
+
+  std::cout << "Build: " << opts.files << " files in " << elapsed.count() << " sec, " << opts.files / elapsed.count() << " puts/s" << std::endl;
+
+  ProgressTracker validateTracker(-1);
+  TreeValidator validator(executor, opts.baseUrl, &validateTracker);
+
+  start = std::chrono::steady_clock::now();
+  acc = validator.initialize().get();
+  elapsed = std::chrono::steady_clock::now() - start;
+  ASSERT_TRUE(acc.ok());
+
+  std::cout << "Validate: " << validateTracker.getSuccessful() << " files in " << elapsed.count() << " sec, " << validateTracker.getSuccessful() / elapsed.count() << " gets/s" << std::endl;
+}
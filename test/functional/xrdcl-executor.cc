@@ -24,38 +24,76 @@
 #include <gtest/gtest.h>
 #include "XrdClExecutor.hh"
 #include "testcases/TreeBuilder.hh"
+#include "testcases/TreeDestroyer.hh"
 #include "testcases/TreeValidator.hh"
+#include "testcases/LargeFileTester.hh"
 #include "utils/ProgressTracker.hh"
 #include "utils/ProgressTicker.hh"
 using namespace eostest;
 
 TEST(XrdClExecutor, BasicSanity) {
-  TestcaseStatus status = XrdClExecutor::mkdir(1, "root://eospps.cern.ch//eos/user/gbitzes/eostester/sanity/").get();
+  XrdClExecutor executor;
+
+  TestcaseStatus status = executor.mkdir(1, "root://eospps.cern.ch//eos/user/gbitzes/eostester/sanity/").get();
   ASSERT_TRUE(status.ok()) << status.toString();
 
-  status = XrdClExecutor::rm(1, "root://eospps.cern.ch//eos/user/gbitzes/eostester/sanity/f1").get();
+  status = executor.rm(1, "root://eospps.cern.ch//eos/user/gbitzes/eostester/sanity/f1").get();
   ASSERT_FALSE(status.ok());
 
-  status = XrdClExecutor::put(1, "root://eospps.cern.ch//eos/user/gbitzes/eostester/sanity/f1", "adfasf").get();
+  status = executor.put(1, "root://eospps.cern.ch//eos/user/gbitzes/eostester/sanity/f1", "adfasf").get();
   ASSERT_TRUE(status.ok());
 
-  ReadStatus rstatus = XrdClExecutor::get(1, "root://eospps.cern.ch//eos/user/gbitzes/eostester/sanity/f1").get();
+  ReadStatus rstatus = executor.get(1, "root://eospps.cern.ch//eos/user/gbitzes/eostester/sanity/f1").get();
   ASSERT_TRUE(rstatus.ok());
   ASSERT_EQ(rstatus.contents, "adfasf");
   ASSERT_EQ(rstatus.getDescription(), "xroot::get on 'root://eospps.cern.ch//eos/user/gbitzes/eostester/sanity/f1'");
 
-  DirListStatus lstatus = XrdClExecutor::dirList(1, "root://eospps.cern.ch//eos/user/gbitzes/eostester/sanity").get();
+  DirListStatus lstatus = executor.dirList(1, "root://eospps.cern.ch//eos/user/gbitzes/eostester/sanity").get();
   ASSERT_TRUE(lstatus.ok());
   ASSERT_EQ(lstatus.contents->GetSize(), 1u);
   ASSERT_EQ(lstatus.contents->At(0)->GetName(), "f1");
   ASSERT_FALSE(lstatus.contents->At(0)->GetStatInfo()->TestFlags(XrdCl::StatInfo::IsDir));
 
-  status = XrdClExecutor::rm(1, "root://eospps.cern.ch///eos/user/gbitzes/eostester/sanity/f1").get();
+  status = executor.rm(1, "root://eospps.cern.ch///eos/user/gbitzes/eostester/sanity/f1").get();
+  ASSERT_TRUE(status.ok());
+}
+
+TEST(XrdClExecutor, LargeFileRoundtrip) {
+  XrdClExecutor executor;
+  executor.rm(1, "root://eospps.cern.ch//eos/user/gbitzes/eostester/sanity/large").get();
+
+  LargeFileTester::Options opts;
+  opts.url = "root://eospps.cern.ch//eos/user/gbitzes/eostester/sanity/large";
+  opts.size = 10 * 1024 * 1024 + 123;
+  opts.streaming.chunkSize = 256 * 1024;
+  opts.streaming.inflight = 8;
+
+  LargeFileTester tester(executor, opts);
+  TestcaseStatus status = tester.write().get();
+  ASSERT_TRUE(status.ok()) << status.toString();
+
+  status = tester.read().get();
+  ASSERT_TRUE(status.ok()) << status.toString();
+
+  // get() must return the whole thing, not just the first few kilobytes
+  ReadStatus rstatus = executor.get(1, opts.url).get();
+  ASSERT_TRUE(rstatus.ok()) << rstatus.toString();
+  ASSERT_EQ(rstatus.contents.size(), opts.size);
+
+  status = executor.rm(1, opts.url).get();
   ASSERT_TRUE(status.ok());
 }
 
 TEST(TreeValidator, BasicSanity) {
-  ASSERT_EQ(system("gfal-rm -r root://eospps.cern.ch///eos/user/gbitzes/eostester/tree-simple/"), 0);
+  XrdClExecutor executor;
+
+  TreeDestroyer::Options destroyerOpts;
+  destroyerOpts.url = "root://eospps.cern.ch//eos/user/gbitzes/eostester/tree-simple";
+  ASSERT_TRUE(executor.mkdirs(1, destroyerOpts.url).get().ok());
+  TreeDestroyer destroyer(executor, destroyerOpts);
+  TestcaseStatus acc = destroyer.initialize().get();
+  std::cout << acc.prettyPrint();
+  ASSERT_TRUE(acc.ok());
 
   TreeBuilder::Options opts;
   opts.baseUrl = "root://eospps.cern.ch//eos/user/gbitzes/eostester/tree-simple";
@@ -64,17 +102,17 @@ TEST(TreeValidator, BasicSanity) {
   opts.files = 100;
 
   ProgressTracker tracker2(opts.files);
-  TreeBuilder builder(opts, &tracker2);
+  TreeBuilder builder(executor, opts, &tracker2);
   ProgressTicker ticker2(tracker2);
 
-  TestcaseStatus acc = builder.initialize().get();
+  acc = builder.initialize().get();
   ticker2.stop();
 
   std::cout << acc.prettyPrint();
   ASSERT_TRUE(acc.ok());
 
   ProgressTracker tracker(-1);
-  TreeValidator validator(opts.baseUrl, &tracker);
+  TreeValidator validator(executor, opts.baseUrl, &tracker);
   ProgressTicker ticker(tracker);
   acc = validator.initialize().get();
 
@@ -22,7 +22,12 @@
  ************************************************************************/
 
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <map>
+#include <random>
+#include <set>
 #include "HierarchyBuilder.hh"
+#include "SelfCheckedFile.hh"
 using namespace eostest;
 
 TEST(HierachyBuilder, BasicSanity) {
@@ -46,3 +51,467 @@ TEST(HierachyBuilder, BasicSanity) {
 
   ASSERT_EQ(files, 50);
 }
+
+TEST(HierachyBuilder, ContentTemplates) {
+  HierarchyConstructionOptions options;
+  options.base = "/eos/test";
+  options.seed = 42;
+  options.depth = 5;
+  options.files = 2000;
+  options.contentTemplates = true;
+
+  HierarchyBuilder builder(options);
+  HierarchyEntry entry;
+
+  std::set<const std::string*> bodies;
+  size_t selfChecked = 0;
+
+  while(builder.next(entry)) {
+    if(entry.dir || entry.fullPath.find("/MANIFEST") != std::string::npos) continue;
+
+    ASSERT_TRUE(SelfCheckedFile::validate(entry.contents.toString(), entry.fullPath).ok());
+    bodies.insert(entry.contents.getSegments()[1].get());
+    selfChecked++;
+  }
+
+  // At most 256 distinct file sizes, thus at most 256 distinct bodies
+  ASSERT_GT(selfChecked, 1000u);
+  ASSERT_LE(bodies.size(), 256u);
+}
+
+static std::vector<std::pair<std::string, std::string>> walk(HierarchyBuilder &builder) {
+  std::vector<std::pair<std::string, std::string>> entries;
+  HierarchyEntry entry;
+
+  while(builder.next(entry)) {
+    entries.emplace_back(entry.fullPath, entry.dir ? "<dir>" : entry.contents.toString());
+  }
+
+  return entries;
+}
+
+TEST(HierachyBuilder, Seekable) {
+  HierarchyConstructionOptions options;
+  options.base = "/eos/test";
+  options.seed = 7;
+  options.depth = 4;
+  options.files = 500;
+  options.checksumType = "adler32";
+
+  HierarchyBuilder sequential(options);
+  ASSERT_EQ(sequential.getTotalFiles(), 500u);
+
+  std::vector<HierarchyEntry> all;
+  HierarchyEntry entry;
+  uint64_t files = 0;
+
+  while(sequential.next(entry)) {
+    if(!entry.dir) {
+      ASSERT_EQ(entry.index, files);
+      files++;
+    }
+
+    all.push_back(entry);
+  }
+
+  ASSERT_EQ(files, 500u);
+
+  // Jump straight to every file
+  for(const HierarchyEntry &expected : all) {
+    if(expected.dir) continue;
+
+    HierarchyBuilder builder(options);
+    ASSERT_TRUE(builder.seek(expected.index));
+    ASSERT_TRUE(builder.next(entry));
+
+    if(expected.fullPath.find("/MANIFEST") != std::string::npos && expected.index != 0) {
+      // Starts with the directory entry of that MANIFEST
+      ASSERT_TRUE(entry.dir);
+      ASSERT_EQ(entry.index, expected.index);
+      ASSERT_TRUE(builder.next(entry));
+    }
+
+    ASSERT_EQ(entry.fullPath, expected.fullPath);
+    ASSERT_EQ(entry.contents.toString(), expected.contents.toString());
+  }
+
+  HierarchyBuilder outOfRange(options);
+  ASSERT_FALSE(outOfRange.seek(500));
+
+  // Shards of the walk add up to the whole
+  HierarchyBuilder whole(options);
+  std::vector<std::pair<std::string, std::string>> expected = walk(whole);
+  std::vector<std::pair<std::string, std::string>> joined;
+
+  std::vector<uint64_t> bounds = {0, 1, 2, 37, 38, 250, 499, 500};
+  for(size_t i = 0; i + 1 < bounds.size(); i++) {
+    HierarchyBuilder shard(options);
+    ASSERT_TRUE(shard.seek(bounds[i]));
+    shard.setEnd(bounds[i+1]);
+
+    std::vector<std::pair<std::string, std::string>> entries = walk(shard);
+    joined.insert(joined.end(), entries.begin(), entries.end());
+  }
+
+  ASSERT_EQ(joined, expected);
+}
+
+TEST(HierachyBuilder, WideDirectory) {
+  HierarchyConstructionOptions options;
+  options.base = "/eos/test";
+  options.seed = 7;
+  options.depth = 1;
+  options.files = 60000;
+  options.shape.subdirs = Distribution::fixed(20000);
+  options.shape.files = Distribution::fixed(10);
+
+  // Walking and seeking stay linear in the width of the root
+  HierarchyBuilder sequential(options);
+  std::vector<HierarchyEntry> sampled;
+  HierarchyEntry entry;
+  uint64_t files = 0;
+  size_t dirs = 0;
+
+  while(sequential.next(entry)) {
+    if(entry.dir) {
+      dirs++;
+      continue;
+    }
+
+    ASSERT_EQ(entry.index, files);
+    if(files % 4999 == 0 || files == options.files - 1) sampled.push_back(entry);
+    files++;
+  }
+
+  ASSERT_EQ(files, options.files);
+  ASSERT_EQ(dirs, 20000u);
+
+  for(const HierarchyEntry &expected : sampled) {
+    HierarchyBuilder builder(options);
+    ASSERT_TRUE(builder.seek(expected.index));
+    ASSERT_TRUE(builder.next(entry));
+    if(entry.dir) {
+      ASSERT_TRUE(builder.next(entry));
+    }
+
+    ASSERT_EQ(entry.index, expected.index);
+    ASSERT_EQ(entry.fullPath, expected.fullPath);
+  }
+}
+
+TEST(HierachyBuilder, SeekToDirectory) {
+  HierarchyConstructionOptions options;
+  options.base = "/eos/test";
+  options.seed = 3;
+  options.depth = 5;
+  options.files = 300;
+
+  HierarchyBuilder sequential(options);
+  std::vector<std::pair<std::string, std::string>> all = walk(sequential);
+
+  size_t checked = 0;
+  for(size_t i = 0; i < all.size(); i++) {
+    if(all[i].second != "<dir>") continue;
+
+    // The subtree is everything following the directory entry, with the
+    // directory path as prefix
+    std::vector<std::pair<std::string, std::string>> expected;
+    for(size_t j = i + 1; j < all.size() && all[j].first.compare(0, all[i].first.size() + 1, all[i].first + "/") == 0; j++) {
+      expected.push_back(all[j]);
+    }
+
+    HierarchyBuilder builder(options);
+    ASSERT_TRUE(builder.seekToDirectory(all[i].first));
+    ASSERT_EQ(walk(builder), expected);
+    checked++;
+  }
+
+  ASSERT_GT(checked, 5u);
+
+  HierarchyBuilder root(options);
+  ASSERT_TRUE(root.seekToDirectory("/eos/test/"));
+  ASSERT_EQ(walk(root), all);
+
+  HierarchyBuilder missing(options);
+  ASSERT_FALSE(missing.seekToDirectory("/eos/test/nonexistent"));
+  ASSERT_FALSE(missing.seekToDirectory("/eos/other"));
+}
+
+TEST(Distribution, Parsing) {
+  Distribution distr;
+  std::string error;
+
+  ASSERT_TRUE(Distribution::parse("7", distr, error));
+  ASSERT_EQ(distr.describe(), "fixed:7");
+  ASSERT_TRUE(Distribution::parse("fixed:4K", distr, error));
+  ASSERT_EQ(distr.describe(), "fixed:4096");
+  ASSERT_TRUE(Distribution::parse("uniform:1-1K", distr, error));
+  ASSERT_EQ(distr.describe(), "uniform:1-1024");
+  ASSERT_TRUE(Distribution::parse("lognormal:4K,1.5", distr, error));
+  ASSERT_EQ(distr.describe(), "lognormal:4096,1.5");
+  ASSERT_EQ(distr.maximum(), Distribution::kMaxSample);
+  ASSERT_TRUE(Distribution::parse("lognormal:4K,1.5,1M", distr, error));
+  ASSERT_EQ(distr.describe(), "lognormal:4096,1.5,1048576");
+  ASSERT_EQ(distr.maximum(), 1048576u);
+  ASSERT_TRUE(Distribution::parse("zipf:100,1.2", distr, error));
+  ASSERT_EQ(distr.describe(), "zipf:100,1.2");
+
+  for(const char *invalid : {"", "uniform:5-1", "uniform:5", "lognormal:4K", "lognormal:4K,-1", "lognormal:4K,1,",
+        "zipf:0,1", "normal:1,2", "fixed:", "file:/nonexistent/histogram"}) {
+    ASSERT_FALSE(Distribution::parse(invalid, distr, error)) << invalid;
+    ASSERT_FALSE(error.empty());
+  }
+
+  ASSERT_TRUE(Distribution::parseHistogram("# size weight\n1 10\n\n100-200 5 # tail\n1M 0\n", distr, error)) << error;
+  ASSERT_EQ(distr.maximum(), 200u);
+  ASSERT_FALSE(Distribution::parseHistogram("1 10\n2\n", distr, error));
+  ASSERT_NE(error.find("line 2"), std::string::npos);
+  ASSERT_FALSE(Distribution::parseHistogram("# nothing\n5 0\n", distr, error));
+
+  ASSERT_TRUE(Distribution().empty());
+  ASSERT_FALSE(distr.empty());
+}
+
+TEST(Distribution, Sampling) {
+  std::mt19937 generator(1);
+  std::string error;
+
+  Distribution fixed = Distribution::fixed(3);
+  Distribution uniform = Distribution::uniform(10, 20);
+  Distribution zipf = Distribution::zipf(50, 1.0);
+  Distribution histogram;
+  ASSERT_TRUE(Distribution::parseHistogram("1 1\n1000-1999 3\n", histogram, error));
+
+  std::vector<uint64_t> zipfCounts(51);
+  size_t large = 0;
+
+  for(size_t i = 0; i < 20000; i++) {
+    ASSERT_EQ(fixed.sample(generator), 3u);
+
+    uint64_t value = uniform.sample(generator);
+    ASSERT_TRUE(10 <= value && value <= 20);
+
+    value = zipf.sample(generator);
+    ASSERT_TRUE(1 <= value && value <= 50);
+    zipfCounts[value]++;
+
+    value = histogram.sample(generator);
+    ASSERT_TRUE(value == 1 || (1000 <= value && value <= 1999)) << value;
+    if(value != 1) large++;
+  }
+
+  // 1 is twice as likely as 2, ten times as likely as 10
+  ASSERT_GT(zipfCounts[1], zipfCounts[2] * 3 / 2);
+  ASSERT_GT(zipfCounts[1], zipfCounts[10] * 5);
+  ASSERT_TRUE(14000 < large && large < 16000) << large;
+
+  // Half the samples below the median
+  Distribution logNormal = Distribution::logNormal(4096, 2.0);
+  size_t below = 0;
+  for(size_t i = 0; i < 20000; i++) {
+    if(logNormal.sample(generator) < 4096) below++;
+  }
+
+  ASSERT_TRUE(9000 < below && below < 11000) << below;
+
+  // Clamped, not redrawn
+  Distribution capped = Distribution::logNormal(4096, 2.0, 8192);
+  size_t atCeiling = 0;
+  for(size_t i = 0; i < 20000; i++) {
+    uint64_t value = capped.sample(generator);
+    ASSERT_LE(value, 8192u);
+    if(value == 8192) atCeiling++;
+  }
+
+  ASSERT_TRUE(6500 < atCeiling && atCeiling < 8000) << atCeiling;
+}
+
+TEST(TreeShape, FileSizeLimit) {
+  TreeShape shape;
+  ASSERT_EQ(shape.check(), "");
+
+  shape.fileSize = Distribution::fixed(TreeShape::kMaxFileSize);
+  ASSERT_EQ(shape.check(), "");
+
+  shape.fileSize = Distribution::logNormal(1024 * 1024 * 1024, 2.0);
+  ASSERT_NE(shape.check().find("at most"), std::string::npos);
+
+  shape.fileSize = Distribution::logNormal(1024 * 1024 * 1024, 2.0, TreeShape::kMaxFileSize);
+  ASSERT_EQ(shape.check(), "");
+
+  shape.fileSize = Distribution::uniform(1, TreeShape::kMaxFileSize + 1);
+  ASSERT_NE(shape.check(), "");
+}
+
+TEST(HierachyBuilder, Shapes) {
+  HierarchyConstructionOptions options;
+  options.base = "/eos/test";
+  options.seed = 5;
+  options.depth = 10;
+  options.files = 3000;
+  options.shape.subdirs = Distribution::fixed(2);
+  options.shape.files = Distribution::fixed(1000);
+  options.shape.fileSize = Distribution::fixed(10);
+  options.shape.depth = Distribution::uniform(1, 2);
+
+  HierarchyBuilder builder(options);
+  HierarchyEntry entry;
+  std::map<std::string, size_t> filesPerDirectory;
+  std::set<size_t> sizes;
+  std::map<std::string, uint64_t> fileSizes;
+  std::vector<Manifest> manifests;
+  size_t maxDepth = 0;
+
+  while(builder.next(entry)) {
+    size_t depth = std::count(entry.fullPath.begin(), entry.fullPath.end(), '/') - 2;
+    if(entry.dir) {
+      maxDepth = std::max(maxDepth, depth);
+      continue;
+    }
+
+    filesPerDirectory[entry.fullPath.substr(0, entry.fullPath.find_last_of('/'))]++;
+    if(entry.fullPath.find("/MANIFEST") == std::string::npos) {
+      sizes.insert(entry.contents.size() - entry.fullPath.size());
+      fileSizes[entry.fullPath] = entry.contents.size();
+    }
+    else {
+      manifests.emplace_back();
+      ASSERT_TRUE(manifests.back().parse(entry.contents.toString()));
+    }
+  }
+
+  // A few huge directories
+  ASSERT_EQ(filesPerDirectory["/eos/test"], 1001u);
+  ASSERT_LE(maxDepth, 2u);
+  ASSERT_LE(filesPerDirectory.size(), 7u);
+
+  // Same number of random bytes everywhere
+  ASSERT_EQ(sizes.size(), 1u);
+
+  // Sizes recorded in the MANIFESTs follow the shape, too
+  for(const Manifest &manifest : manifests) {
+    std::string directory = manifest.getFilename().substr(0, manifest.getFilename().find_last_of('/'));
+    ASSERT_EQ(manifest.getSizes().size(), manifest.fileCount());
+
+    for(auto it = manifest.getSizes().begin(); it != manifest.getSizes().end(); it++) {
+      ASSERT_EQ(fileSizes[directory + "/" + it->first], it->second) << it->first;
+    }
+  }
+
+  // Shape doesn't get in the way of seeking
+  HierarchyBuilder whole(options);
+  std::vector<std::pair<std::string, std::string>> expected = walk(whole);
+  std::vector<std::pair<std::string, std::string>> joined;
+
+  std::vector<uint64_t> bounds = {0, 999, 1001, 1500, 2002, 3000};
+  for(size_t i = 0; i + 1 < bounds.size(); i++) {
+    HierarchyBuilder shard(options);
+    ASSERT_TRUE(shard.seek(bounds[i]));
+    shard.setEnd(bounds[i+1]);
+
+    std::vector<std::pair<std::string, std::string>> entries = walk(shard);
+    joined.insert(joined.end(), entries.begin(), entries.end());
+  }
+
+  ASSERT_EQ(joined, expected);
+}
+
+TEST(HierachyBuilder, ShardedManifests) {
+  HierarchyConstructionOptions options;
+  options.base = "/eos/test";
+  options.seed = 3;
+  options.depth = 2;
+  options.files = 3000;
+  options.checksumType = "crc32c";
+  options.shape.subdirs = Distribution::uniform(0, 150);
+  options.shape.files = Distribution::uniform(0, 400);
+  options.manifestShardSize = 100;
+
+  HierarchyBuilder builder(options);
+  HierarchyEntry entry;
+  std::map<std::string, std::set<std::string>> directories;
+  std::map<std::string, std::string> contents;
+  uint64_t files = 0;
+
+  while(builder.next(entry)) {
+    if(entry.dir) {
+      directories[entry.fullPath];
+      continue;
+    }
+
+    ASSERT_EQ(entry.index, files);
+    files++;
+    contents[entry.fullPath] = entry.contents.toString();
+  }
+
+  ASSERT_EQ(files, 3000u);
+  directories["/eos/test"];
+  size_t sharded = 0;
+
+  for(auto it = directories.begin(); it != directories.end(); it++) {
+    const std::string &path = it->first;
+
+    // Everything in this directory, as generated
+    std::set<std::string> expected;
+    for(auto other = contents.lower_bound(path + "/"); other != contents.end() && other->first.compare(0, path.size() + 1, path + "/") == 0; other++) {
+      std::string name = other->first.substr(path.size() + 1);
+      if(name.find('/') == std::string::npos) expected.insert(name);
+    }
+
+    for(auto other = directories.upper_bound(path); other != directories.end() && other->first.compare(0, path.size() + 1, path + "/") == 0; other++) {
+      std::string name = other->first.substr(path.size() + 1);
+      if(name.find('/') == std::string::npos) expected.insert(name);
+    }
+
+    Manifest manifest;
+    ASSERT_TRUE(manifest.parse(contents[path + "/MANIFEST"]));
+    size_t entries = expected.size() - 1 - manifest.getShards().size();
+    if(manifest.isSharded()) {
+      sharded++;
+    }
+    else {
+      ASSERT_LE(entries, 100u) << path;
+    }
+
+    for(const std::string &shardName : manifest.getShards()) {
+      Manifest shard;
+      ASSERT_TRUE(shard.parse(contents[path + "/" + shardName]));
+      ASSERT_EQ(shard.getFilename(), path + "/" + shardName);
+      ASSERT_LE(shard.fileCount() + shard.subdirCount(), 100u);
+      ASSERT_TRUE(manifest.absorbShard(shard));
+    }
+
+    // Index and shards together list exactly what's there, with checksums
+    std::set<std::string_view> listed(manifest.getFiles().begin(), manifest.getFiles().end());
+    listed.insert(manifest.getDirectories().begin(), manifest.getDirectories().end());
+    for(const std::string &name : expected) {
+      ASSERT_EQ(listed.count(name) == 1, !manifest.isManifestFile(name)) << path << "/" << name;
+    }
+
+    ASSERT_EQ(listed.size(), entries);
+
+    std::string checksum;
+    for(std::string_view file : manifest.getFiles()) {
+      ASSERT_TRUE(manifest.getChecksum(file, checksum));
+    }
+  }
+
+  ASSERT_GT(sharded, 0u);
+
+  // Shards of the walk still add up to the whole
+  HierarchyBuilder whole(options);
+  std::vector<std::pair<std::string, std::string>> expected = walk(whole);
+  std::vector<std::pair<std::string, std::string>> joined;
+
+  std::vector<uint64_t> bounds = {0, 1, 2, 5, 300, 1234, 2999, 3000};
+  for(size_t i = 0; i + 1 < bounds.size(); i++) {
+    HierarchyBuilder shard(options);
+    ASSERT_TRUE(shard.seek(bounds[i]));
+    shard.setEnd(bounds[i+1]);
+
+    std::vector<std::pair<std::string, std::string>> entries = walk(shard);
+    joined.insert(joined.end(), entries.begin(), entries.end());
+  }
+
+  ASSERT_EQ(joined, expected);
+}
@@ -0,0 +1,947 @@
+// ----------------------------------------------------------------------
+// File: in-memory-executor.cc
+// Author: Georgios Bitzes - CERN
+// ----------------------------------------------------------------------
+
+/************************************************************************
+ * eos-tester - a tool for stress testing EOS instances                 *
+ * Copyright (C) 2018 CERN/Switzerland                                  *
+ *                                                                      *
+ * This program is free software: you can redistribute it and/or modify *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.*
+ ************************************************************************/
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include "InMemoryExecutor.hh"
+#include "BinaryManifestView.hh"
+#include "HierarchyBuilder.hh"
+#include "SelfCheckedFile.hh"
+#include "Macros.hh"
+#include "testcases/TreeBuilder.hh"
+#include "testcases/TreeDestroyer.hh"
+#include "testcases/TreeValidator.hh"
+#include "testcases/LargeFileTester.hh"
+#include "utils/LatencyHistogram.hh"
+#include "utils/ProgressTracker.hh"
+using namespace eostest;
+
+//------------------------------------------------------------------------------
+// Options for a tree right under /eos
+//------------------------------------------------------------------------------
+static TreeBuilder::Options treeOptions(int32_t seed, size_t depth, size_t files) {
+  TreeBuilder::Options opts;
+  opts.baseUrl = "root://localhost//eos";
+  opts.seed = seed;
+  opts.depth = depth;
+  opts.files = files;
+  return opts;
+}
+
+//------------------------------------------------------------------------------
+// Create the base directory, and build the tree into it. Call through
+// ASSERT_NO_FATAL_FAILURE.
+//------------------------------------------------------------------------------
+static void buildTree(InMemoryExecutor &executor, const TreeBuilder::Options &opts, TestcaseStatus *status = nullptr) {
+  ASSERT_TRUE(executor.mkdirs(1, opts.baseUrl).get().ok());
+
+  TreeBuilder builder(executor, opts);
+  TestcaseStatus acc = builder.initialize().get();
+  ASSERT_TRUE(acc.ok()) << acc.prettyPrint();
+
+  if(status) *status = acc;
+}
+
+//------------------------------------------------------------------------------
+// Name of a file directly inside the given directory, MANIFEST aside. Empty
+// if there's none.
+//------------------------------------------------------------------------------
+static std::string pickFile(InMemoryExecutor &executor, const std::string &dir) {
+  DirListStatus lstatus = executor.dirList(1, dir).get();
+  if(!lstatus.ok()) return "";
+
+  std::string file;
+  for(size_t i = 0; i < lstatus.contents->GetSize(); i++) {
+    if(lstatus.contents->At(i)->GetName() != "MANIFEST" && !lstatus.contents->At(i)->GetStatInfo()->TestFlags(XrdCl::StatInfo::IsDir)) {
+      file = lstatus.contents->At(i)->GetName();
+    }
+  }
+
+  return file;
+}
+
+TEST(InMemoryExecutor, BasicSanity) {
+  InMemoryExecutor executor;
+
+  TestcaseStatus status = executor.mkdir(1, "root://localhost//eos/").get();
+  ASSERT_TRUE(status.ok()) << status.toString();
+
+  status = executor.mkdir(1, "root://localhost//eos/sanity/").get();
+  ASSERT_TRUE(status.ok()) << status.toString();
+
+  status = executor.mkdir(1, "root://localhost//eos/sanity").get();
+  ASSERT_FALSE(status.ok());
+
+  status = executor.mkdir(1, "root://localhost//eos/missing/dir").get();
+  ASSERT_FALSE(status.ok());
+
+  status = executor.rm(1, "root://localhost//eos/sanity/f1").get();
+  ASSERT_FALSE(status.ok());
+
+  status = executor.put(1, "root://localhost//eos/sanity/f1", "adfasf").get();
+  ASSERT_TRUE(status.ok());
+
+  status = executor.put(1, "root://localhost//eos/sanity/f1", "adfasf").get();
+  ASSERT_FALSE(status.ok());
+
+  ReadStatus rstatus = executor.get(1, "root://localhost//eos/sanity/f1").get();
+  ASSERT_TRUE(rstatus.ok());
+  ASSERT_EQ(rstatus.contents, "adfasf");
+  ASSERT_EQ(rstatus.getDescription(), "memory::get on 'root://localhost//eos/sanity/f1'");
+
+  DirListStatus lstatus = executor.dirList(1, "root://localhost//eos/sanity").get();
+  ASSERT_TRUE(lstatus.ok());
+  ASSERT_EQ(lstatus.contents->GetSize(), 1u);
+  ASSERT_EQ(lstatus.contents->At(0)->GetName(), "f1");
+  ASSERT_EQ(lstatus.contents->At(0)->GetStatInfo()->GetSize(), 6u);
+  ASSERT_FALSE(lstatus.contents->At(0)->GetStatInfo()->TestFlags(XrdCl::StatInfo::IsDir));
+
+  lstatus = executor.dirList(1, "root://localhost//eos").get();
+  ASSERT_TRUE(lstatus.ok());
+  ASSERT_EQ(lstatus.contents->GetSize(), 1u);
+  ASSERT_TRUE(lstatus.contents->At(0)->GetStatInfo()->TestFlags(XrdCl::StatInfo::IsDir));
+
+  status = executor.rmdir(1, "root://localhost//eos/sanity").get();
+  ASSERT_FALSE(status.ok());
+
+  status = executor.rm(1, "root://localhost//eos/sanity").get();
+  ASSERT_FALSE(status.ok());
+
+  status = executor.rm(1, "root://localhost///eos/sanity/f1").get();
+  ASSERT_TRUE(status.ok());
+
+  status = executor.rmdir(1, "root://localhost//eos/sanity").get();
+  ASSERT_TRUE(status.ok());
+
+  lstatus = executor.dirList(1, "root://localhost//eos").get();
+  ASSERT_TRUE(lstatus.ok());
+  ASSERT_EQ(lstatus.contents->GetSize(), 0u);
+}
+
+TEST(InMemoryExecutor, PutStream) {
+  InMemoryExecutor executor;
+
+  std::shared_ptr<ContentGenerator> generator(new PatternGenerator(3, 10000));
+  StreamingOptions opts;
+  opts.chunkSize = 333;
+  opts.inflight = 3;
+
+  TestcaseStatus status = executor.putStream(1, "root://localhost//large", generator, opts).get();
+  ASSERT_TRUE(status.ok()) << status.toString();
+
+  std::string expected(10000, '\0');
+  generator->fill(0, &expected[0], expected.size());
+
+  ReadStatus rstatus = executor.get(1, "root://localhost//large").get();
+  ASSERT_TRUE(rstatus.ok());
+  ASSERT_EQ(rstatus.contents, expected);
+}
+
+TEST(InMemoryExecutor, LargeFileWrite) {
+  InMemoryExecutor executor;
+
+  LargeFileTester::Options opts;
+  opts.url = "root://localhost//large";
+  opts.size = 1024 * 1024;
+  opts.streaming.chunkSize = 64 * 1024;
+
+  LargeFileTester tester(executor, opts);
+  TestcaseStatus status = tester.write().get();
+  ASSERT_TRUE(status.ok()) << status.toString();
+  ASSERT_NE(status.getDescription().find("MB/s"), std::string::npos);
+
+  // Already exists
+  ASSERT_FALSE(tester.write().get().ok());
+}
+
+TEST(InMemoryExecutor, LargeFileRead) {
+  InMemoryExecutor executor;
+
+  LargeFileTester::Options opts;
+  opts.url = "root://localhost//large";
+  opts.size = 1024 * 1024 + 17;
+  opts.streaming.chunkSize = 64 * 1024;
+
+  LargeFileTester tester(executor, opts);
+  ASSERT_FALSE(tester.read().get().ok());
+  ASSERT_TRUE(tester.write().get().ok());
+
+  TestcaseStatus status = tester.read().get();
+  ASSERT_TRUE(status.ok()) << status.toString();
+  ASSERT_NE(status.getDescription().find("Read large file"), std::string::npos);
+
+  // Different seed, same size: contents don't match
+  LargeFileTester::Options wrongSeed = opts;
+  wrongSeed.seed++;
+  ASSERT_FALSE(LargeFileTester(executor, wrongSeed).read().get().ok());
+
+  // Wrong size
+  LargeFileTester::Options wrongSize = opts;
+  wrongSize.size--;
+  ASSERT_FALSE(LargeFileTester(executor, wrongSize).read().get().ok());
+}
+
+TEST(InMemoryExecutor, Latency) {
+  InMemoryExecutor executor(std::chrono::milliseconds(5));
+
+  folly::Future<TestcaseStatus> fut = executor.mkdir(1, "root://localhost//eos");
+  ASSERT_FALSE(fut.isReady());
+
+  TestcaseStatus status = std::move(fut).get();
+  ASSERT_TRUE(status.ok());
+  ASSERT_TRUE(status.getDuration() >= std::chrono::milliseconds(5));
+
+  // Recorded in the mkdir histogram
+  LatencyHistogram histogram = LatencyRecorder::snapshot(OpType::kMkdir);
+  ASSERT_GE(histogram.count(), 1u);
+  ASSERT_GE(histogram.max(), std::chrono::milliseconds(5));
+}
+
+TEST(InMemoryExecutor, BuildAndValidateTree) {
+  InMemoryExecutor executor;
+  ASSERT_TRUE(executor.mkdir(1, "root://localhost//eos").get().ok());
+  ASSERT_TRUE(executor.mkdir(1, "root://localhost//eos/tree").get().ok());
+
+  TreeBuilder::Options opts;
+  opts.baseUrl = "root://localhost//eos/tree";
+  opts.seed = 42;
+  opts.depth = 5;
+  opts.files = 1000;
+
+  ProgressTracker buildTracker(opts.files);
+  TreeBuilder builder(executor, opts, &buildTracker);
+
+  TestcaseStatus acc = builder.initialize().get();
+  ASSERT_TRUE(acc.ok()) << acc.prettyPrint();
+  ASSERT_EQ(buildTracker.getSuccessful(), 1000);
+
+  ProgressTracker validateTracker(-1);
+  TreeValidator validator(executor, opts.baseUrl, &validateTracker);
+  acc = validator.initialize().get();
+  ASSERT_TRUE(acc.ok()) << acc.prettyPrint();
+  ASSERT_EQ(validateTracker.getFailed(), 0);
+}
+
+TEST(InMemoryExecutor, ValidateTreeWithMultipleWorkers) {
+  InMemoryExecutor executor(std::chrono::milliseconds(1));
+  TreeBuilder::Options opts = treeOptions(42, 6, 2000);
+  ASSERT_NO_FATAL_FAILURE(buildTree(executor, opts));
+
+  ProgressTracker singleTracker(-1);
+  TreeValidator single(executor, opts.baseUrl, &singleTracker);
+  TestcaseStatus acc = single.initialize().get();
+  ASSERT_TRUE(acc.ok()) << acc.prettyPrint();
+
+  // Every file must be visited exactly once, no matter who expands what
+  for(size_t workers : {2, 8, 64}) {
+    TreeValidator::Options validatorOpts;
+    validatorOpts.url = opts.baseUrl;
+    validatorOpts.workers = workers;
+
+    ProgressTracker tracker(-1);
+    TreeValidator validator(executor, validatorOpts, &tracker);
+    acc = validator.initialize().get();
+    ASSERT_TRUE(acc.ok()) << acc.prettyPrint();
+    ASSERT_EQ(tracker.getSuccessful(), singleTracker.getSuccessful());
+    ASSERT_EQ(tracker.getFailed(), 0);
+  }
+}
+
+TEST(InMemoryExecutor, ValidateTreeWithSmallBudget) {
+  InMemoryExecutor executor(std::chrono::milliseconds(1));
+  TreeBuilder::Options opts = treeOptions(42, 5, 300);
+  ASSERT_NO_FATAL_FAILURE(buildTree(executor, opts));
+
+  ProgressTracker unboundedTracker(-1);
+  TreeValidator unbounded(executor, opts.baseUrl, &unboundedTracker);
+  TestcaseStatus acc = unbounded.initialize().get();
+  ASSERT_TRUE(acc.ok()) << acc.prettyPrint();
+
+  // A single request in flight at a time, shared by several workers which
+  // each hold prefetched directories: must neither deadlock, nor skip anything
+  for(size_t workers : {1, 4}) {
+    TreeValidator::Options validatorOpts;
+    validatorOpts.url = opts.baseUrl;
+    validatorOpts.workers = workers;
+    validatorOpts.maxInflight = 1;
+    validatorOpts.lookahead = 2;
+
+    ProgressTracker tracker(-1);
+    TreeValidator validator(executor, validatorOpts, &tracker);
+    acc = validator.initialize().get();
+    ASSERT_TRUE(acc.ok()) << acc.prettyPrint();
+    ASSERT_EQ(tracker.getSuccessful(), unboundedTracker.getSuccessful());
+  }
+}
+
+TEST(InMemoryExecutor, MetadataOnlyValidation) {
+  InMemoryExecutor executor;
+  TreeBuilder::Options opts = treeOptions(42, 3, 100);
+  ASSERT_NO_FATAL_FAILURE(buildTree(executor, opts));
+
+  TreeValidator::Options validatorOpts;
+  validatorOpts.url = opts.baseUrl;
+  validatorOpts.metadataOnly = true;
+
+  LatencyRecorder::reset();
+  ProgressTracker tracker(-1);
+  TreeValidator validator(executor, validatorOpts, &tracker);
+  TestcaseStatus acc = validator.initialize().get();
+  ASSERT_TRUE(acc.ok()) << acc.prettyPrint();
+  ASSERT_GT(tracker.getSuccessful(), 0);
+
+  // Only MANIFESTs were read, one per directory listed
+  ASSERT_EQ(LatencyRecorder::snapshot(OpType::kGet).count(), LatencyRecorder::snapshot(OpType::kDirList).count());
+
+  // Truncate one file: contents are never read, but the size gives it away
+  std::string victim = pickFile(executor, "root://localhost//eos");
+  ASSERT_FALSE(victim.empty());
+  std::string victimUrl = "root://localhost//eos/" + victim;
+  ReadStatus original = executor.get(1, victimUrl).get();
+  ASSERT_TRUE(original.ok());
+
+  // Even a single missing byte, as the MANIFEST records the exact size
+  ASSERT_TRUE(executor.rm(1, victimUrl).get().ok());
+  ASSERT_TRUE(executor.put(1, victimUrl, ContentBuffer(original.contents.substr(0, original.contents.size() - 1))).get().ok());
+
+  TreeValidator again(executor, validatorOpts, nullptr);
+  acc = again.initialize().get();
+  ASSERT_FALSE(acc.ok());
+  ASSERT_NE(acc.prettyPrint().find(SSTR("is " << original.contents.size() - 1 << " bytes, MANIFEST records " << original.contents.size())),
+    std::string::npos) << acc.prettyPrint();
+
+  // A MANIFEST without sizes still gets the plausibility check
+  ReadStatus root = executor.get(1, "root://localhost//eos/MANIFEST").get();
+  ASSERT_TRUE(root.ok());
+  Manifest withSizes;
+  ASSERT_TRUE(withSizes.parse(root.contents));
+  ASSERT_FALSE(withSizes.getSizes().empty());
+
+  Manifest withoutSizes(withSizes.getFilename());
+  for(std::string_view file : withSizes.getFiles()) withoutSizes.tryAddFile(file);
+  for(std::string_view subdir : withSizes.getDirectories()) withoutSizes.tryAddSubdir(subdir);
+
+  ASSERT_TRUE(executor.rm(1, "root://localhost//eos/MANIFEST").get().ok());
+  ASSERT_TRUE(executor.put(1, "root://localhost//eos/MANIFEST", withoutSizes.toString()).get().ok());
+  ASSERT_TRUE(executor.rm(1, victimUrl).get().ok());
+  ASSERT_TRUE(executor.put(1, victimUrl, ContentBuffer("truncated")).get().ok());
+
+  TreeValidator legacy(executor, validatorOpts, nullptr);
+  acc = legacy.initialize().get();
+  ASSERT_FALSE(acc.ok());
+  ASSERT_NE(acc.prettyPrint().find("impossible for a self-checked-file"), std::string::npos) << acc.prettyPrint();
+}
+
+TEST(InMemoryExecutor, ServerChecksumValidation) {
+  InMemoryExecutor executor;
+  TreeBuilder::Options opts = treeOptions(42, 3, 100);
+  opts.checksumType = "adler32";
+  ASSERT_NO_FATAL_FAILURE(buildTree(executor, opts));
+
+  TreeValidator::Options validatorOpts;
+  validatorOpts.url = opts.baseUrl;
+  validatorOpts.serverChecksums = true;
+
+  LatencyRecorder::reset();
+  ProgressTracker tracker(-1);
+  TreeValidator validator(executor, validatorOpts, &tracker);
+  TestcaseStatus acc = validator.initialize().get();
+  ASSERT_TRUE(acc.ok()) << acc.prettyPrint();
+
+  // Every file checked by checksum, only MANIFESTs read
+  ASSERT_EQ(LatencyRecorder::snapshot(OpType::kChecksum).count(), (uint64_t) tracker.getSuccessful());
+  ASSERT_EQ(LatencyRecorder::snapshot(OpType::kGet).count(), LatencyRecorder::snapshot(OpType::kDirList).count());
+
+  // Data-path validation of the same tree still works
+  TreeValidator dataPath(executor, opts.baseUrl, nullptr);
+  acc = dataPath.initialize().get();
+  ASSERT_TRUE(acc.ok()) << acc.prettyPrint();
+
+  // Replace a file with one of the same name, but different contents
+  std::string victim = pickFile(executor, "root://localhost//eos");
+  ASSERT_FALSE(victim.empty());
+  ASSERT_TRUE(executor.rm(1, "root://localhost//eos/" + victim).get().ok());
+  ASSERT_TRUE(executor.put(1, "root://localhost//eos/" + victim, SelfCheckedFile("/eos/" + victim, "other").toString()).get().ok());
+
+  TreeValidator again(executor, validatorOpts, nullptr);
+  acc = again.initialize().get();
+  ASSERT_FALSE(acc.ok());
+  ASSERT_NE(acc.prettyPrint().find("Checksum mismatch"), std::string::npos) << acc.prettyPrint();
+}
+
+TEST(InMemoryExecutor, SampledValidation) {
+  InMemoryExecutor executor;
+  TreeBuilder::Options opts = treeOptions(42, 5, 2000);
+  ASSERT_NO_FATAL_FAILURE(buildTree(executor, opts));
+
+  ProgressTracker fullTracker(-1);
+  TreeValidator full(executor, opts.baseUrl, &fullTracker);
+  ASSERT_TRUE(full.initialize().get().ok());
+  int32_t total = fullTracker.getSuccessful();
+
+  TreeValidator::Options validatorOpts;
+  validatorOpts.url = opts.baseUrl;
+  validatorOpts.sampleRate = 0.25;
+
+  // Same seed, same files
+  int32_t sampled = -1;
+  for(size_t run = 0; run < 2; run++) {
+    ProgressTracker tracker(-1);
+    TreeValidator validator(executor, validatorOpts, &tracker);
+    TestcaseStatus acc = validator.initialize().get();
+    ASSERT_TRUE(acc.ok()) << acc.prettyPrint();
+    ASSERT_NE(acc.prettyPrint().find(SSTR("Sampled " << tracker.getSuccessful() << " of " << total << " files")), std::string::npos) << acc.prettyPrint();
+
+    if(run == 1) {
+      ASSERT_EQ(tracker.getSuccessful(), sampled);
+    }
+
+    sampled = tracker.getSuccessful();
+  }
+
+  ASSERT_GT(sampled, total / 8);
+  ASSERT_LT(sampled, total / 2);
+
+  // Directory sampling prunes whole subtrees
+  validatorOpts.sampleDirectories = true;
+  ProgressTracker prunedTracker(-1);
+  TreeValidator pruned(executor, validatorOpts, &prunedTracker);
+  TestcaseStatus acc = pruned.initialize().get();
+  ASSERT_TRUE(acc.ok()) << acc.prettyPrint();
+  ASSERT_LT(prunedTracker.getSuccessful(), sampled);
+
+  // Nothing sampled: only the root MANIFEST and listing
+  validatorOpts.sampleRate = 0;
+  LatencyRecorder::reset();
+  TreeValidator none(executor, validatorOpts, nullptr);
+  ASSERT_TRUE(none.initialize().get().ok());
+  ASSERT_EQ(LatencyRecorder::snapshot(OpType::kDirList).count(), 1u);
+}
+
+TEST(InMemoryExecutor, ValidateDirectoryInBatches) {
+  InMemoryExecutor executor;
+  TreeBuilder::Options opts = treeOptions(42, 0, 20);
+  ASSERT_NO_FATAL_FAILURE(buildTree(executor, opts));
+
+  ReadStatus root = executor.get(1, "root://localhost//eos/MANIFEST").get();
+  ASSERT_TRUE(root.ok());
+  Manifest manifest;
+  ASSERT_TRUE(manifest.parse(root.contents));
+  ASSERT_GT(manifest.fileCount(), 4u);
+
+  // The very last file is only read in the last batch
+  std::string victim(manifest.getFiles()[manifest.fileCount() - 1]);
+  ASSERT_TRUE(executor.rm(1, "root://localhost//eos/" + victim).get().ok());
+
+  TreeValidator::Options validatorOpts;
+  validatorOpts.url = opts.baseUrl;
+  validatorOpts.maxInflight = 2;
+
+  ProgressTracker tracker(-1);
+  TreeValidator validator(executor, validatorOpts, &tracker);
+  TestcaseStatus acc = validator.initialize().get();
+  ASSERT_FALSE(acc.ok());
+  ASSERT_NE(acc.prettyPrint().find(victim), std::string::npos) << acc.prettyPrint();
+  ASSERT_EQ(tracker.getSuccessful(), (int32_t) manifest.fileCount() - 1);
+  ASSERT_EQ(tracker.getFailed(), 1);
+}
+
+TEST(InMemoryExecutor, BuildAndValidateTemplatedTree) {
+  InMemoryExecutor executor;
+  TreeBuilder::Options opts = treeOptions(3, 4, 500);
+  opts.contentTemplates = true;
+  ASSERT_NO_FATAL_FAILURE(buildTree(executor, opts));
+
+  TreeValidator validator(executor, opts.baseUrl, nullptr);
+  TestcaseStatus acc = validator.initialize().get();
+  ASSERT_TRUE(acc.ok()) << acc.prettyPrint();
+}
+
+TEST(InMemoryExecutor, BuildTreeAdaptiveWindow) {
+  InMemoryExecutor executor(std::chrono::milliseconds(1));
+  TreeBuilder::Options opts = treeOptions(5, 4, 2000);
+  opts.maxInflight = 64;
+  opts.targetP99 = std::chrono::milliseconds(1000);
+
+  TestcaseStatus acc;
+  ASSERT_NO_FATAL_FAILURE(buildTree(executor, opts, &acc));
+  ASSERT_NE(acc.prettyPrint().find("window settled at"), std::string::npos);
+
+  TreeValidator validator(executor, opts.baseUrl, nullptr);
+  acc = validator.initialize().get();
+  ASSERT_TRUE(acc.ok()) << acc.prettyPrint();
+}
+
+TEST(InMemoryExecutor, BuildTreeWaitsForParents) {
+  // Slow mkdir, instant puts: anything racing ahead of the mkdir of its
+  // directory would fail.
+  InMemoryExecutor executor;
+  executor.setLatency(OpType::kMkdir, std::chrono::milliseconds(5));
+  ASSERT_NO_FATAL_FAILURE(buildTree(executor, treeOptions(42, 6, 1000)));
+
+  ProgressTracker tracker(-1);
+  TreeValidator validator(executor, "root://localhost//eos", &tracker);
+  TestcaseStatus acc = validator.initialize().get();
+  ASSERT_TRUE(acc.ok()) << acc.prettyPrint();
+  ASSERT_GT(tracker.getSuccessful(), 500);
+}
+
+TEST(InMemoryExecutor, BuildTreeSkipsChildrenOfFailedMkdir) {
+  InMemoryExecutor executor;
+  ASSERT_TRUE(executor.mkdir(1, "root://localhost//eos").get().ok());
+
+  HierarchyConstructionOptions hopts;
+  hopts.base = "/eos";
+  hopts.seed = 13;
+  hopts.depth = 3;
+  hopts.files = 100;
+
+  // Find the first directory the builder will create, and put a file there
+  HierarchyBuilder hierarchy(hopts);
+  HierarchyEntry entry;
+  while(hierarchy.next(entry) && !entry.dir) { }
+  ASSERT_TRUE(entry.dir);
+  ASSERT_TRUE(executor.put(1, SSTR("root://localhost/" << entry.fullPath), "in the way").get().ok());
+
+  TreeBuilder::Options opts;
+  opts.baseUrl = "root://localhost//eos";
+  opts.seed = hopts.seed;
+  opts.depth = hopts.depth;
+  opts.files = hopts.files;
+
+  TreeBuilder builder(executor, opts);
+  TestcaseStatus acc = builder.initialize().get();
+  ASSERT_FALSE(acc.ok());
+  ASSERT_NE(acc.toString().find(SSTR("Skipped " << entry.fullPath << "/MANIFEST")), std::string::npos);
+}
+
+TEST(InMemoryExecutor, BuildTreeMultipleConnections) {
+  for(PlacementPolicy placement : {PlacementPolicy::kRoundRobin, PlacementPolicy::kSubtree, PlacementPolicy::kLeastLoaded}) {
+    InMemoryExecutor executor(std::chrono::milliseconds(1));
+    TreeBuilder::Options opts = treeOptions(42, 4, 500);
+    opts.connections = 4;
+    opts.placement = placement;
+
+    TestcaseStatus acc;
+    ASSERT_NO_FATAL_FAILURE(buildTree(executor, opts, &acc));
+    ASSERT_NE(acc.prettyPrint().find("Connection 4 :: "), std::string::npos);
+
+    TreeValidator validator(executor, opts.baseUrl, nullptr);
+    acc = validator.initialize().get();
+    ASSERT_TRUE(acc.ok()) << acc.prettyPrint();
+  }
+}
+
+TEST(InMemoryExecutor, Mkdirs) {
+  InMemoryExecutor executor;
+  ASSERT_TRUE(executor.mkdirs(1, "root://localhost//eos/a/b/c").get().ok());
+  ASSERT_TRUE(executor.mkdirs(1, "root://localhost//eos/a/b").get().ok());
+  ASSERT_FALSE(executor.mkdir(1, "root://localhost//eos/a/b").get().ok());
+  ASSERT_TRUE(executor.put(1, "root://localhost//eos/a/b/c/f", "contents").get().ok());
+  ASSERT_FALSE(executor.mkdirs(1, "root://localhost//eos/a/b/c/f/g").get().ok());
+}
+
+TEST(InMemoryExecutor, BuildTreeInShards) {
+  InMemoryExecutor executor(std::chrono::milliseconds(1));
+  ASSERT_TRUE(executor.mkdir(1, "root://localhost//eos").get().ok());
+
+  TreeBuilder::Options opts = treeOptions(42, 4, 500);
+  opts.shards = 7;
+
+  // All shards at the same time, as separate workers would
+  std::vector<std::unique_ptr<ProgressTracker>> trackers;
+  std::vector<std::unique_ptr<TreeBuilder>> builders;
+  std::vector<folly::Future<TestcaseStatus>> futures;
+
+  uint64_t covered = 0;
+  for(size_t shard = 0; shard < opts.shards; shard++) {
+    opts.shard = shard;
+    std::pair<uint64_t, uint64_t> range = TreeBuilder::shardRange(opts);
+    ASSERT_EQ(range.first, covered);
+    covered = range.second;
+
+    trackers.emplace_back(new ProgressTracker(range.second - range.first));
+    builders.emplace_back(new TreeBuilder(executor, opts, trackers.back().get()));
+    futures.emplace_back(builders.back()->initialize());
+  }
+
+  ASSERT_EQ(covered, opts.files);
+
+  int32_t successful = 0;
+  for(size_t shard = 0; shard < opts.shards; shard++) {
+    TestcaseStatus acc = std::move(futures[shard]).get();
+    ASSERT_TRUE(acc.ok()) << acc.prettyPrint();
+    successful += trackers[shard]->getSuccessful();
+  }
+
+  ASSERT_EQ(successful, 500);
+
+  TreeValidator validator(executor, opts.baseUrl, nullptr);
+  TestcaseStatus acc = validator.initialize().get();
+  ASSERT_TRUE(acc.ok()) << acc.prettyPrint();
+
+  // Building a shard again runs into its own files, as an unsharded build
+  // would - only resuming tolerates them
+  for(size_t shard : {0, 3}) {
+    opts.shard = shard;
+    TreeBuilder again(executor, opts);
+    ASSERT_FALSE(again.initialize().get().ok()) << shard;
+  }
+}
+
+TEST(InMemoryExecutor, ResumeBuildFromJournal) {
+  InMemoryExecutor executor;
+  ASSERT_TRUE(executor.mkdir(1, "root://localhost//eos").get().ok());
+
+  char tmpl[] = "/tmp/eos-tester-journal-XXXXXX";
+  int fd = mkstemp(tmpl);
+  ASSERT_GE(fd, 0);
+  close(fd);
+
+  HierarchyConstructionOptions hopts;
+  hopts.base = "/eos";
+  hopts.seed = 7;
+  hopts.depth = 4;
+  hopts.files = 500;
+
+  // Interrupt the first run: the root MANIFEST has been written, but not
+  // recorded in the journal, and the first directory can't be created
+  HierarchyBuilder hierarchy(hopts);
+  HierarchyEntry entry;
+  ASSERT_TRUE(hierarchy.next(entry));
+  ASSERT_TRUE(executor.put(1, SSTR("root://localhost/" << entry.fullPath), entry.contents).get().ok());
+
+  while(hierarchy.next(entry) && !entry.dir) { }
+  ASSERT_TRUE(entry.dir);
+  std::string blocker = SSTR("root://localhost/" << entry.fullPath);
+  ASSERT_TRUE(executor.put(1, blocker, "in the way").get().ok());
+
+  TreeBuilder::Options opts;
+  opts.baseUrl = "root://localhost//eos";
+  opts.seed = hopts.seed;
+  opts.depth = hopts.depth;
+  opts.files = hopts.files;
+  opts.journal = tmpl;
+
+  TreeBuilder builder(executor, opts);
+  TestcaseStatus acc = builder.initialize().get();
+  ASSERT_FALSE(acc.ok());
+
+  ASSERT_TRUE(executor.rm(1, blocker).get().ok());
+
+  // A different tree can't resume from this journal
+  opts.resume = true;
+  opts.seed++;
+  TreeBuilder wrongBuilder(executor, opts);
+  acc = wrongBuilder.initialize().get();
+  ASSERT_FALSE(acc.ok());
+  ASSERT_NE(acc.toString().find("different run"), std::string::npos);
+
+  opts.seed--;
+  ProgressTracker tracker(opts.files);
+  TreeBuilder resumed(executor, opts, &tracker);
+  acc = resumed.initialize().get();
+  ASSERT_TRUE(acc.ok()) << acc.prettyPrint();
+  ASSERT_EQ(tracker.getSuccessful(), 500);
+  ASSERT_NE(acc.prettyPrint().find("Resumed from"), std::string::npos);
+  ASSERT_EQ(acc.prettyPrint().find("skipped 0 entries"), std::string::npos);
+
+  TreeValidator validator(executor, opts.baseUrl, nullptr);
+  acc = validator.initialize().get();
+  ASSERT_TRUE(acc.ok()) << acc.prettyPrint();
+
+  // Nothing left to do
+  ProgressTracker finalTracker(opts.files);
+  TreeBuilder noop(executor, opts, &finalTracker);
+  acc = noop.initialize().get();
+  ASSERT_TRUE(acc.ok()) << acc.prettyPrint();
+  ASSERT_EQ(finalTracker.getSuccessful(), 500);
+
+  ASSERT_EQ(std::remove(tmpl), 0);
+}
+
+TEST(InMemoryExecutor, DestroyTree) {
+  InMemoryExecutor executor(std::chrono::milliseconds(1));
+  TreeBuilder::Options opts = treeOptions(42, 5, 1000);
+  ASSERT_NO_FATAL_FAILURE(buildTree(executor, opts));
+
+  // A directory without MANIFEST, as left behind by an interrupted build, is
+  // still removed going by its listing
+  HierarchyConstructionOptions hopts;
+  hopts.base = "/eos";
+  hopts.seed = opts.seed;
+  hopts.depth = opts.depth;
+  hopts.files = opts.files;
+
+  HierarchyBuilder hierarchy(hopts);
+  HierarchyEntry entry;
+  size_t directories = 0;
+  std::string lastDirectory;
+
+  while(hierarchy.next(entry)) {
+    if(entry.dir) {
+      directories++;
+      lastDirectory = entry.fullPath;
+    }
+  }
+
+  ASSERT_GT(directories, 0u);
+  ASSERT_TRUE(executor.rm(1, SSTR("root://localhost/" << lastDirectory << "/MANIFEST")).get().ok());
+
+  ProgressTracker tracker(-1);
+  TreeDestroyer::Options destroyerOpts;
+  destroyerOpts.url = "root://localhost//eos/";
+  destroyerOpts.maxInflight = 50;
+  destroyerOpts.connections = 4;
+
+  TreeDestroyer destroyer(executor, destroyerOpts, &tracker);
+  TestcaseStatus acc = destroyer.initialize().get();
+  ASSERT_TRUE(acc.ok()) << acc.prettyPrint();
+  ASSERT_NE(acc.prettyPrint().find(SSTR("Removed 999 files and " << directories << " directories")), std::string::npos) << acc.prettyPrint();
+  ASSERT_EQ(tracker.getSuccessful(), (int32_t) (999 + directories));
+
+  DirListStatus list = executor.dirList(1, "root://localhost//eos").get();
+  ASSERT_TRUE(list.ok());
+  ASSERT_EQ(list.contents->GetSize(), 0u);
+}
+
+TEST(InMemoryExecutor, DestroyInterruptedBuild) {
+  HierarchyConstructionOptions hopts;
+  hopts.base = "/eos";
+  hopts.seed = 42;
+  hopts.depth = 5;
+  hopts.files = 1000;
+  hopts.manifestShardSize = 8;
+
+  // Each MANIFEST is written before anything it lists: stopping anywhere
+  // leaves MANIFESTs naming files and directories which don't exist
+  for(uint64_t end : {1, 2, 37, 400, 999}) {
+    InMemoryExecutor executor;
+    ASSERT_TRUE(executor.mkdir(1, "root://localhost//eos").get().ok());
+
+    HierarchyBuilder hierarchy(hopts);
+    hierarchy.setEnd(end);
+
+    HierarchyEntry entry;
+    size_t files = 0;
+    size_t directories = 0;
+
+    while(hierarchy.next(entry)) {
+      std::string url = SSTR("root://localhost/" << entry.fullPath);
+      if(entry.dir) {
+        ASSERT_TRUE(executor.mkdir(1, url).get().ok());
+        directories++;
+      }
+      else {
+        ASSERT_TRUE(executor.put(1, url, entry.contents).get().ok());
+        files++;
+      }
+    }
+
+    ASSERT_EQ(files, end);
+
+    ProgressTracker tracker(-1);
+    TreeDestroyer::Options destroyerOpts;
+    destroyerOpts.url = "root://localhost//eos";
+    destroyerOpts.maxInflight = 50;
+
+    TreeDestroyer destroyer(executor, destroyerOpts, &tracker);
+    TestcaseStatus acc = destroyer.initialize().get();
+    ASSERT_TRUE(acc.ok()) << end << acc.prettyPrint();
+    ASSERT_NE(acc.prettyPrint().find(SSTR("Removed " << files << " files and " << directories << " directories")), std::string::npos) << acc.prettyPrint();
+    ASSERT_EQ(tracker.getFailed(), 0);
+
+    DirListStatus list = executor.dirList(1, "root://localhost//eos").get();
+    ASSERT_TRUE(list.ok());
+    ASSERT_EQ(list.contents->GetSize(), 0u);
+  }
+}
+
+TEST(InMemoryExecutor, DestroyTreeKeepsAncestorsOfLeftovers) {
+  InMemoryExecutor executor;
+  ASSERT_TRUE(executor.mkdirs(1, "root://localhost//eos/a/b").get().ok());
+  ASSERT_TRUE(executor.mkdir(1, "root://localhost//eos/c").get().ok());
+  ASSERT_TRUE(executor.put(1, "root://localhost//eos/a/b/f1", "f1").get().ok());
+  ASSERT_TRUE(executor.put(1, "root://localhost//eos/c/f2", "f2").get().ok());
+
+  // A MANIFEST which doesn't mention f1: the leftover keeps b and a around
+  Manifest manifest("/eos/a/b/MANIFEST");
+  ASSERT_TRUE(executor.put(1, "root://localhost//eos/a/b/MANIFEST", manifest.toString()).get().ok());
+
+  // Along with a file which the MANIFEST does list, but can't be removed:
+  // a directory in its place
+  ASSERT_TRUE(executor.mkdir(1, "root://localhost//eos/a/b/f3").get().ok());
+  ASSERT_TRUE(executor.put(1, "root://localhost//eos/a/b/f3/f4", "f4").get().ok());
+  manifest.tryAddFile("f3");
+  ASSERT_TRUE(executor.rm(1, "root://localhost//eos/a/b/MANIFEST").get().ok());
+  ASSERT_TRUE(executor.put(1, "root://localhost//eos/a/b/MANIFEST", manifest.toString()).get().ok());
+
+  TreeDestroyer::Options opts;
+  opts.url = "root://localhost//eos";
+  TreeDestroyer destroyer(executor, opts);
+  TestcaseStatus acc = destroyer.initialize().get();
+  ASSERT_FALSE(acc.ok());
+  ASSERT_NE(acc.prettyPrint().find("Removed 2 files and 1 directories"), std::string::npos) << acc.prettyPrint();
+  ASSERT_NE(acc.prettyPrint().find("Is a directory: root://localhost//eos/a/b/f3"), std::string::npos) << acc.prettyPrint();
+
+  ASSERT_TRUE(executor.get(1, "root://localhost//eos/a/b/f1").get().ok());
+  ASSERT_FALSE(executor.dirList(1, "root://localhost//eos/c").get().ok());
+}
+
+TEST(InMemoryExecutor, ValidationDetectsMissingFile) {
+  InMemoryExecutor executor;
+  TreeBuilder::Options opts = treeOptions(7, 3, 100);
+  ASSERT_NO_FATAL_FAILURE(buildTree(executor, opts));
+
+  std::string victim = pickFile(executor, "root://localhost//eos");
+  ASSERT_FALSE(victim.empty());
+  ASSERT_TRUE(executor.rm(1, "root://localhost//eos/" + victim).get().ok());
+
+  TreeValidator validator(executor, opts.baseUrl, nullptr);
+  ASSERT_FALSE(validator.initialize().get().ok());
+
+  TreeValidator::Options validatorOpts;
+  validatorOpts.url = opts.baseUrl;
+  validatorOpts.workers = 4;
+
+  TreeValidator parallel(executor, validatorOpts, nullptr);
+  ASSERT_FALSE(parallel.initialize().get().ok());
+}
+
+TEST(InMemoryExecutor, ShardedManifests) {
+  InMemoryExecutor executor;
+  TreeBuilder::Options opts = treeOptions(42, 2, 2000);
+  opts.checksumType = "adler32";
+  opts.shape.files = Distribution::uniform(100, 500);
+  opts.manifestShardSize = 50;
+
+  TestcaseStatus acc;
+  ASSERT_NO_FATAL_FAILURE(buildTree(executor, opts, &acc));
+
+  ReadStatus root = executor.get(1, "root://localhost//eos/MANIFEST").get();
+  ASSERT_TRUE(root.ok());
+  Manifest index;
+  ASSERT_TRUE(index.parse(root.contents));
+  ASSERT_TRUE(index.isSharded());
+
+  // Every kind of validation goes through the shards
+  for(int mode = 0; mode < 3; mode++) {
+    TreeValidator::Options validatorOpts;
+    validatorOpts.url = opts.baseUrl;
+    validatorOpts.workers = 2;
+    validatorOpts.metadataOnly = (mode == 1);
+    validatorOpts.serverChecksums = (mode == 2);
+
+    ProgressTracker tracker(-1);
+    TreeValidator validator(executor, validatorOpts, &tracker);
+    acc = validator.initialize().get();
+    ASSERT_TRUE(acc.ok()) << acc.prettyPrint();
+    ASSERT_EQ(tracker.getFailed(), 0);
+  }
+
+  // A missing shard is noticed
+  std::string shard = SSTR("root://localhost//eos/" << index.getShards().back());
+  ReadStatus shardContents = executor.get(1, shard).get();
+  ASSERT_TRUE(shardContents.ok());
+  ASSERT_TRUE(executor.rm(1, shard).get().ok());
+
+  TreeValidator validator(executor, opts.baseUrl, nullptr);
+  acc = validator.initialize().get();
+  ASSERT_FALSE(acc.ok());
+  ASSERT_NE(acc.prettyPrint().find(SSTR("Error fetching /eos/" << index.getShards().back())), std::string::npos) << acc.prettyPrint();
+
+  // Destruction removes shards along with everything else
+  ASSERT_TRUE(executor.put(1, shard, shardContents.contents).get().ok());
+
+  TreeDestroyer::Options destroyerOpts;
+  destroyerOpts.url = opts.baseUrl;
+  TreeDestroyer destroyer(executor, destroyerOpts);
+  acc = destroyer.initialize().get();
+  ASSERT_TRUE(acc.ok()) << acc.prettyPrint();
+  ASSERT_NE(acc.prettyPrint().find("Removed 2000 files"), std::string::npos) << acc.prettyPrint();
+
+  DirListStatus list = executor.dirList(1, "root://localhost//eos").get();
+  ASSERT_TRUE(list.ok());
+  ASSERT_EQ(list.contents->GetSize(), 0u);
+}
+
+TEST(InMemoryExecutor, BinaryManifests) {
+  InMemoryExecutor executor;
+  TreeBuilder::Options opts = treeOptions(42, 2, 2000);
+  opts.checksumType = "adler32";
+  opts.shape.files = Distribution::uniform(100, 500);
+  opts.manifestShardSize = 50;
+  opts.binaryManifests = true;
+
+  TestcaseStatus acc;
+  ASSERT_NO_FATAL_FAILURE(buildTree(executor, opts, &acc));
+
+  ReadStatus root = executor.get(1, "root://localhost//eos/MANIFEST").get();
+  ASSERT_TRUE(root.ok());
+  ASSERT_TRUE(BinaryManifestView::isBinary(root.contents));
+  Manifest index;
+  ASSERT_TRUE(index.parse(root.contents));
+  ASSERT_TRUE(index.isSharded());
+
+  std::string shard = SSTR("root://localhost//eos/" << index.getShards().front());
+  ReadStatus shardContents = executor.get(1, shard).get();
+  ASSERT_TRUE(shardContents.ok());
+  ASSERT_TRUE(BinaryManifestView::isBinary(shardContents.contents));
+
+  for(int mode = 0; mode < 3; mode++) {
+    TreeValidator::Options validatorOpts;
+    validatorOpts.url = opts.baseUrl;
+    validatorOpts.workers = 2;
+    validatorOpts.metadataOnly = (mode == 1);
+    validatorOpts.serverChecksums = (mode == 2);
+
+    ProgressTracker tracker(-1);
+    TreeValidator validator(executor, validatorOpts, &tracker);
+    acc = validator.initialize().get();
+    ASSERT_TRUE(acc.ok()) << acc.prettyPrint();
+    ASSERT_EQ(tracker.getFailed(), 0);
+  }
+
+  // A damaged binary MANIFEST is reported, without dumping its bytes
+  std::string damaged = shardContents.contents;
+  damaged[damaged.size() / 2] ^= 0x01;
+  ASSERT_TRUE(executor.rm(1, shard).get().ok());
+  ASSERT_TRUE(executor.put(1, shard, damaged).get().ok());
+
+  TreeValidator validator(executor, opts.baseUrl, nullptr);
+  acc = validator.initialize().get();
+  ASSERT_FALSE(acc.ok());
+  ASSERT_NE(acc.prettyPrint().find("corrupt binary MANIFEST"), std::string::npos) << acc.prettyPrint();
+
+  ASSERT_TRUE(executor.rm(1, shard).get().ok());
+  ASSERT_TRUE(executor.put(1, shard, shardContents.contents).get().ok());
+
+  TreeDestroyer::Options destroyerOpts;
+  destroyerOpts.url = opts.baseUrl;
+  TreeDestroyer destroyer(executor, destroyerOpts);
+  acc = destroyer.initialize().get();
+  ASSERT_TRUE(acc.ok()) << acc.prettyPrint();
+  ASSERT_NE(acc.prettyPrint().find("Removed 2000 files"), std::string::npos) << acc.prettyPrint();
+}
@@ -23,6 +23,7 @@
 
 #include <gtest/gtest.h>
 #include "Manifest.hh"
+#include "BinaryManifestView.hh"
 #include "HashCalculator.hh"
 using namespace eostest;
 
@@ -100,13 +101,14 @@ TEST(Manifest, BasicSanity) {
   ASSERT_TRUE(manifest.popSubdir(tmp));
   ASSERT_EQ(tmp, "dir1");
 
-  ASSERT_TRUE(manifest.popSubdir(tmp));
-  ASSERT_EQ(tmp, "dir2");
+  ASSERT_TRUE(manifest.popLastSubdir(tmp));
+  ASSERT_EQ(tmp, "dir3");
 
   ASSERT_TRUE(manifest.popSubdir(tmp));
-  ASSERT_EQ(tmp, "dir3");
+  ASSERT_EQ(tmp, "dir2");
 
   ASSERT_FALSE(manifest.popSubdir(tmp));
+  ASSERT_FALSE(manifest.popLastSubdir(tmp));
 }
 
 TEST(Manifest, Parsing) {
@@ -150,3 +152,266 @@ TEST(Manifest, Parsing) {
 
   ASSERT_FALSE(manifest.parse(contents));
 }
+
+TEST(Manifest, Checksums) {
+  Manifest manifest("/eos/pps/base/somedir/MANIFEST");
+  ASSERT_TRUE(manifest.tryAddFile("f1"));
+  ASSERT_TRUE(manifest.tryAddFile("f2"));
+  manifest.setChecksum("f1", "adler32:0a1b2c3d");
+
+  std::string contents = manifest.toString();
+  ASSERT_NE(contents.find("FILE: f1 CHECKSUM: adler32:0a1b2c3d\n"), std::string::npos);
+  ASSERT_NE(contents.find("FILE: f2\n"), std::string::npos);
+
+  Manifest parsed;
+  ASSERT_TRUE(parsed.parse(contents));
+  ASSERT_EQ(parsed.fileCount(), 2u);
+
+  std::string checksum;
+  ASSERT_TRUE(parsed.getChecksum("f1", checksum));
+  ASSERT_EQ(checksum, "adler32:0a1b2c3d");
+  ASSERT_FALSE(parsed.getChecksum("f2", checksum));
+
+  std::string item;
+  ASSERT_TRUE(parsed.popFile(item));
+  ASSERT_EQ(item, "f1");
+  ASSERT_TRUE(parsed.getChecksum("f1", checksum));
+}
+
+TEST(Manifest, Sizes) {
+  Manifest manifest("/eos/pps/base/somedir/MANIFEST");
+  ASSERT_TRUE(manifest.tryAddFile("f1"));
+  ASSERT_TRUE(manifest.tryAddFile("f2"));
+  ASSERT_TRUE(manifest.tryAddFile("f3"));
+  manifest.setSize("f1", 1234);
+  manifest.setSize("f2", 0);
+  manifest.setChecksum("f2", "adler32:0a1b2c3d");
+
+  std::string contents = manifest.toString();
+  ASSERT_NE(contents.find("FILE: f1 SIZE: 1234\n"), std::string::npos);
+  ASSERT_NE(contents.find("FILE: f2 SIZE: 0 CHECKSUM: adler32:0a1b2c3d\n"), std::string::npos);
+  ASSERT_NE(contents.find("FILE: f3\n"), std::string::npos);
+
+  for(const std::string &serialized : {contents, manifest.toBinary()}) {
+    Manifest parsed;
+    ASSERT_TRUE(parsed.parse(serialized));
+    ASSERT_EQ(parsed.toString(), contents);
+
+    uint64_t size;
+    ASSERT_TRUE(parsed.getSize("f1", size));
+    ASSERT_EQ(size, 1234u);
+    ASSERT_TRUE(parsed.getSize("f2", size));
+    ASSERT_EQ(size, 0u);
+    ASSERT_FALSE(parsed.getSize("f3", size));
+
+    std::string checksum;
+    ASSERT_TRUE(parsed.getChecksum("f2", checksum));
+    ASSERT_EQ(checksum, "adler32:0a1b2c3d");
+  }
+
+  BinaryManifestView view;
+  std::string binary = manifest.toBinary();
+  ASSERT_TRUE(view.open(binary));
+
+  std::string_view checksum;
+  uint64_t size;
+  ASSERT_TRUE(view.findFile("f1", checksum, size));
+  ASSERT_EQ(size, 1234u);
+  ASSERT_TRUE(view.findFile("f3", checksum, size));
+  ASSERT_EQ(size, BinaryManifestView::kNoSize);
+
+  // Sizes must be canonical decimals, like everything else
+  std::string padded = manifest.toStringWithoutChecksum();
+  padded.replace(padded.find("SIZE: 1234"), 10, "SIZE: 01234");
+  padded += HashCalculator::base16Encode(HashCalculator::sha256(padded)) + "\n";
+  ASSERT_FALSE(Manifest().parse(padded));
+}
+
+TEST(Manifest, Shards) {
+  Manifest index("/eos/pps/base/somedir/MANIFEST");
+  index.addShard(Manifest::shardName(0));
+  index.addShard(Manifest::shardName(1));
+  ASSERT_TRUE(index.isSharded());
+
+  std::string contents = index.toString();
+  ASSERT_NE(contents.find("----------\nSHARD: MANIFEST.0\nSHARD: MANIFEST.1\n----------\n"), std::string::npos);
+
+  Manifest parsed;
+  ASSERT_TRUE(parsed.parse(contents));
+  ASSERT_EQ(parsed.getShards(), index.getShards());
+  ASSERT_TRUE(parsed.isManifestFile("MANIFEST"));
+  ASSERT_TRUE(parsed.isManifestFile("MANIFEST.1"));
+  ASSERT_FALSE(parsed.isManifestFile("MANIFEST.2"));
+
+  Manifest shard0("/eos/pps/base/somedir/MANIFEST.0");
+  ASSERT_TRUE(shard0.tryAddFile("f1"));
+  ASSERT_TRUE(shard0.tryAddSubdir("d1"));
+  shard0.setChecksum("f1", "adler32:0a1b2c3d");
+
+  Manifest shard1("/eos/pps/base/somedir/MANIFEST.1");
+  ASSERT_TRUE(shard1.tryAddFile("f2"));
+
+  ASSERT_TRUE(parsed.absorbShard(shard0));
+  ASSERT_TRUE(parsed.absorbShard(shard1));
+  ASSERT_EQ(parsed.fileCount(), 2u);
+  ASSERT_EQ(parsed.subdirCount(), 1u);
+
+  std::string checksum;
+  ASSERT_TRUE(parsed.getChecksum("f1", checksum));
+  ASSERT_EQ(checksum, "adler32:0a1b2c3d");
+
+  // Overlapping shards
+  ASSERT_FALSE(parsed.absorbShard(shard1));
+
+  // Shards must be plain names in the same directory
+  std::string bad = contents;
+  bad.replace(bad.find("SHARD: MANIFEST.1"), 17, "SHARD: ../MANIF1");
+  ASSERT_FALSE(parsed.parse(bad));
+}
+
+TEST(NameTable, BasicSanity) {
+  NameTable table;
+  ASSERT_TRUE(table.empty());
+
+  // Short names live inline, long ones in the arena
+  std::string longName(300, 'x');
+  ASSERT_TRUE(table.insert("bbb"));
+  ASSERT_TRUE(table.insert("ddddddd"));
+  ASSERT_TRUE(table.insert("a-rather-long-name"));
+  ASSERT_TRUE(table.insert(longName));
+  ASSERT_TRUE(table.insert(""));
+  ASSERT_FALSE(table.insert("bbb"));
+  ASSERT_FALSE(table.insert(longName));
+
+  std::vector<std::string> contents(table.begin(), table.end());
+  ASSERT_EQ(contents, std::vector<std::string>({"", "a-rather-long-name", "bbb", "ddddddd", longName}));
+
+  ASSERT_TRUE(table.contains("ddddddd"));
+  ASSERT_FALSE(table.contains("dddddd"));
+  ASSERT_EQ(table.lowerBound("c"), 3u);
+  ASSERT_EQ(table.lowerBound("z"), table.size());
+
+  table.merge({"aaa", "cccccccc", "zzz"});
+  contents.assign(table.begin(), table.end());
+  ASSERT_EQ(contents, std::vector<std::string>({"", "a-rather-long-name", "aaa", "bbb", "cccccccc", "ddddddd", longName, "zzz"}));
+
+  std::string name;
+  ASSERT_TRUE(table.popFront(name));
+  ASSERT_EQ(name, "");
+  ASSERT_TRUE(table.popFront(name));
+  ASSERT_EQ(name, "a-rather-long-name");
+  ASSERT_TRUE(table.popBack(name));
+  ASSERT_EQ(name, "zzz");
+  ASSERT_EQ(table.size(), 5u);
+  ASSERT_EQ(table[0], "aaa");
+  ASSERT_FALSE(table.contains("a-rather-long-name"));
+  ASSERT_FALSE(table.contains("zzz"));
+
+  // Popped names are gone for good
+  table.merge({"b"});
+  ASSERT_EQ(table.size(), 6u);
+  ASSERT_EQ(table[1], "b");
+
+  table.clear();
+  ASSERT_TRUE(table.empty());
+  ASSERT_FALSE(table.popFront(name));
+  ASSERT_FALSE(table.popBack(name));
+}
+
+TEST(Manifest, BulkInsertion) {
+  Manifest manifest("/eos/pps/base/somedir/MANIFEST");
+  ASSERT_TRUE(manifest.tryAddSubdir("d1"));
+  ASSERT_TRUE(manifest.tryAddFile("f2"));
+
+  ASSERT_EQ(manifest.tryAddFiles({"f3", "f1", "d1", "f2", "f3"}), 2u);
+  ASSERT_EQ(manifest.tryAddSubdirs({"f1", "d0"}), 1u);
+
+  std::vector<std::string> files(manifest.getFiles().begin(), manifest.getFiles().end());
+  ASSERT_EQ(files, std::vector<std::string>({"f1", "f2", "f3"}));
+
+  std::vector<std::string> subdirs(manifest.getDirectories().begin(), manifest.getDirectories().end());
+  ASSERT_EQ(subdirs, std::vector<std::string>({"d0", "d1"}));
+}
+
+TEST(Manifest, CanonicalFormOnly) {
+  Manifest manifest("/eos/pps/base/somedir/MANIFEST");
+  ASSERT_EQ(manifest.tryAddFiles({"f1", "f2", "f3"}), 3u);
+  ASSERT_TRUE(manifest.tryAddSubdir("d1"));
+  manifest.setChecksum("f2", "crc32c:01020304");
+
+  std::string contents = manifest.toString();
+  Manifest parsed;
+  ASSERT_TRUE(parsed.parse(contents));
+  ASSERT_EQ(parsed.toString(), contents);
+
+  // Truncated anywhere
+  for(size_t i = 0; i < contents.size(); i++) {
+    ASSERT_FALSE(parsed.parse(std::string_view(contents).substr(0, i))) << i;
+  }
+
+  // Trailing garbage
+  ASSERT_FALSE(parsed.parse(contents + "x"));
+
+  // Out of order, even with a checksum matching the canonical form
+  std::string unsorted = contents;
+  unsorted.replace(unsorted.find("FILE: f1\n"), 9, "FILE: f4\n");
+  ASSERT_FALSE(parsed.parse(unsorted));
+
+  std::string duplicate = contents;
+  duplicate.replace(duplicate.find("FILE: f3\n"), 9, "FILE: f2\n");
+  ASSERT_FALSE(parsed.parse(duplicate));
+}
+
+TEST(Manifest, BinaryFormat) {
+  Manifest manifest("/eos/pps/base/somedir/MANIFEST");
+  ASSERT_EQ(manifest.tryAddFiles({"f1", "f2", "a-file-with-a-long-name"}), 3u);
+  ASSERT_EQ(manifest.tryAddSubdirs({"d1", "d2"}), 2u);
+  manifest.setChecksum("f2", "adler32:0a1b2c3d");
+  manifest.addShard(Manifest::shardName(0));
+
+  std::string binary = manifest.toBinary();
+  ASSERT_TRUE(BinaryManifestView::isBinary(binary));
+  ASSERT_FALSE(BinaryManifestView::isBinary(manifest.toString()));
+  ASSERT_LT(binary.size(), manifest.toString().size());
+
+  // Looked up in place
+  BinaryManifestView view;
+  ASSERT_TRUE(view.open(binary));
+  ASSERT_TRUE(view.verify());
+  ASSERT_EQ(view.getFilename(), "/eos/pps/base/somedir/MANIFEST");
+  ASSERT_EQ(view.shardCount(), 1u);
+  ASSERT_EQ(view.getShard(0), "MANIFEST.0");
+  ASSERT_EQ(view.fileCount(), 3u);
+  ASSERT_EQ(view.getFile(0), "a-file-with-a-long-name");
+  ASSERT_TRUE(view.containsSubdir("d2"));
+  ASSERT_FALSE(view.containsSubdir("d3"));
+  ASSERT_FALSE(view.containsSubdir("f1"));
+
+  std::string_view checksum;
+  ASSERT_TRUE(view.findFile("f2", checksum));
+  ASSERT_EQ(checksum, "adler32:0a1b2c3d");
+  ASSERT_TRUE(view.findFile("f1", checksum));
+  ASSERT_TRUE(checksum.empty());
+  ASSERT_FALSE(view.findFile("f0", checksum));
+  ASSERT_FALSE(view.findFile("zzz", checksum));
+
+  // parse tells the formats apart, both give the same MANIFEST
+  Manifest fromBinary;
+  ASSERT_TRUE(fromBinary.parse(binary));
+  ASSERT_EQ(fromBinary.toString(), manifest.toString());
+  ASSERT_EQ(fromBinary.toBinary(), binary);
+
+  // Any damage is caught
+  for(size_t i = 0; i < binary.size(); i++) {
+    std::string damaged = binary;
+    damaged[i] ^= 0x01;
+    ASSERT_FALSE(fromBinary.parse(damaged)) << i;
+    ASSERT_FALSE(fromBinary.parse(std::string_view(binary).substr(0, i))) << i;
+  }
+
+  // The empty MANIFEST, too
+  Manifest empty("/eos/MANIFEST");
+  ASSERT_TRUE(fromBinary.parse(empty.toBinary()));
+  ASSERT_EQ(fromBinary.getFilename(), "/eos/MANIFEST");
+  ASSERT_TRUE(fromBinary.getFiles().empty());
+}
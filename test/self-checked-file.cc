@@ -54,3 +54,65 @@ TEST(SelfCheckedFile, BasicSanity) {
   ASSERT_FALSE(scf2.parse(contents));
   ASSERT_EQ(scf, scf2);
 }
+
+TEST(SelfCheckedFile, Template) {
+  ContentBuffer::Segment body = SelfCheckedFile::makeTemplateBody("some random bytes");
+
+  ContentBuffer f1 = SelfCheckedFile::fromTemplate("/eos/pps/base/f1", body);
+  ContentBuffer f2 = SelfCheckedFile::fromTemplate("/eos/pps/base/f2", body);
+
+  ASSERT_EQ(f1.toString(), SelfCheckedFile("/eos/pps/base/f1", "some random bytes").toString());
+  ASSERT_EQ(f2.toString(), SelfCheckedFile("/eos/pps/base/f2", "some random bytes").toString());
+  ASSERT_EQ(f1.size(), f1.toString().size());
+
+  // The body is shared, not copied
+  ASSERT_EQ(f1.getSegments().size(), 3u);
+  ASSERT_EQ(f1.getSegments()[1].get(), f2.getSegments()[1].get());
+
+  ASSERT_TRUE(SelfCheckedFile::validate(f2.toString(), "/eos/pps/base/f2").ok());
+}
+
+TEST(SelfCheckedFile, PlausibleSize) {
+  for(size_t length : {0, 1, 9, 10, 17, 99, 100, 256, 123456}) {
+    std::string contents = SelfCheckedFile("/eos/pps/base/f1", std::string(length, 'a')).toString();
+    ASSERT_EQ(SelfCheckedFile::sizeFor("/eos/pps/base/f1", length), contents.size()) << length;
+    ASSERT_TRUE(SelfCheckedFile::isPlausibleSize("/eos/pps/base/f1", contents.size())) << length;
+  }
+
+  ASSERT_FALSE(SelfCheckedFile::isPlausibleSize("/eos/pps/base/f1", 0));
+  ASSERT_FALSE(SelfCheckedFile::isPlausibleSize("/eos/pps/base/f1", 130));
+  ASSERT_TRUE(SelfCheckedFile::isPlausibleSize("/eos/pps/base/f1", 131));
+
+  // 9 random bytes give 140 bytes, 10 give 142 - nothing fits in between
+  ASSERT_FALSE(SelfCheckedFile::isPlausibleSize("/eos/pps/base/f1", 141));
+}
+
+TEST(SelfCheckedFile, ParseInPlace) {
+  std::string contents = SelfCheckedFile("/eos/pps/base/f1", "some random bytes").toString();
+
+  std::string_view filename;
+  std::string_view randomBytes;
+  ASSERT_TRUE(SelfCheckedFile::parseInPlace(contents, filename, randomBytes));
+  ASSERT_EQ(filename, "/eos/pps/base/f1");
+  ASSERT_EQ(randomBytes, "some random bytes");
+
+  // Points into the original, nothing copied
+  ASSERT_GE(randomBytes.data(), contents.data());
+  ASSERT_LT(randomBytes.data(), contents.data() + contents.size());
+
+  // Truncated anywhere
+  for(size_t i = 0; i < contents.size(); i++) {
+    ASSERT_FALSE(SelfCheckedFile::parseInPlace(std::string_view(contents).substr(0, i), filename, randomBytes)) << i;
+  }
+
+  // Only the canonical length is accepted
+  std::string padded = contents;
+  padded.replace(padded.find("RANDOM-BYTES: 17"), 16, "RANDOM-BYTES: 017");
+  ASSERT_FALSE(SelfCheckedFile::parseInPlace(padded, filename, randomBytes));
+
+  std::string huge = contents;
+  huge.replace(huge.find("RANDOM-BYTES: 17"), 16, "RANDOM-BYTES: 9999999999999999999");
+  ASSERT_FALSE(SelfCheckedFile::parseInPlace(huge, filename, randomBytes));
+
+  ASSERT_FALSE(SelfCheckedFile::validate(contents, "/eos/pps/base/f2").ok());
+}